@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <streambuf>
+
+#include "argparser.h"
+#include "ast/flat-ast.h"
+#include "ast/node-counter.h"
+#include "bytecode/compiler.h"
+#include "parsing/parser.h"
+#include "vm.h"
+#include "concurrent.h"
+#include "generator.h"
+#include "util.h"
+
+namespace pl0::ast {
+
+namespace {
+
+// the traversal node_counter does on the tree, on the flat AST
+class flat_node_counter : public flat_ast_visitor<flat_node_counter> {
+    DEFINE_FLAT_AST_VISITOR_SUBCLASS_MEMBERS()
+
+    size_t count_ = 0;
+public:
+    void visit_variable_declaration(flat_ast::node node) {
+        count_++;
+    }
+
+    void visit_constant_declaration(flat_ast::node node) {
+        count_++;
+    }
+
+#define DEFINE_COUNT_VISIT(type) \
+    void visit_##type(flat_ast::node node) { \
+        count_++; \
+        for (auto child : ast_->children(node)) \
+            visit(child); \
+    }
+    DEFINE_COUNT_VISIT(procedure_declaration)
+    STATEMENT_NODE_LIST(DEFINE_COUNT_VISIT)
+    EXPRESSION_NODE_LIST(DEFINE_COUNT_VISIT)
+#undef DEFINE_COUNT_VISIT
+
+    size_t count(const flat_ast &ast) {
+        ast_ = &ast;
+        count_ = 0;
+        visit(flat_ast::root);
+        return count_;
+    }
+};
+
+// bytes the nodes of the tree and their lists take, not counting allocator overhead
+class tree_memory : public ast_visitor<tree_memory> {
+    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+
+    size_t bytes_ = 0;
+
+    template <typename T>
+    void add_list(const std::vector<T> &list) {
+        bytes_ += list.capacity() * sizeof(T);
+    }
+public:
+    size_t measure(block *program) {
+        bytes_ = 0;
+        visit(program);
+        return bytes_;
+    }
+
+    void visit_variable_declaration(variable_declaration *node) {
+        bytes_ += sizeof(*node);
+        add_list(node->variables());
+    }
+
+    void visit_constant_declaration(constant_declaration *node) {
+        bytes_ += sizeof(*node);
+        add_list(node->constants());
+    }
+
+    void visit_procedure_declaration(procedure_declaration *node) {
+        bytes_ += sizeof(*node);
+        visit(node->main_block());
+    }
+
+    void visit_block(block *node) {
+        bytes_ += sizeof(*node);
+        add_list(node->sub_procedures());
+        if (node->var_declaration())
+            visit(node->var_declaration());
+        if (node->const_declaration())
+            visit(node->const_declaration());
+        for (auto method : node->sub_procedures())
+            visit(method);
+        visit(node->body());
+    }
+
+    void visit_binary_operation(binary_operation *node) {
+        bytes_ += sizeof(*node);
+        visit(node->left());
+        visit(node->right());
+    }
+
+    void visit_unary_operation(unary_operation *node) {
+        bytes_ += sizeof(*node);
+        visit(node->expr());
+    }
+
+    void visit_literal(literal *node) {
+        bytes_ += sizeof(*node);
+    }
+
+    void visit_variable_proxy(variable_proxy *node) {
+        bytes_ += sizeof(*node);
+    }
+
+    void visit_statement_list(statement_list *node) {
+        bytes_ += sizeof(*node);
+        add_list(node->statements());
+        for (auto stmt : node->statements())
+            visit(stmt);
+    }
+
+    void visit_if_statement(if_statement *node) {
+        bytes_ += sizeof(*node);
+        visit(node->condition());
+        visit(node->then_statement());
+        if (node->has_else_statement())
+            visit(node->else_statement());
+    }
+
+    void visit_while_statement(while_statement *node) {
+        bytes_ += sizeof(*node);
+        visit(node->cond());
+        visit(node->body());
+    }
+
+    void visit_call_statement(call_statement *node) {
+        bytes_ += sizeof(*node);
+        if (node->callee().capacity() > 15)
+            bytes_ += node->callee().capacity() + 1;
+    }
+
+    void visit_read_statement(read_statement *node) {
+        bytes_ += sizeof(*node);
+        add_list(node->targets());
+        for (auto target : node->targets())
+            visit(target);
+    }
+
+    void visit_write_statement(write_statement *node) {
+        bytes_ += sizeof(*node);
+        add_list(node->expressions());
+        for (auto expr : node->expressions())
+            visit(expr);
+    }
+
+    void visit_assign_statement(assign_statement *node) {
+        bytes_ += sizeof(*node);
+        visit(node->target());
+        visit(node->expr());
+    }
+
+    void visit_return_statement(return_statement *node) {
+        bytes_ += sizeof(*node);
+    }
+};
+
+}
+
+}
+
+namespace {
+
+struct options {
+    std::string workloads = "";
+    int scale = 1;
+    int repeat = 5;
+    std::string output_file = "";
+    std::string emit = "";
+    std::string label = "";
+    int concurrent = 0;
+    int threads = 1;
+    int requests = 20;
+    long time_slice = 10000;
+};
+
+class null_buffer : public std::streambuf {
+protected:
+    int overflow(int ch) override { return ch; }
+};
+
+struct phase_result {
+    std::string name;
+    std::vector<double> samples;
+
+    double min() const { return *std::min_element(samples.begin(), samples.end()); }
+
+    double mean() const { return std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size(); }
+
+    double median() const {
+        auto sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+};
+
+struct workload_result {
+    std::string name;
+    size_t source_bytes = 0;
+    size_t tokens = 0;
+    size_t instructions = 0;
+    size_t ast_nodes = 0;
+    size_t tree_bytes = 0;
+    size_t flat_bytes = 0;
+    std::vector<phase_result> phases;
+};
+
+
+template <typename Callable>
+double time_ns(Callable callable) {
+    auto start = std::chrono::steady_clock::now();
+    callable();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count();
+}
+
+size_t count_tokens(const std::string &source) {
+    std::istringstream in(source);
+    pl0::lexer lex(in);
+    size_t count = 0;
+    while (lex.peek() != pl0::token::EOS) {
+        if (lex.peek() == pl0::token::ILLEGAL)
+            throw pl0::general_error("illegal token at ", lex.loc().to_string());
+        lex.advance();
+        count++;
+    }
+    return count;
+}
+
+pl0::ast::block *parse(const std::string &source) {
+    std::istringstream in(source);
+    pl0::lexer lex(in);
+    pl0::parser parser(lex);
+    return parser.program();
+}
+
+workload_result run_workload(const pl0::bench::workload &w, const options &option) {
+    workload_result result;
+    result.name = w.name;
+    auto source = w.generate(option.scale);
+    result.source_bytes = source.size();
+
+    phase_result lex{ "lex" }, parse_phase{ "parse" }, compile{ "compile" }, execute{ "execute" };
+    // the same traversal over the tree and over its flat form
+    phase_result flatten{ "flatten" }, traverse_tree{ "traverse_tree" }, traverse_flat{ "traverse_flat" };
+    // the same run on the loop with every feature compiled in, to show what the plain loop saves
+    phase_result execute_general{ "execute_general" };
+    null_buffer sink;
+
+    for (int round = 0; round < option.repeat; round++) {
+        lex.samples.push_back(time_ns([&] { result.tokens = count_tokens(source); }));
+
+        pl0::ast::block *program = nullptr;
+        parse_phase.samples.push_back(time_ns([&] { program = parse(source); }));
+
+        std::unique_ptr<pl0::ast::flat_ast> flat;
+        flatten.samples.push_back(time_ns([&] { flat = std::make_unique<pl0::ast::flat_ast>(program); }));
+        traverse_tree.samples.push_back(time_ns([&] { result.ast_nodes = pl0::ast::node_counter{}.count(program); }));
+        size_t flat_nodes = 0;
+        traverse_flat.samples.push_back(time_ns([&] { flat_nodes = pl0::ast::flat_node_counter{}.count(*flat); }));
+        if (flat_nodes != result.ast_nodes)
+            throw pl0::general_error("the flat AST of ", w.name, " has ", flat_nodes, " nodes, the tree ",
+                                     result.ast_nodes);
+        result.tree_bytes = pl0::ast::tree_memory{}.measure(program);
+        result.flat_bytes = flat->memory_bytes();
+
+        pl0::code::compiler compiler;
+        compile.samples.push_back(time_ns([&] { compiler.generate(program); }));
+        result.instructions = compiler.code().size();
+
+        auto saved = std::cout.rdbuf(&sink);
+        execute.samples.push_back(time_ns([&] { pl0::execute(compiler.code()); }));
+        execute_general.samples.push_back(time_ns([&] {
+            pl0::machine{ compiler.code() }.run_with<pl0::general_policy>();
+        }));
+        std::cout.rdbuf(saved);
+
+        delete program;
+    }
+
+    result.phases = { lex, parse_phase, flatten, traverse_tree, traverse_flat, compile, execute, execute_general };
+    return result;
+}
+
+void write_json(std::ostream &out, const options &option, const std::vector<workload_result> &results) {
+    out << "{\n";
+    out << "  \"label\": " << pl0::quoted(option.label) << ",\n";
+    out << "  \"scale\": " << option.scale << ",\n";
+    out << "  \"repeat\": " << option.repeat << ",\n";
+    out << "  \"workloads\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        auto &r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\n";
+        out << "      \"name\": " << pl0::quoted(r.name) << ",\n";
+        out << "      \"source_bytes\": " << r.source_bytes << ",\n";
+        out << "      \"tokens\": " << r.tokens << ",\n";
+        out << "      \"instructions\": " << r.instructions << ",\n";
+        out << "      \"ast_nodes\": " << r.ast_nodes << ",\n";
+        out << "      \"tree_bytes\": " << r.tree_bytes << ",\n";
+        out << "      \"flat_bytes\": " << r.flat_bytes << ",\n";
+        out << "      \"phases\": {";
+        for (size_t j = 0; j < r.phases.size(); j++) {
+            auto &p = r.phases[j];
+            out << (j ? ",\n" : "\n") << "        " << pl0::quoted(p.name) << ": { "
+                << "\"min_ns\": " << static_cast<long long>(p.min()) << ", "
+                << "\"median_ns\": " << static_cast<long long>(p.median()) << ", "
+                << "\"mean_ns\": " << static_cast<long long>(p.mean()) << " }";
+        }
+        out << "\n      }\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+options parse_args(int argc, const char *argv[]) {
+    options option;
+    std::vector<std::string> rest;
+    auto to_int = [](const std::string &str) { return std::stoi(str); };
+    pl0::argument_parser<options> parser{"PL/0 benchmark harness"};
+    parser.store<std::initializer_list<const char *>>(
+            {"--workload", "-w"}, "Comma-separated workloads to run (default: all).", &options::workloads);
+    parser.store<std::initializer_list<const char *>>(
+            {"--scale", "-n"}, "Size factor passed to the program generator.", &options::scale, to_int);
+    parser.store<std::initializer_list<const char *>>(
+            {"--repeat", "-r"}, "Number of measured repetitions per phase.", &options::repeat, to_int);
+    parser.store<std::initializer_list<const char *>>(
+            {"--output", "-o"}, "Write JSON results to file instead of stdout.", &options::output_file);
+    parser.store<std::initializer_list<const char *>>(
+            {"--emit", "-e"}, "Print the generated source of a workload and exit.", &options::emit);
+    parser.store<std::initializer_list<const char *>>(
+            {"--label", "-l"}, "Free-form label recorded in the results, e.g. a commit id.", &options::label);
+    parser.store<std::initializer_list<const char *>>(
+            {"--concurrent", "-c"}, "Instead of the workloads, run this many request/response programs at once.",
+            &options::concurrent, to_int);
+    parser.store<std::initializer_list<const char *>>(
+            {"--threads"}, "Worker threads for --concurrent.", &options::threads, to_int);
+    parser.store<std::initializer_list<const char *>>(
+            {"--requests"}, "Requests per program for --concurrent.", &options::requests, to_int);
+    parser.store<std::initializer_list<const char *>>(
+            {"--time-slice"}, "Fuel per time slice for --concurrent.", &options::time_slice,
+            [](const std::string &str) { return std::stol(str); });
+    if (argc > 1)
+        parser.parse(argc, argv, option, rest);
+    if (option.repeat < 1 || option.scale < 1)
+        throw pl0::basic_error("scale and repeat must be positive");
+    if (option.concurrent < 0 || option.threads < 1 || option.requests < 1 || option.time_slice < 1)
+        throw pl0::basic_error("--concurrent, --threads, --requests and --time-slice must be positive");
+    return option;
+}
+
+std::vector<const pl0::bench::workload *> select_workloads(const std::string &names) {
+    std::vector<const pl0::bench::workload *> selected;
+    if (names.empty()) {
+        for (auto &w : pl0::bench::all_workloads())
+            selected.push_back(&w);
+        return selected;
+    }
+    std::istringstream in(names);
+    std::string name;
+    while (std::getline(in, name, ',')) {
+        auto w = pl0::bench::find_workload(name);
+        if (w == nullptr)
+            throw pl0::basic_error("unknown workload '" + name + '\'');
+        selected.push_back(w);
+    }
+    return selected;
+}
+
+}
+
+int main(int argc, const char *argv[]) {
+    try {
+        options option = parse_args(argc, argv);
+
+        if (!option.emit.empty()) {
+            auto w = pl0::bench::find_workload(option.emit);
+            if (w == nullptr)
+                throw pl0::basic_error("unknown workload '" + option.emit + '\'');
+            std::cout << w->generate(option.scale);
+            return EXIT_SUCCESS;
+        }
+
+        if (option.concurrent > 0) {
+            pl0::bench::concurrent_options concurrent;
+            concurrent.programs = option.concurrent;
+            concurrent.threads = option.threads;
+            concurrent.requests = option.requests;
+            concurrent.time_slice = option.time_slice;
+            if (option.output_file.empty()) {
+                pl0::bench::run_concurrent(concurrent, std::cout);
+            } else {
+                std::ofstream out(option.output_file);
+                pl0::bench::run_concurrent(concurrent, out);
+            }
+            return EXIT_SUCCESS;
+        }
+
+        std::vector<workload_result> results;
+        for (auto w : select_workloads(option.workloads)) {
+            std::cerr << "running " << w->name << " (" << w->description << ")\n";
+            results.push_back(run_workload(*w, option));
+        }
+
+        if (option.output_file.empty()) {
+            write_json(std::cout, option, results);
+        } else {
+            std::ofstream out(option.output_file);
+            write_json(out, option, results);
+        }
+    } catch (pl0::basic_error &error) {
+        std::cerr << "Error: " << error.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <vector>
+
+#include "concurrent.h"
+#include "bytecode/compiler.h"
+#include "parsing/parser.h"
+#include "runtime/event-loop.h"
+
+namespace pl0::bench {
+
+namespace {
+
+typedef std::chrono::steady_clock steady;
+
+std::string server_program(int iterations) {
+    std::ostringstream out;
+    out << "var x, i, s;\n"
+           "begin\n"
+           "    read x;\n"
+           "    while x # 0 do\n"
+           "    begin\n"
+           "        s := 0;\n"
+           "        i := 0;\n"
+           "        while i < " << iterations << " do\n"
+           "        begin\n"
+           "            s := s + x;\n"
+           "            i := i + 1\n"
+           "        end;\n"
+           "        write s;\n"
+           "        read x\n"
+           "    end\n"
+           "end.\n";
+    return out.str();
+}
+
+bytecode compile(const std::string &source) {
+    std::istringstream in(source);
+    pl0::lexer lex(in);
+    pl0::parser parser(lex);
+    auto program = parser.program();
+    code::compiler compiler;
+    compiler.generate(program);
+    delete program;
+    return compiler.code();
+}
+
+struct client {
+    std::shared_ptr<runtime::channel> messages;
+    int iterations = 0;
+    int sent = 0;
+    int wrong = 0;
+    steady::time_point sent_at;
+    std::vector<double> latencies;
+};
+
+double percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    auto index = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[index];
+}
+
+}
+
+void run_concurrent(const concurrent_options &option, std::ostream &out) {
+    const int light = 200, heavy = 20000;
+    auto light_code = compile(server_program(light));
+    auto heavy_code = compile(server_program(heavy));
+
+    runtime::event_loop loop{ option.threads, option.time_slice };
+    std::vector<client> clients(option.programs);
+    for (int i = 0; i < option.programs; i++) {
+        auto &c = clients[i];
+        bool hog = option.hog_every > 0 && i % option.hog_every == option.hog_every - 1;
+        c.iterations = hog ? heavy : light;
+        c.latencies.reserve(option.requests);
+        // only the thread running the program touches its client
+        c.messages = loop.spawn(hog ? heavy_code : light_code, [&c, &option](int value) {
+            c.latencies.push_back(std::chrono::duration<double, std::micro>(steady::now() - c.sent_at).count());
+            if (value != c.sent * c.iterations)
+                c.wrong++;
+            if (c.sent == option.requests) {
+                c.messages->close();
+                return;
+            }
+            c.sent++;
+            c.sent_at = steady::now();
+            c.messages->send(c.sent);
+        });
+    }
+
+    auto start = steady::now();
+    for (auto &c : clients) {
+        c.sent = 1;
+        c.sent_at = steady::now();
+        c.messages->send(1);
+    }
+    loop.run();
+    double seconds = std::chrono::duration<double>(steady::now() - start).count();
+
+    std::vector<double> light_latencies, heavy_latencies;
+    long answered = 0, wrong = 0;
+    for (auto &c : clients) {
+        auto &target = c.iterations == light ? light_latencies : heavy_latencies;
+        target.insert(target.end(), c.latencies.begin(), c.latencies.end());
+        answered += static_cast<long>(c.latencies.size());
+        wrong += c.wrong;
+    }
+    std::sort(light_latencies.begin(), light_latencies.end());
+    std::sort(heavy_latencies.begin(), heavy_latencies.end());
+
+    auto latency_json = [&out](const std::vector<double> &sorted) {
+        out << "{ \"count\": " << sorted.size()
+            << ", \"p50_us\": " << percentile(sorted, 0.5)
+            << ", \"p99_us\": " << percentile(sorted, 0.99)
+            << ", \"p999_us\": " << percentile(sorted, 0.999)
+            << ", \"max_us\": " << (sorted.empty() ? 0 : sorted.back()) << " }";
+    };
+    out << "{\n";
+    out << "  \"programs\": " << option.programs << ",\n";
+    out << "  \"threads\": " << option.threads << ",\n";
+    out << "  \"time_slice\": " << option.time_slice << ",\n";
+    out << "  \"requests\": " << answered << ",\n";
+    out << "  \"wrong\": " << wrong << ",\n";
+    out << "  \"seconds\": " << seconds << ",\n";
+    out << "  \"requests_per_second\": " << static_cast<long>(answered / seconds) << ",\n";
+    out << "  \"steals\": " << loop.steals() << ",\n";
+    out << "  \"latency\": ";
+    latency_json(light_latencies);
+    out << ",\n  \"hog_latency\": ";
+    latency_json(heavy_latencies);
+    out << "\n}\n";
+}
+
+}
@@ -0,0 +1,27 @@
+#ifndef PL0_BENCH_CONCURRENT_H
+#define PL0_BENCH_CONCURRENT_H
+
+#include <ostream>
+
+namespace pl0::bench {
+
+struct concurrent_options {
+    int programs = 10000;
+    int threads = 1;
+    int requests = 20;
+    long time_slice = 10000;
+    // every n-th program is a CPU hog, 0 for none
+    int hog_every = 100;
+};
+
+/**
+ * Runs many request/response programs at once on the event loop. Each
+ * program answers a number of requests sent over its channel, one at a
+ * time; a few programs spin much longer per request. Prints throughput and
+ * the latency distribution of the other programs' requests as JSON.
+ */
+void run_concurrent(const concurrent_options &option, std::ostream &out);
+
+}
+
+#endif //PL0_BENCH_CONCURRENT_H
@@ -0,0 +1,169 @@
+#include <sstream>
+
+#include "generator.h"
+
+namespace pl0::bench {
+
+static std::string deep_recursion(int scale) {
+    std::ostringstream out;
+    out << "var n, sum;\n"
+           "procedure down;\n"
+           "begin\n"
+           "    if n > 0 then\n"
+           "    begin\n"
+           "        sum := sum + n;\n"
+           "        n := n - 1;\n"
+           "        call down;\n"
+           "        sum := sum - 1\n"
+           "    end\n"
+           "end;\n"
+           "begin\n"
+           "    n := " << 1000 * scale << ";\n"
+           "    sum := 0;\n"
+           "    call down;\n"
+           "    write sum\n"
+           "end.\n";
+    return out.str();
+}
+
+static std::string tail_recursion(int scale) {
+    std::ostringstream out;
+    out << "var n, x, y;\n"
+           "procedure step;\n"
+           "var tmp;\n"
+           "begin\n"
+           "    if n > 0 then\n"
+           "    begin\n"
+           "        tmp := y;\n"
+           "        y := x + y;\n"
+           "        if y > 1000000 then y := y - 1000000;\n"
+           "        x := tmp;\n"
+           "        n := n - 1;\n"
+           "        call step\n"
+           "    end\n"
+           "end;\n"
+           "begin\n"
+           "    n := " << 100000 * scale << ";\n"
+           "    x := 0;\n"
+           "    y := 1;\n"
+           "    call step;\n"
+           "    write y\n"
+           "end.\n";
+    return out.str();
+}
+
+static std::string nested_globals(int scale) {
+    const int depth = 8;
+    std::ostringstream out;
+    out << "var g, h;\n";
+    for (int i = 1; i <= depth; i++)
+        out << "procedure p" << i << ";\n";
+    out << "var i;\n"
+           "begin\n"
+           "    i := 0;\n"
+           "    while i < " << 100000 * scale << " do\n"
+           "    begin\n"
+           "        g := g + h;\n"
+           "        if g > 1000000 then g := g - 1000000;\n"
+           "        i := i + 1\n"
+           "    end\n"
+           "end;\n";
+    for (int i = depth - 1; i >= 1; i--)
+        out << "begin call p" << i + 1 << " end;\n";
+    out << "begin\n"
+           "    g := 0;\n"
+           "    h := 3;\n"
+           "    call p1;\n"
+           "    write g\n"
+           "end.\n";
+    return out.str();
+}
+
+static std::string nested_loops(int scale) {
+    std::ostringstream out;
+    out << "var i, j, k, acc;\n"
+           "begin\n"
+           "    acc := 0;\n"
+           "    i := 0;\n"
+           "    while i < " << 10 * scale << " do\n"
+           "    begin\n"
+           "        j := 0;\n"
+           "        while j < 100 do\n"
+           "        begin\n"
+           "            k := 0;\n"
+           "            while k < 100 do\n"
+           "            begin\n"
+           "                acc := acc + k;\n"
+           "                if acc > 100000 then acc := acc - 100000;\n"
+           "                k := k + 1\n"
+           "            end;\n"
+           "            j := j + 1\n"
+           "        end;\n"
+           "        i := i + 1\n"
+           "    end;\n"
+           "    write acc\n"
+           "end.\n";
+    return out.str();
+}
+
+static std::string many_procedures(int scale) {
+    int count = 1000 * scale;
+    std::ostringstream out;
+    out << "var x, round;\n";
+    for (int i = 0; i < count; i++) {
+        out << "procedure p" << i << ";\n"
+               "var a;\n"
+               "begin\n"
+               "    a := x + " << i % 97 << ";\n"
+               "    x := a - " << i % 97 << " + 1\n"
+               "end;\n";
+    }
+    out << "begin\n"
+           "    x := 0;\n"
+           "    round := 0;\n"
+           "    while round < 10 do\n"
+           "    begin\n";
+    for (int i = 0; i < count; i++)
+        out << "        call p" << i << ";\n";
+    out << "        round := round + 1\n"
+           "    end;\n"
+           "    write x\n"
+           "end.\n";
+    return out.str();
+}
+
+static std::string large_source(int scale) {
+    const size_t target_size = static_cast<size_t>(scale) * 1024 * 1024;
+    const char *vars[] = { "a", "b", "c", "d", "e", "f", "g", "h" };
+    std::ostringstream out;
+    out << "var a, b, c, d, e, f, g, h;\nbegin\n    a := 1";
+    for (int i = 0; static_cast<size_t>(out.tellp()) < target_size; i++) {
+        auto lhs = vars[i % 8], rhs = vars[(i * 5 + 3) % 8];
+        out << ";\n    " << lhs << " := " << rhs << " + " << i % 1000 << ';'
+            << "\n    if " << lhs << " > 1000000 then " << lhs << " := " << lhs << " - 1000000";
+    }
+    out << ";\n    write a + b + c + d + e + f + g + h\nend.\n";
+    return out.str();
+}
+
+const std::vector<workload> &all_workloads() {
+    static const std::vector<workload> workloads = {
+        { "recursion", "non-tail recursion 1000*scale frames deep", deep_recursion },
+        { "tail-recursion", "tail-recursive procedure 100000*scale calls deep", tail_recursion },
+        { "loops", "three nested while loops, 100000*scale inner iterations", nested_loops },
+        { "nested", "hot loop 8 procedures deep updating globals, 100000*scale iterations", nested_globals },
+        { "procedures", "1000*scale small procedures, each called 10 times", many_procedures },
+        { "source", "straight-line program of roughly scale megabytes", large_source },
+    };
+    return workloads;
+}
+
+const workload *find_workload(const std::string &name) {
+    for (auto &w : all_workloads()) {
+        if (w.name == name)
+            return &w;
+    }
+    return nullptr;
+}
+
+}
@@ -0,0 +1,25 @@
+#ifndef PL0_BENCH_GENERATOR_H
+#define PL0_BENCH_GENERATOR_H
+
+#include <string>
+#include <vector>
+
+namespace pl0::bench {
+
+/**
+ * Synthetic PL/0 programs whose size or running time grows with `scale`.
+ * Generated programs never read input, so they can be executed unattended.
+ */
+struct workload {
+    std::string name;
+    std::string description;
+    std::string (*generate)(int scale);
+};
+
+const std::vector<workload> &all_workloads();
+
+const workload *find_workload(const std::string &name);
+
+}
+
+#endif //PL0_BENCH_GENERATOR_H
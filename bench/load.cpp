@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "argparser.h"
+
+namespace {
+
+typedef std::chrono::steady_clock steady;
+
+struct options {
+    std::string socket_path = "";
+    std::string program_file = "";
+    std::string spawn = "";
+    int connections = 4;
+    int requests = 1000;
+};
+
+const char *const default_program =
+        "var n, i, d, count, prime;\n"
+        "begin\n"
+        "    read n;\n"
+        "    count := 0;\n"
+        "    i := 2;\n"
+        "    while i <= n do\n"
+        "    begin\n"
+        "        prime := 1;\n"
+        "        d := 2;\n"
+        "        while (d * d) <= i do\n"
+        "        begin\n"
+        "            if ((i / d) * d) = i then prime := 0;\n"
+        "            d := d + 1\n"
+        "        end;\n"
+        "        count := count + prime;\n"
+        "        i := i + 1\n"
+        "    end;\n"
+        "    write count\n"
+        "end.\n";
+
+int connect_to(const std::string &path) {
+    sockaddr_un address{ };
+    if (path.size() >= sizeof address.sun_path)
+        throw pl0::basic_error("socket path too long: " + path);
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof address) < 0)
+        throw pl0::basic_error("cannot connect to " + path + ": " + std::strerror(errno));
+    return fd;
+}
+
+void send_all(int fd, const std::string &text) {
+    size_t sent = 0;
+    while (sent < text.size()) {
+        auto count = write(fd, text.data() + sent, text.size() - sent);
+        if (count <= 0)
+            throw pl0::basic_error("connection lost");
+        sent += static_cast<size_t>(count);
+    }
+}
+
+// reads response lines until one that ends a request
+std::string receive_response(int fd, std::string &pending) {
+    while (true) {
+        size_t end;
+        while ((end = pending.find('\n')) != std::string::npos) {
+            auto line = pending.substr(0, end);
+            pending.erase(0, end + 1);
+            if (line == "ok" || line == "done")
+                return line;
+            if (line.compare(0, 6, "error ") == 0)
+                throw pl0::basic_error("daemon: " + line.substr(6));
+        }
+        char chunk[4096];
+        auto count = read(fd, chunk, sizeof chunk);
+        if (count <= 0)
+            throw pl0::basic_error("connection lost");
+        pending.append(chunk, static_cast<size_t>(count));
+    }
+}
+
+// one request the expensive way: a new interpreter process per run
+void spawn_request(const std::string &interpreter, const std::string &program_file, int input) {
+    int to_child[2], from_child[2];
+    if (pipe(to_child) < 0 || pipe(from_child) < 0)
+        throw pl0::basic_error("pipe failed");
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        close(to_child[0]);
+        close(to_child[1]);
+        close(from_child[0]);
+        close(from_child[1]);
+        execl(interpreter.c_str(), interpreter.c_str(), program_file.c_str(), static_cast<char *>(nullptr));
+        _exit(127);
+    }
+    close(to_child[0]);
+    close(from_child[1]);
+    send_all(to_child[1], std::to_string(input) + '\n');
+    close(to_child[1]);
+    char chunk[4096];
+    while (read(from_child[0], chunk, sizeof chunk) > 0) { }
+    close(from_child[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        throw pl0::basic_error("the interpreter failed");
+}
+
+options parse_args(int argc, const char *argv[]) {
+    options option;
+    std::vector<std::string> rest;
+    auto to_int = [](const std::string &str) { return std::stoi(str); };
+    pl0::argument_parser<options> parser{"Load generator for the PL/0 daemon"};
+    parser.store<std::initializer_list<const char *>>(
+            {"--socket", "-s"}, "Socket of a daemon started with PL0 --daemon.", &options::socket_path);
+    parser.store<std::initializer_list<const char *>>(
+            {"--program", "-p"}, "Program to run (default: count the primes up to the input).",
+            &options::program_file);
+    parser.store<std::initializer_list<const char *>>(
+            {"--spawn"}, "Instead of the daemon, start this interpreter for every request.", &options::spawn);
+    parser.store<std::initializer_list<const char *>>(
+            {"--connections", "-c"}, "Concurrent clients.", &options::connections, to_int);
+    parser.store<std::initializer_list<const char *>>(
+            {"--requests", "-n"}, "Requests per client.", &options::requests, to_int);
+    if (argc > 1)
+        parser.parse(argc, argv, option, rest);
+    if (option.socket_path.empty() == option.spawn.empty())
+        throw pl0::basic_error("give either --socket or --spawn");
+    if (option.connections < 1 || option.requests < 1)
+        throw pl0::basic_error("connections and requests must be positive");
+    return option;
+}
+
+}
+
+int main(int argc, const char *argv[]) {
+    try {
+        options option = parse_args(argc, argv);
+
+        std::string source = default_program, program_file = option.program_file;
+        if (!program_file.empty()) {
+            std::ifstream in(program_file);
+            if (in.fail())
+                throw pl0::basic_error("failed to open file: " + program_file);
+            std::ostringstream text;
+            text << in.rdbuf();
+            source = text.str();
+        } else if (!option.spawn.empty()) {
+            char path[] = "/tmp/pl0-load-XXXXXX";
+            int fd = mkstemp(path);
+            if (fd < 0)
+                throw pl0::basic_error("cannot create a temporary file");
+            send_all(fd, source);
+            close(fd);
+            program_file = path;
+        }
+
+        if (!option.socket_path.empty()) {
+            int fd = connect_to(option.socket_path);
+            std::string pending;
+            send_all(fd, "compile load " + std::to_string(source.size()) + '\n' + source);
+            receive_response(fd, pending);
+            close(fd);
+        }
+
+        std::vector<std::vector<double>> latencies(option.connections);
+        std::vector<std::string> errors(option.connections);
+        std::vector<std::thread> clients;
+        auto start = steady::now();
+        for (int c = 0; c < option.connections; c++) {
+            clients.emplace_back([&, c] {
+                try {
+                    int fd = option.socket_path.empty() ? -1 : connect_to(option.socket_path);
+                    std::string pending;
+                    for (int i = 0; i < option.requests; i++) {
+                        int input = 100 + (c * 31 + i * 17) % 400;
+                        auto sent_at = steady::now();
+                        if (fd < 0) {
+                            spawn_request(option.spawn, program_file, input);
+                        } else {
+                            send_all(fd, "run load " + std::to_string(input) + '\n');
+                            receive_response(fd, pending);
+                        }
+                        latencies[c].push_back(
+                                std::chrono::duration<double, std::micro>(steady::now() - sent_at).count());
+                    }
+                    if (fd >= 0)
+                        close(fd);
+                } catch (pl0::basic_error &error) {
+                    errors[c] = error.what();
+                }
+            });
+        }
+        for (auto &client : clients)
+            client.join();
+        double seconds = std::chrono::duration<double>(steady::now() - start).count();
+        if (option.program_file.empty() && !program_file.empty())
+            unlink(program_file.c_str());
+        for (auto &error : errors) {
+            if (!error.empty())
+                throw pl0::basic_error(error);
+        }
+
+        std::vector<double> all;
+        for (auto &samples : latencies)
+            all.insert(all.end(), samples.begin(), samples.end());
+        std::sort(all.begin(), all.end());
+        auto percentile = [&all](double p) { return all[static_cast<size_t>(p * (all.size() - 1))]; };
+        std::cout << "{\n"
+                  << "  \"mode\": \"" << (option.spawn.empty() ? "daemon" : "spawn") << "\",\n"
+                  << "  \"connections\": " << option.connections << ",\n"
+                  << "  \"requests\": " << all.size() << ",\n"
+                  << "  \"seconds\": " << seconds << ",\n"
+                  << "  \"requests_per_second\": " << static_cast<long>(all.size() / seconds) << ",\n"
+                  << "  \"p50_us\": " << percentile(0.5) << ",\n"
+                  << "  \"p99_us\": " << percentile(0.99) << ",\n"
+                  << "  \"max_us\": " << all.back() << "\n"
+                  << "}\n";
+    } catch (pl0::basic_error &error) {
+        std::cerr << "Error: " << error.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+#include <cstdlib>
+#include <new>
+
+#include "statistics.h"
+
+// Linked into PL0 only, and only with PL0_COUNT_ALLOCATIONS, so pl0-bench,
+// pl0-load and other users of pl0core keep the allocator of the C++ library.
+// Allocations are counted while a phase_timer measures, and otherwise only
+// test a flag.
+
+namespace {
+
+void *allocate(std::size_t size) {
+    if (pl0::allocation_counter::counting.load(std::memory_order_relaxed)) {
+        auto &counts = pl0::allocation_counter::counts;
+        counts.allocations++;
+        counts.bytes += size;
+    }
+    while (true) {
+        if (void *memory = std::malloc(size ? size : 1))
+            return memory;
+        auto handler = std::get_new_handler();
+        if (handler == nullptr)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+}
+
+void *operator new(std::size_t size) {
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size) {
+    return allocate(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return allocate(size);
+    } catch (std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return allocate(size);
+    } catch (std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
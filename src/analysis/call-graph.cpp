@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+#include "call-graph.h"
+
+namespace pl0::analysis {
+
+class call_graph::builder : public ast::ast_visitor<builder> {
+    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+
+    call_graph &graph_;
+    scope *scope_;
+    procedure *current_;
+
+    DECLARE_VISIT_METHODS
+public:
+    explicit builder(call_graph &graph) : graph_(graph), scope_(nullptr), current_(nullptr) { }
+
+    void build(ast::block *program) {
+        graph_.procedures_.push_back(nullptr);
+        graph_.nodes_[nullptr].main_block = program;
+        visit_block(program);
+    }
+};
+
+void call_graph::builder::visit_variable_declaration(ast::variable_declaration *node) { }
+
+void call_graph::builder::visit_constant_declaration(ast::constant_declaration *node) { }
+
+void call_graph::builder::visit_procedure_declaration(ast::procedure_declaration *node) {
+    auto proc = node->symbol();
+    auto &info = graph_.nodes_[proc];
+    info.declaration = node;
+    info.main_block = node->main_block();
+    info.parent = current_;
+    graph_.procedures_.push_back(proc);
+
+    auto saved = current_;
+    current_ = proc;
+    visit_block(node->main_block());
+    current_ = saved;
+}
+
+void call_graph::builder::visit_block(ast::block *node) {
+    auto saved = scope_;
+    scope_ = node->belonging_scope();
+    for (auto method : node->sub_procedures())
+        visit_procedure_declaration(method);
+    visit(node->body());
+    scope_ = saved;
+}
+
+void call_graph::builder::visit_unary_operation(ast::unary_operation *node) { }
+
+void call_graph::builder::visit_binary_operation(ast::binary_operation *node) { }
+
+void call_graph::builder::visit_literal(ast::literal *node) { }
+
+void call_graph::builder::visit_variable_proxy(ast::variable_proxy *node) { }
+
+void call_graph::builder::visit_statement_list(ast::statement_list *node) {
+    for (auto stmt : node->statements())
+        visit(stmt);
+}
+
+void call_graph::builder::visit_if_statement(ast::if_statement *node) {
+    visit(node->then_statement());
+    if (node->has_else_statement())
+        visit(node->else_statement());
+}
+
+void call_graph::builder::visit_while_statement(ast::while_statement *node) {
+    visit(node->body());
+}
+
+void call_graph::builder::visit_call_statement(ast::call_statement *node) {
+    auto sym = scope_->resolve(node->callee());
+    auto callee = sym && sym->is_procedure() ? dynamic_cast<procedure *>(sym) : nullptr;
+    graph_.nodes_[current_].calls.push_back({ node, scope_, current_, callee });
+}
+
+void call_graph::builder::visit_read_statement(ast::read_statement *node) { }
+
+void call_graph::builder::visit_write_statement(ast::write_statement *node) { }
+
+void call_graph::builder::visit_assign_statement(ast::assign_statement *node) { }
+
+void call_graph::builder::visit_return_statement(ast::return_statement *node) { }
+
+call_graph::call_graph(ast::block *program) : program_(program) {
+    builder{*this}.build(program);
+    for (auto proc : procedures_) {
+        for (auto &site : nodes_[proc].calls) {
+            if (site.callee)
+                nodes_[site.callee].callers.push_back(site);
+        }
+    }
+    find_recursion();
+}
+
+void call_graph::find_recursion() {
+    // Tarjan's strongly connected components
+    std::unordered_map<procedure *, int> index, low_link;
+    std::vector<procedure *> stack;
+    std::unordered_set<procedure *> on_stack;
+    int next_index = 0, next_component = 0;
+
+    std::function<void(procedure *)> connect = [&](procedure *proc) {
+        index[proc] = low_link[proc] = next_index++;
+        stack.push_back(proc);
+        on_stack.insert(proc);
+        for (auto &site : nodes_[proc].calls) {
+            if (!site.callee)
+                continue;
+            if (index.find(site.callee) == index.end()) {
+                connect(site.callee);
+                low_link[proc] = std::min(low_link[proc], low_link[site.callee]);
+            } else if (on_stack.count(site.callee)) {
+                low_link[proc] = std::min(low_link[proc], index[site.callee]);
+            }
+        }
+        if (low_link[proc] == index[proc]) {
+            std::vector<procedure *> members;
+            procedure *member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                on_stack.erase(member);
+                members.push_back(member);
+                nodes_[member].component = next_component;
+            } while (member != proc);
+            next_component++;
+            for (auto m : members) {
+                bool self_call = std::any_of(nodes_[m].calls.begin(), nodes_[m].calls.end(),
+                                             [m](const call_site &site) { return site.callee == m; });
+                nodes_[m].recursive = members.size() > 1 || self_call;
+            }
+        }
+    };
+
+    for (auto proc : procedures_) {
+        if (index.find(proc) == index.end())
+            connect(proc);
+    }
+}
+
+std::vector<procedure *> call_graph::post_order() const {
+    std::vector<procedure *> order;
+    std::unordered_set<procedure *> visited;
+    std::function<void(procedure *)> walk = [&](procedure *proc) {
+        if (!visited.insert(proc).second)
+            return;
+        for (auto &site : nodes_.at(proc).calls) {
+            if (site.callee)
+                walk(site.callee);
+        }
+        order.push_back(proc);
+    };
+    for (auto proc : procedures_)
+        walk(proc);
+    return order;
+}
+
+std::vector<procedure *> call_graph::reachable() const {
+    std::vector<procedure *> result;
+    std::unordered_set<procedure *> visited{ nullptr };
+    std::vector<procedure *> worklist{ nullptr };
+    while (!worklist.empty()) {
+        auto proc = worklist.back();
+        worklist.pop_back();
+        result.push_back(proc);
+        for (auto &site : nodes_.at(proc).calls) {
+            if (site.callee && visited.insert(site.callee).second)
+                worklist.push_back(site.callee);
+        }
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,75 @@
+#ifndef PL0_CALL_GRAPH_H
+#define PL0_CALL_GRAPH_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "../ast/ast.h"
+
+namespace pl0::analysis {
+
+struct call_site {
+    ast::call_statement *node;
+    // scope the call statement is compiled in
+    scope *caller_scope;
+    // nullptr stands for the main program
+    procedure *caller;
+    // nullptr if the callee name does not resolve to a procedure
+    procedure *callee;
+};
+
+/**
+ * Static call graph of a program. Call statements are resolved by name
+ * against the scope they appear in, exactly as the compiler does. The main
+ * program is represented by a null procedure.
+ */
+class call_graph {
+    struct node {
+        ast::procedure_declaration *declaration = nullptr;
+        ast::block *main_block = nullptr;
+        procedure *parent = nullptr;
+        std::vector<call_site> calls;
+        std::vector<call_site> callers;
+        int component = -1;
+        bool recursive = false;
+    };
+
+    ast::block *program_;
+    std::vector<procedure *> procedures_;
+    std::unordered_map<procedure *, node> nodes_;
+
+    class builder;
+
+    void find_recursion();
+public:
+    explicit call_graph(ast::block *program);
+
+    ast::block *program() const { return program_; }
+
+    // all procedures in declaration order, main program (nullptr) first
+    const std::vector<procedure *> &procedures() const { return procedures_; }
+
+    ast::procedure_declaration *declaration(procedure *proc) const { return nodes_.at(proc).declaration; }
+
+    ast::block *main_block(procedure *proc) const { return nodes_.at(proc).main_block; }
+
+    // procedure whose block declares `proc`, nullptr for the main program
+    procedure *parent(procedure *proc) const { return nodes_.at(proc).parent; }
+
+    const std::vector<call_site> &calls_from(procedure *proc) const { return nodes_.at(proc).calls; }
+
+    const std::vector<call_site> &calls_to(procedure *proc) const { return nodes_.at(proc).callers; }
+
+    // true if `proc` can be active more than once, directly or through other procedures
+    bool is_recursive(procedure *proc) const { return nodes_.at(proc).recursive; }
+
+    // procedures ordered so that callees precede their callers (cycles broken arbitrarily)
+    std::vector<procedure *> post_order() const;
+
+    // procedures reachable from the main program, including the main program itself
+    std::vector<procedure *> reachable() const;
+};
+
+}
+
+#endif //PL0_CALL_GRAPH_H
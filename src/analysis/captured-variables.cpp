@@ -0,0 +1,101 @@
+#include "captured-variables.h"
+
+namespace pl0::analysis {
+
+namespace {
+
+// compares the level of every variable referenced with that of the procedure referencing it
+class capture_scanner : public ast::ast_visitor<capture_scanner> {
+    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+
+    std::unordered_set<variable *> &captured_;
+    int level_;
+
+    DECLARE_VISIT_METHODS
+public:
+    explicit capture_scanner(std::unordered_set<variable *> &captured) : captured_(captured), level_(0) { }
+
+    void scan(ast::block *program) { visit_block(program); }
+};
+
+void capture_scanner::visit_variable_declaration(ast::variable_declaration *node) { }
+
+void capture_scanner::visit_constant_declaration(ast::constant_declaration *node) { }
+
+void capture_scanner::visit_procedure_declaration(ast::procedure_declaration *node) {
+    visit_block(node->main_block());
+}
+
+void capture_scanner::visit_block(ast::block *node) {
+    int saved = level_;
+    level_ = node->belonging_scope()->get_level();
+    for (auto method : node->sub_procedures())
+        visit_procedure_declaration(method);
+    visit(node->body());
+    level_ = saved;
+}
+
+void capture_scanner::visit_unary_operation(ast::unary_operation *node) {
+    visit(node->expr());
+}
+
+void capture_scanner::visit_binary_operation(ast::binary_operation *node) {
+    visit(node->left());
+    visit(node->right());
+}
+
+void capture_scanner::visit_literal(ast::literal *node) { }
+
+void capture_scanner::visit_variable_proxy(ast::variable_proxy *node) {
+    if (node->target()->is_variable()) {
+        auto var = static_cast<variable *>(node->target());
+        if (var->get_level() < level_)
+            captured_.insert(var);
+    }
+}
+
+void capture_scanner::visit_statement_list(ast::statement_list *node) {
+    for (auto stmt : node->statements())
+        visit(stmt);
+}
+
+void capture_scanner::visit_if_statement(ast::if_statement *node) {
+    visit(node->condition());
+    visit(node->then_statement());
+    if (node->has_else_statement())
+        visit(node->else_statement());
+}
+
+void capture_scanner::visit_while_statement(ast::while_statement *node) {
+    visit(node->cond());
+    visit(node->body());
+}
+
+void capture_scanner::visit_call_statement(ast::call_statement *node) { }
+
+void capture_scanner::visit_read_statement(ast::read_statement *node) {
+    for (auto target : node->targets())
+        visit_variable_proxy(target);
+}
+
+void capture_scanner::visit_write_statement(ast::write_statement *node) {
+    for (auto expr : node->expressions())
+        visit(expr);
+}
+
+void capture_scanner::visit_assign_statement(ast::assign_statement *node) {
+    visit_variable_proxy(node->target());
+    visit(node->expr());
+}
+
+void capture_scanner::visit_return_statement(ast::return_statement *node) { }
+
+}
+
+std::unordered_set<variable *> find_captured_variables(ast::block *program) {
+    std::unordered_set<variable *> captured;
+    capture_scanner{captured}.scan(program);
+    return captured;
+}
+
+}
@@ -0,0 +1,19 @@
+#ifndef PL0_CAPTURED_VARIABLES_H
+#define PL0_CAPTURED_VARIABLES_H
+
+#include <unordered_set>
+
+#include "../ast/ast.h"
+
+namespace pl0::analysis {
+
+/**
+ * Variables referenced from a procedure nested deeper than the one declaring
+ * them. Nested procedures reach such a variable in its declaring frame, so
+ * it can neither move to another slot nor leave memory.
+ */
+std::unordered_set<variable *> find_captured_variables(ast::block *program);
+
+}
+
+#endif //PL0_CAPTURED_VARIABLES_H
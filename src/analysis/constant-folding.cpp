@@ -0,0 +1,37 @@
+#include <climits>
+#include <cstdint>
+
+#include "constant-folding.h"
+
+namespace pl0::analysis {
+
+namespace {
+
+// two's complement wrap-around, as the VM's int arithmetic behaves
+int wrap(int64_t value) {
+    return static_cast<int>(static_cast<uint32_t>(value));
+}
+
+}
+
+bool fold(token opr, int lhs, int rhs, int &result) {
+    switch (opr) {
+    case token::ADD: result = wrap(static_cast<int64_t>(lhs) + rhs); return true;
+    case token::SUB: result = wrap(static_cast<int64_t>(lhs) - rhs); return true;
+    case token::MUL: result = wrap(static_cast<int64_t>(lhs) * rhs); return true;
+    case token::DIV:
+        if (rhs == 0 || (lhs == INT_MIN && rhs == -1))
+            return false;
+        result = lhs / rhs;
+        return true;
+    case token::LE: result = lhs < rhs; return true;
+    case token::LEQ: result = lhs <= rhs; return true;
+    case token::GE: result = lhs > rhs; return true;
+    case token::GEQ: result = lhs >= rhs; return true;
+    case token::EQ: result = lhs == rhs; return true;
+    case token::NEQ: result = lhs != rhs; return true;
+    default: return false;
+    }
+}
+
+}
@@ -0,0 +1,18 @@
+#ifndef PL0_CONSTANT_FOLDING_H
+#define PL0_CONSTANT_FOLDING_H
+
+#include "../parsing/token.h"
+
+namespace pl0::analysis {
+
+/**
+ * Computes a binary operation on two known operands the way the VM does,
+ * wrapping around on overflow. Returns false, leaving the result alone,
+ * for a division the VM would stop the program on and for anything that
+ * is not a binary operator, so the operation is kept for run time.
+ */
+bool fold(token opr, int lhs, int rhs, int &result);
+
+}
+
+#endif //PL0_CONSTANT_FOLDING_H
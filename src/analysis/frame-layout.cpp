@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "frame-layout.h"
+#include "captured-variables.h"
+
+namespace pl0::analysis {
+
+namespace {
+
+// a set of variables numbered densely within one scope
+class variable_set {
+    std::vector<uint64_t> words_;
+public:
+    explicit variable_set(size_t count = 0) : words_((count + 63) / 64, 0) { }
+
+    void insert(int index) { words_[index / 64] |= uint64_t{ 1 } << (index % 64); }
+
+    void erase(int index) { words_[index / 64] &= ~(uint64_t{ 1 } << (index % 64)); }
+
+    bool contains(int index) const { return (words_[index / 64] >> (index % 64)) & 1; }
+
+    // returns true if the set grew
+    bool merge(const variable_set &other) {
+        bool changed = false;
+        for (size_t i = 0; i < words_.size(); i++) {
+            auto merged = words_[i] | other.words_[i];
+            changed |= merged != words_[i];
+            words_[i] = merged;
+        }
+        return changed;
+    }
+
+    template <typename F>
+    void for_each(F f) const {
+        for (size_t i = 0; i < words_.size(); i++) {
+            for (auto word = words_[i]; word != 0; word &= word - 1)
+                f(static_cast<int>(i * 64 + __builtin_ctzll(word)));
+        }
+    }
+};
+
+}
+
+/**
+ * Statement-level control-flow graph of one procedure body restricted to
+ * the locals being allocated. Calls do not appear: a callee can only reach
+ * captured locals, which are not allocated here. Node 0 is the exit.
+ */
+class frame_layout::flow_graph {
+    struct node {
+        std::vector<int> uses;
+        int def = -1;
+        std::vector<int> successors;
+    };
+
+    const std::unordered_map<variable *, int> &numbering_;
+    std::vector<node> nodes_;
+
+    int create(std::vector<int> uses, int def, std::vector<int> successors) {
+        nodes_.push_back({ std::move(uses), def, std::move(successors) });
+        return static_cast<int>(nodes_.size() - 1);
+    }
+
+    int number_of(symbol *sym) const {
+        auto iter = numbering_.find(static_cast<variable *>(sym));
+        return sym->is_variable() && iter != numbering_.end() ? iter->second : -1;
+    }
+
+    void collect_uses(ast::expression *expr, std::vector<int> &uses) const {
+        switch (expr->get_type()) {
+        case ast::ast_node_type::unary_operation:
+            collect_uses(static_cast<ast::unary_operation *>(expr)->expr(), uses);
+            break;
+        case ast::ast_node_type::binary_operation:
+            collect_uses(static_cast<ast::binary_operation *>(expr)->left(), uses);
+            collect_uses(static_cast<ast::binary_operation *>(expr)->right(), uses);
+            break;
+        case ast::ast_node_type::variable_proxy: {
+            int index = number_of(static_cast<ast::variable_proxy *>(expr)->target());
+            if (index >= 0)
+                uses.push_back(index);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // builds the nodes of `stmt` continuing at `next` and returns its first node
+    int build(ast::statement *stmt, int next) {
+        switch (stmt->get_type()) {
+        case ast::ast_node_type::statement_list: {
+            auto &statements = static_cast<ast::statement_list *>(stmt)->statements();
+            for (auto iter = statements.rbegin(); iter != statements.rend(); ++iter)
+                next = build(*iter, next);
+            return next;
+        }
+        case ast::ast_node_type::if_statement: {
+            auto node = static_cast<ast::if_statement *>(stmt);
+            int else_entry = node->has_else_statement() ? build(node->else_statement(), next) : next;
+            int then_entry = build(node->then_statement(), next);
+            std::vector<int> uses;
+            collect_uses(node->condition(), uses);
+            return create(std::move(uses), -1, { then_entry, else_entry });
+        }
+        case ast::ast_node_type::while_statement: {
+            auto node = static_cast<ast::while_statement *>(stmt);
+            std::vector<int> uses;
+            collect_uses(node->cond(), uses);
+            int head = create(std::move(uses), -1, { });
+            int body_entry = build(node->body(), head);
+            nodes_[head].successors = { body_entry, next };
+            return head;
+        }
+        case ast::ast_node_type::read_statement: {
+            auto &targets = static_cast<ast::read_statement *>(stmt)->targets();
+            for (auto iter = targets.rbegin(); iter != targets.rend(); ++iter)
+                next = create({ }, number_of((*iter)->target()), { next });
+            return next;
+        }
+        case ast::ast_node_type::write_statement: {
+            std::vector<int> uses;
+            for (auto expr : static_cast<ast::write_statement *>(stmt)->expressions())
+                collect_uses(expr, uses);
+            return create(std::move(uses), -1, { next });
+        }
+        case ast::ast_node_type::assign_statement: {
+            auto node = static_cast<ast::assign_statement *>(stmt);
+            std::vector<int> uses;
+            collect_uses(node->expr(), uses);
+            return create(std::move(uses), number_of(node->target()->target()), { next });
+        }
+        case ast::ast_node_type::return_statement:
+            return create({ }, -1, { 0 });
+        default:
+            return next;
+        }
+    }
+public:
+    flow_graph(const std::unordered_map<variable *, int> &numbering, ast::statement *body) : numbering_(numbering) {
+        create({ }, -1, { });
+        entry = build(body, 0);
+    }
+
+    int entry;
+
+    /**
+     * Fills `interference` with the pairs of locals that are live at the
+     * same time. Nodes were created in roughly reverse execution order,
+     * which makes that the natural order to propagate liveness backwards.
+     */
+    void interference(std::vector<std::vector<bool>> &interference) const {
+        size_t count = numbering_.size();
+        std::vector<variable_set> live_in(nodes_.size(), variable_set{ count });
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t n = 0; n < nodes_.size(); n++) {
+                variable_set live{ count };
+                for (auto succ : nodes_[n].successors)
+                    live.merge(live_in[succ]);
+                if (nodes_[n].def >= 0)
+                    live.erase(nodes_[n].def);
+                for (auto use : nodes_[n].uses)
+                    live.insert(use);
+                changed |= live_in[n].merge(live);
+            }
+        }
+
+        auto interfere = [&interference](int a, int b) {
+            if (a != b)
+                interference[a][b] = interference[b][a] = true;
+        };
+        for (auto &node : nodes_) {
+            if (node.def < 0)
+                continue;
+            variable_set live_out{ count };
+            for (auto succ : node.successors)
+                live_out.merge(live_in[succ]);
+            live_out.for_each([&](int other) { interfere(node.def, other); });
+        }
+        // everything read before being assigned holds the zero of a fresh frame
+        std::vector<int> at_entry;
+        live_in[entry].for_each([&at_entry](int index) { at_entry.push_back(index); });
+        for (auto a : at_entry) {
+            for (auto b : at_entry)
+                interfere(a, b);
+        }
+    }
+};
+
+frame_layout::frame_layout(ast::block *program) {
+    captured_ = find_captured_variables(program);
+    allocate(program);
+}
+
+void frame_layout::allocate(ast::block *block) {
+    auto belonging_scope = block->belonging_scope();
+    std::vector<variable *> locals;
+    std::unordered_set<int> reserved;
+    int size = 0;
+    for (auto var : belonging_scope->get_variables()) {
+        if (captured_.count(var)) {
+            reserved.insert(var->get_index());
+            size = std::max(size, var->get_index() + 1);
+        } else {
+            locals.push_back(var);
+        }
+    }
+
+    std::unordered_map<variable *, int> numbering;
+    for (size_t i = 0; i < locals.size(); i++)
+        numbering[locals[i]] = static_cast<int>(i);
+    flow_graph graph{numbering, block->body()};
+    std::vector<std::vector<bool>> interference(locals.size(), std::vector<bool>(locals.size()));
+    graph.interference(interference);
+
+    std::vector<int> colors(locals.size(), -1);
+    for (size_t i = 0; i < locals.size(); i++) {
+        std::unordered_set<int> taken = reserved;
+        for (size_t j = 0; j < i; j++) {
+            if (interference[i][j])
+                taken.insert(colors[j]);
+        }
+        int color = 0;
+        while (taken.count(color))
+            color++;
+        colors[i] = color;
+        slots_[locals[i]] = color;
+        size = std::max(size, color + 1);
+    }
+    sizes_[belonging_scope] = size;
+
+    for (auto method : block->sub_procedures())
+        allocate(method->main_block());
+}
+
+int frame_layout::slot(variable *var) const {
+    auto iter = slots_.find(var);
+    return iter == slots_.end() ? var->get_index() : iter->second;
+}
+
+int frame_layout::frame_size(scope *s) const {
+    auto iter = sizes_.find(s);
+    return iter == sizes_.end() ? s->get_variable_count() : iter->second;
+}
+
+}
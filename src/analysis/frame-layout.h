@@ -0,0 +1,42 @@
+#ifndef PL0_FRAME_LAYOUT_H
+#define PL0_FRAME_LAYOUT_H
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../ast/ast.h"
+
+namespace pl0::analysis {
+
+/**
+ * Assigns frame slots to variables so that locals with disjoint live ranges
+ * share a slot. Liveness is computed per procedure over a statement-level
+ * control-flow graph. A fresh frame starts zeroed, so a local read before
+ * any assignment is live from the procedure entry. Variables that nested
+ * procedures access keep their declared index, because those procedures
+ * address them from another frame.
+ */
+class frame_layout {
+    std::unordered_map<variable *, int> slots_;
+    std::unordered_map<scope *, int> sizes_;
+    std::unordered_set<variable *> captured_;
+
+    class flow_graph;
+
+    void allocate(ast::block *block);
+public:
+    explicit frame_layout(ast::block *program);
+
+    // frame slot of a variable, its declared index unless it shares a slot
+    int slot(variable *var) const;
+
+    // number of slots a frame of the given scope needs
+    int frame_size(scope *s) const;
+
+    // true if a procedure nested in the declaring one accesses the variable
+    bool is_captured(variable *var) const { return captured_.count(var) > 0; }
+};
+
+}
+
+#endif //PL0_FRAME_LAYOUT_H
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <unordered_set>
+
+#include "side-effects.h"
+
+namespace pl0::analysis {
+
+namespace {
+
+/**
+ * Variables written on every path so far. Code that cannot be reached, like
+ * the rest of a body after return, vacuously writes every variable.
+ */
+struct must_set {
+    bool all = true;
+    std::unordered_set<variable *> vars;
+
+    bool contains(variable *var) const { return all || vars.count(var) > 0; }
+
+    void insert(variable *var) {
+        if (!all)
+            vars.insert(var);
+    }
+
+    void insert(const must_set &other) {
+        if (other.all) {
+            all = true;
+            vars.clear();
+        } else {
+            for (auto var : other.vars)
+                insert(var);
+        }
+    }
+
+    void intersect(const must_set &other) {
+        if (other.all)
+            return;
+        if (all) {
+            *this = other;
+            return;
+        }
+        for (auto iter = vars.begin(); iter != vars.end();)
+            iter = other.vars.count(*iter) ? std::next(iter) : vars.erase(iter);
+    }
+
+    bool operator==(const must_set &other) const { return all == other.all && vars == other.vars; }
+};
+
+std::vector<variable *> sorted(const std::unordered_set<variable *> &vars) {
+    std::vector<variable *> result(vars.begin(), vars.end());
+    std::sort(result.begin(), result.end(), [](variable *a, variable *b) {
+        return a->get_level() != b->get_level() ? a->get_level() < b->get_level() : a->get_index() < b->get_index();
+    });
+    return result;
+}
+
+}
+
+struct side_effects::variable_sets {
+    std::unordered_set<variable *> reads;
+    std::unordered_set<variable *> writes;
+    must_set must_writes;
+    bool performs_io = false;
+
+    bool operator==(const variable_sets &other) const {
+        return reads == other.reads && writes == other.writes && must_writes == other.must_writes &&
+               performs_io == other.performs_io;
+    }
+
+    // forgets the variables that live in the frame of `proc`
+    void restrict_to(procedure *proc) {
+        if (proc == nullptr)
+            return;
+        auto local = [proc](variable *var) { return var->get_level() > proc->get_level(); };
+        for (auto set : { &reads, &writes, &must_writes.vars }) {
+            for (auto iter = set->begin(); iter != set->end();)
+                iter = local(*iter) ? set->erase(iter) : std::next(iter);
+        }
+    }
+};
+
+/**
+ * Computes the sets of one procedure body from the current sets of the
+ * procedures it calls, ignoring nested procedure declarations.
+ */
+class side_effects::scanner : public ast::ast_visitor<scanner> {
+    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+
+    const std::unordered_map<procedure *, variable_sets> &callees_;
+    variable_sets &sets_;
+    scope *scope_;
+    must_set written_;
+
+    DECLARE_VISIT_METHODS
+
+    void write(variable *var) {
+        sets_.writes.insert(var);
+        written_.insert(var);
+    }
+public:
+    scanner(const std::unordered_map<procedure *, variable_sets> &callees, variable_sets &sets)
+            : callees_(callees), sets_(sets), scope_(nullptr) { }
+
+    void scan(ast::block *block) {
+        scope_ = block->belonging_scope();
+        written_.all = false;
+        visit(block->body());
+        sets_.must_writes.intersect(written_);
+    }
+};
+
+void side_effects::scanner::visit_variable_declaration(ast::variable_declaration *node) { }
+
+void side_effects::scanner::visit_constant_declaration(ast::constant_declaration *node) { }
+
+void side_effects::scanner::visit_procedure_declaration(ast::procedure_declaration *node) { }
+
+void side_effects::scanner::visit_block(ast::block *node) { }
+
+void side_effects::scanner::visit_unary_operation(ast::unary_operation *node) {
+    visit(node->expr());
+}
+
+void side_effects::scanner::visit_binary_operation(ast::binary_operation *node) {
+    visit(node->left());
+    visit(node->right());
+}
+
+void side_effects::scanner::visit_literal(ast::literal *node) { }
+
+void side_effects::scanner::visit_variable_proxy(ast::variable_proxy *node) {
+    if (!node->target()->is_variable())
+        return;
+    auto var = static_cast<variable *>(node->target());
+    if (!written_.contains(var))
+        sets_.reads.insert(var);
+}
+
+void side_effects::scanner::visit_statement_list(ast::statement_list *node) {
+    for (auto stmt : node->statements())
+        visit(stmt);
+}
+
+void side_effects::scanner::visit_if_statement(ast::if_statement *node) {
+    visit(node->condition());
+    auto before = written_;
+    visit(node->then_statement());
+    std::swap(before, written_);
+    if (node->has_else_statement())
+        visit(node->else_statement());
+    written_.intersect(before);
+}
+
+void side_effects::scanner::visit_while_statement(ast::while_statement *node) {
+    // the first iteration sees the fewest writes, and there may be none
+    visit(node->cond());
+    auto before = written_;
+    visit(node->body());
+    written_ = std::move(before);
+}
+
+void side_effects::scanner::visit_call_statement(ast::call_statement *node) {
+    auto sym = scope_->resolve(node->callee());
+    auto iter = sym && sym->is_procedure() ? callees_.find(static_cast<procedure *>(sym)) : callees_.end();
+    if (iter == callees_.end())
+        return;
+    auto &callee = iter->second;
+    for (auto var : callee.reads) {
+        if (!written_.contains(var))
+            sets_.reads.insert(var);
+    }
+    sets_.writes.insert(callee.writes.begin(), callee.writes.end());
+    sets_.performs_io |= callee.performs_io;
+    written_.insert(callee.must_writes);
+}
+
+void side_effects::scanner::visit_read_statement(ast::read_statement *node) {
+    sets_.performs_io = true;
+    for (auto target : node->targets()) {
+        if (target->target()->is_variable())
+            write(static_cast<variable *>(target->target()));
+    }
+}
+
+void side_effects::scanner::visit_write_statement(ast::write_statement *node) {
+    sets_.performs_io = true;
+    for (auto expr : node->expressions())
+        visit(expr);
+}
+
+void side_effects::scanner::visit_assign_statement(ast::assign_statement *node) {
+    visit(node->expr());
+    if (node->target()->target()->is_variable())
+        write(static_cast<variable *>(node->target()->target()));
+}
+
+void side_effects::scanner::visit_return_statement(ast::return_statement *node) {
+    sets_.must_writes.intersect(written_);
+    written_ = must_set{ };
+}
+
+side_effects::side_effects(const call_graph &graph) {
+    // Starts from procedures that read and write nothing and never return,
+    // and grows the sets until no procedure changes. Callees go first so
+    // that only recursion needs more than one round.
+    std::unordered_map<procedure *, variable_sets> sets;
+    for (auto proc : graph.procedures())
+        sets[proc];
+    auto order = graph.post_order();
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto proc : order) {
+            variable_sets next;
+            scanner{sets, next}.scan(graph.main_block(proc));
+            next.restrict_to(proc);
+            if (!(next == sets[proc])) {
+                sets[proc] = std::move(next);
+                changed = true;
+            }
+        }
+    }
+
+    for (auto proc : graph.procedures()) {
+        auto &own = sets[proc];
+        auto &result = summaries_[proc];
+        result.reads = sorted(own.reads);
+        result.writes = sorted(own.writes);
+        result.must_writes = own.must_writes.all ? result.writes : sorted(own.must_writes.vars);
+        result.performs_io = own.performs_io;
+    }
+}
+
+}
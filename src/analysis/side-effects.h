@@ -0,0 +1,46 @@
+#ifndef PL0_SIDE_EFFECTS_H
+#define PL0_SIDE_EFFECTS_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "call-graph.h"
+
+namespace pl0::analysis {
+
+/**
+ * Read and write sets of every procedure: the variables outside its own
+ * frame that a call may read or write, counting everything the procedures
+ * it calls do. Locals of the procedure itself start from zero on every call
+ * and are not part of the sets. Reads only count if the call may see the
+ * value the variable had before the call, i.e. not after writing it on
+ * every path. A procedure that executes read or write, directly or through
+ * a callee, performs input or output.
+ */
+class side_effects {
+public:
+    struct summary {
+        // all sorted by level and index
+        std::vector<variable *> reads;
+        std::vector<variable *> writes;
+        // written on every path that returns
+        std::vector<variable *> must_writes;
+        bool performs_io = false;
+    };
+private:
+    std::unordered_map<procedure *, summary> summaries_;
+
+    struct variable_sets;
+    class scanner;
+public:
+    explicit side_effects(const call_graph &graph);
+
+    const summary &of(procedure *proc) const { return summaries_.at(proc); }
+
+    // true if a call only depends on and changes the variables in its read and write sets
+    bool is_deterministic(procedure *proc) const { return !of(proc).performs_io; }
+};
+
+}
+
+#endif //PL0_SIDE_EFFECTS_H
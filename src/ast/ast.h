@@ -6,6 +6,7 @@
 #include "../parsing/token.h"
 #include "../parsing/scope.h"
 #include "../parsing/symbol.h"
+#include "../util.h"
 
 namespace pl0::ast {
 
@@ -50,8 +51,12 @@ enum class ast_node_type {
 
 #define PROPERTY_CONST_REF_GETTER(field) const decltype(field##_) &field() const { return field##_; }
 
+#define PROPERTY_SETTER(field) void set_##field(decltype(field##_) value) { field##_ = std::move(value); }
+
 class ast_node {
     ast_node_type type_;
+    // where the node starts in the source, line 0 for nodes made by the optimizer
+    location loc_{ 0, 0 };
 public:
     explicit ast_node(ast_node_type type) : type_(type) { }
 
@@ -59,6 +64,10 @@ public:
         return type_;
     }
 
+    PROPERTY_CONST_REF_GETTER(loc)
+
+    PROPERTY_SETTER(loc)
+
     virtual ~ast_node() = default;
 };
 
@@ -166,10 +175,14 @@ public:
     PROPERTY_CONST_REF_GETTER(sub_procedures)
 
     PROPERTY_GETTER(body)
+
+    PROPERTY_SETTER(sub_procedures)
+
+    PROPERTY_SETTER(body)
 };
 
 class statement_list : public statement {
-    const std::vector<statement *> statements_;
+    std::vector<statement *> statements_;
 public:
     typedef std::vector<statement *> list_type;
 
@@ -179,6 +192,8 @@ public:
     ~statement_list() final = default;
 
     PROPERTY_CONST_REF_GETTER(statements)
+
+    PROPERTY_SETTER(statements)
 };
 
 class if_statement : public statement {
@@ -207,6 +222,10 @@ public:
     PROPERTY_GETTER(then_statement)
 
     PROPERTY_GETTER(else_statement)
+
+    PROPERTY_SETTER(then_statement)
+
+    PROPERTY_SETTER(else_statement)
 };
 
 class while_statement : public statement {
@@ -224,6 +243,8 @@ public:
     PROPERTY_GETTER(cond)
 
     PROPERTY_GETTER(body)
+
+    PROPERTY_SETTER(body)
 };
 
 class call_statement : public statement {
@@ -361,7 +382,7 @@ public:
 
 #define GENERATE_VISIT_CASE(type) \
     case ast::ast_node_type::type: \
-        return this->impl()->visit_##type(dynamic_cast<ast::type*>(node));
+        return this->impl()->visit_##type(static_cast<ast::type*>(node));
 
 #define GENERATE_AST_VISITOR_SWITCH() \
     switch(node->get_type()) { \
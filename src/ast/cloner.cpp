@@ -0,0 +1,85 @@
+#include "cloner.h"
+
+namespace pl0::ast {
+
+void ast_cloner::visit_variable_declaration(variable_declaration *node) {
+    throw general_error("variable declarations cannot be cloned");
+}
+
+void ast_cloner::visit_constant_declaration(constant_declaration *node) {
+    throw general_error("constant declarations cannot be cloned");
+}
+
+void ast_cloner::visit_procedure_declaration(procedure_declaration *node) {
+    throw general_error("procedure declarations cannot be cloned");
+}
+
+void ast_cloner::visit_block(block *node) {
+    throw general_error("blocks cannot be cloned");
+}
+
+void ast_cloner::visit_unary_operation(unary_operation *node) {
+    result_ = new unary_operation(node->op(), clone(node->expr()));
+}
+
+void ast_cloner::visit_binary_operation(binary_operation *node) {
+    auto left = clone(node->left());
+    result_ = new binary_operation(node->op(), left, clone(node->right()));
+}
+
+void ast_cloner::visit_literal(literal *node) {
+    result_ = new literal(node->value());
+}
+
+void ast_cloner::visit_variable_proxy(variable_proxy *node) {
+    auto iter = substitutions_.find(node->target());
+    result_ = new variable_proxy(iter == substitutions_.end() ? node->target() : iter->second);
+}
+
+void ast_cloner::visit_statement_list(statement_list *node) {
+    statement_list::list_type statements;
+    for (auto stmt : node->statements())
+        statements.push_back(clone(stmt));
+    result_ = new statement_list(std::move(statements));
+}
+
+void ast_cloner::visit_if_statement(if_statement *node) {
+    auto condition = clone(node->condition());
+    auto then_statement = clone(node->then_statement());
+    auto else_statement = node->has_else_statement() ? clone(node->else_statement()) : nullptr;
+    result_ = new if_statement(condition, then_statement, else_statement);
+}
+
+void ast_cloner::visit_while_statement(while_statement *node) {
+    auto cond = clone(node->cond());
+    result_ = new while_statement(cond, clone(node->body()));
+}
+
+void ast_cloner::visit_call_statement(call_statement *node) {
+    result_ = new call_statement(node->callee());
+}
+
+void ast_cloner::visit_read_statement(read_statement *node) {
+    read_statement::list_type targets;
+    for (auto target : node->targets())
+        targets.push_back(clone_node(target));
+    result_ = new read_statement(std::move(targets));
+}
+
+void ast_cloner::visit_write_statement(write_statement *node) {
+    write_statement::list_type expressions;
+    for (auto expr : node->expressions())
+        expressions.push_back(clone(expr));
+    result_ = new write_statement(std::move(expressions));
+}
+
+void ast_cloner::visit_assign_statement(assign_statement *node) {
+    auto target = clone_node(node->target());
+    result_ = new assign_statement(target, clone(node->expr()));
+}
+
+void ast_cloner::visit_return_statement(return_statement *node) {
+    result_ = new return_statement();
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef PL0_CLONER_H
+#define PL0_CLONER_H
+
+#include <unordered_map>
+
+#include "ast.h"
+
+namespace pl0::ast {
+
+/**
+ * Deep-copies statements and expressions. Variable proxies whose target is a
+ * key of the substitution map are redirected to the mapped symbol. Copies
+ * keep the source location of their original. Blocks and declarations own
+ * scopes and are not cloneable.
+ */
+class ast_cloner : public ast_visitor<ast_cloner> {
+    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+
+    const std::unordered_map<symbol *, symbol *> &substitutions_;
+    ast_node *result_;
+
+    DECLARE_VISIT_METHODS
+
+    template <typename T>
+    T *clone_node(T *node) {
+        visit(node);
+        result_->set_loc(node->loc());
+        return static_cast<T *>(result_);
+    }
+public:
+    explicit ast_cloner(const std::unordered_map<symbol *, symbol *> &substitutions)
+            : substitutions_(substitutions), result_(nullptr) { }
+
+    statement *clone(statement *node) { return clone_node(node); }
+
+    expression *clone(expression *node) { return clone_node(node); }
+};
+
+}
+
+#endif //PL0_CLONER_H
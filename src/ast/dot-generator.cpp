@@ -8,160 +8,163 @@
 
 namespace pl0::ast {
 
-void dot_generator::visit_constant_declaration(constant_declaration *node) {
+void dot_generator::visit_constant_declaration(flat_ast::node node) {
     auto prefix = get_name(node);
     label(prefix, "const declaration");
-    for (auto sym : node->constants()) {
+    for (auto sym : ast_->declared_symbols(node)) {
         auto sym_name = prefix + sym->get_name();
         link(prefix, sym_name);
         label(sym_name, sym->get_name());
     }
 }
 
-void dot_generator::visit_variable_declaration(variable_declaration *node) {
+void dot_generator::visit_variable_declaration(flat_ast::node node) {
     auto prefix = get_name(node);
     label(prefix, "variable declaration");
-    for (auto sym : node->variables()) {
+    for (auto sym : ast_->declared_symbols(node)) {
         auto sym_name = prefix + '_' + sym->get_name();
         link(prefix, sym_name);
         label(sym_name, sym->get_name());
     }
 }
 
-void dot_generator::visit_procedure_declaration(procedure_declaration *node) {
+void dot_generator::visit_procedure_declaration(flat_ast::node node) {
     auto prefix = get_name(node);
     auto name_field = prefix + "_name";
-    label(name_field, node->symbol()->get_name());
+    auto main_block = ast_->child(node, 0);
+    label(name_field, ast_->declared_procedure(node)->get_name());
     link(prefix, name_field);
-    link(prefix, get_name(node->main_block()));
-    visit_block(node->main_block());
+    link(prefix, get_name(main_block));
+    visit_block(main_block);
 }
 
-void dot_generator::visit_unary_operation(unary_operation *node) {
+void dot_generator::visit_unary_operation(flat_ast::node node) {
     auto name = get_name(node);
     label(name, "unary");
     auto op_name = name + "_op";
-    label(op_name, *node->op());
+    label(op_name, *ast_->op(node));
     link(name, op_name);
-    link(name, get_name(node->expr()));
-    visit(node->expr());
+    link(name, get_name(ast_->child(node, 0)));
+    visit(ast_->child(node, 0));
 }
 
-void dot_generator::visit_binary_operation(binary_operation *node) {
+void dot_generator::visit_binary_operation(flat_ast::node node) {
     auto name = get_name(node);
     label(name, "binary");
     auto op_name = name + "_op";
-    label(op_name, *node->op());
+    label(op_name, *ast_->op(node));
     link(name, op_name);
-    link(name, get_name(node->left()));
-    link(name, get_name(node->right()));
-    visit(node->left());
-    visit(node->right());
+    link(name, get_name(ast_->child(node, 0)));
+    link(name, get_name(ast_->child(node, 1)));
+    visit(ast_->child(node, 0));
+    visit(ast_->child(node, 1));
 }
 
-void dot_generator::visit_variable_proxy(variable_proxy *node) {
-    label(get_name(node), "variable " + node->target()->get_name());
+void dot_generator::visit_variable_proxy(flat_ast::node node) {
+    label(get_name(node), "variable " + ast_->target(node)->get_name());
 }
 
-void dot_generator::visit_literal(literal *node) {
-    label(get_name(node), "literal " + std::to_string(node->value()));
+void dot_generator::visit_literal(flat_ast::node node) {
+    label(get_name(node), "literal " + std::to_string(ast_->value(node)));
 }
 
-void dot_generator::visit_block(block *node) {
+void dot_generator::visit_block(flat_ast::node node) {
     auto name = get_name(node);
     label(name, "block");
-    if (node->const_declaration()) {
-        link(name, get_name(node->const_declaration()));
-        visit_constant_declaration(node->const_declaration());
+    auto children = ast_->children(node);
+    for (auto child : children) {
+        if (ast_->kind(child) == ast_node_type::constant_declaration) {
+            link(name, get_name(child));
+            visit_constant_declaration(child);
+        }
     }
-    if (node->var_declaration()) {
-        link(name, get_name(node->var_declaration()));
-        visit_variable_declaration(node->var_declaration());
+    for (auto child : children) {
+        if (ast_->kind(child) == ast_node_type::variable_declaration) {
+            link(name, get_name(child));
+            visit_variable_declaration(child);
+        }
     }
-    for (auto method : node->sub_procedures()) {
-        auto method_name = get_name(method);
+    for (auto child : children) {
+        if (ast_->kind(child) != ast_node_type::procedure_declaration)
+            continue;
+        auto method_name = get_name(child);
         link(name, method_name);
-        label(method_name, "procedure " + method->symbol()->get_name());
-        visit_procedure_declaration(method);
+        label(method_name, "procedure " + ast_->declared_procedure(child)->get_name());
+        visit_procedure_declaration(child);
     }
-    link(name, get_name(node->body()));
-    visit(node->body());
+    link(name, get_name(children.back()));
+    visit(children.back());
 }
 
-void dot_generator::visit_assign_statement(assign_statement *node) {
+void dot_generator::visit_assign_statement(flat_ast::node node) {
     auto name = get_name(node);
     label(name, "assign");
-    link(name, get_name(node->target()));
-    link(name, get_name(node->expr()));
-    visit_variable_proxy(node->target());
-    visit(node->expr());
+    link(name, get_name(ast_->child(node, 0)));
+    link(name, get_name(ast_->child(node, 1)));
+    visit_variable_proxy(ast_->child(node, 0));
+    visit(ast_->child(node, 1));
 }
 
-void dot_generator::visit_call_statement(call_statement *node) {
+void dot_generator::visit_call_statement(flat_ast::node node) {
     auto name = get_name(node);
     label(name, "call");
-    link(name, node->callee());
+    link(name, ast_->callee(node));
 }
 
-void dot_generator::visit_if_statement(if_statement *node) {
+void dot_generator::visit_if_statement(flat_ast::node node) {
     auto name = get_name(node);
     label(name, "if");
-    auto cond = get_name(node->condition());
-    auto then = get_name(node->then_statement());
-    auto otherwise = get_name(node->else_statement());
-    link(name, cond);
-    link(name, then);
-    if (node->has_else_statement())
-        link(name, otherwise);
-    visit(node->condition());
-    visit(node->then_statement());
-    if (node->has_else_statement())
-        visit(node->else_statement());
-}
-
-void dot_generator::visit_read_statement(read_statement *node) {
+    for (auto child : ast_->children(node))
+        link(name, get_name(child));
+    for (auto child : ast_->children(node))
+        visit(child);
+}
+
+void dot_generator::visit_read_statement(flat_ast::node node) {
     auto name = get_name(node);
     label(name, "read");
-    for (auto sym : node->targets())
-        link(name, name + sym->target()->get_name());
+    for (auto target : ast_->children(node))
+        link(name, name + ast_->target(target)->get_name());
 }
 
-void dot_generator::visit_return_statement(return_statement *node) {
+void dot_generator::visit_return_statement(flat_ast::node node) {
     auto name = get_name(node);
     label(name, "return");
 }
 
-void dot_generator::visit_statement_list(statement_list *node) {
+void dot_generator::visit_statement_list(flat_ast::node node) {
     auto name = get_name(node);
     label(name, "statements");
-    for (auto stmt : node->statements()) {
+    for (auto stmt : ast_->children(node)) {
         link(name, get_name(stmt));
         visit(stmt);
     }
 }
 
-void dot_generator::visit_while_statement(while_statement *node) {
+void dot_generator::visit_while_statement(flat_ast::node node) {
     auto name = get_name(node);
     label(name, "while");
-    link(name, get_name(node->cond()));
-    link(name, get_name(node->body()));
-    visit(node->cond());
-    visit(node->body());
+    link(name, get_name(ast_->child(node, 0)));
+    link(name, get_name(ast_->child(node, 1)));
+    visit(ast_->child(node, 0));
+    visit(ast_->child(node, 1));
 }
 
-void dot_generator::visit_write_statement(write_statement *node) {
+void dot_generator::visit_write_statement(flat_ast::node node) {
     auto name = get_name(node);
     label(name, "write");
-    for (auto expr : node->expressions()) {
+    for (auto expr : ast_->children(node)) {
         link(name, get_name(expr));
         visit(expr);
     }
 }
 
-void dot_generator::generate(block *root) {
+void dot_generator::generate(const flat_ast &program) {
+    ast_ = &program;
     source_ << "digraph G {\n";
-    visit_block(root);
+    visit_block(flat_ast::root);
     source_ << "}\n";
+    ast_ = nullptr;
 }
 
 void dot_generator::save_to_file(const char *filename) {
@@ -170,4 +173,4 @@ void dot_generator::save_to_file(const char *filename) {
     ofs.close();
 }
 
-}
\ No newline at end of file
+}
@@ -12,16 +12,17 @@
 #include <unordered_map>
 
 #include "ast.h"
+#include "flat-ast.h"
 
 namespace pl0::ast {
 
-class dot_generator : public ast_visitor<dot_generator> {
-    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+class dot_generator : public flat_ast_visitor<dot_generator> {
+    DEFINE_FLAT_AST_VISITOR_SUBCLASS_MEMBERS()
 
     std::ostringstream source_;
 
-    std::string get_name(ast_node *node) const {
-        return 't' + std::to_string(reinterpret_cast<uint64_t>(node));
+    std::string get_name(flat_ast::node node) const {
+        return 't' + std::to_string(node);
     }
 
     void link(const std::string &from, const std::string &to) {
@@ -32,11 +33,15 @@ class dot_generator : public ast_visitor<dot_generator> {
         source_ << name << " [label=\"" << label << "\"];\n";
     }
 
-    DECLARE_VISIT_METHODS
+    DECLARE_FLAT_VISIT_METHODS
 public:
     dot_generator() = default;
 
-    void generate(block *root);
+    void generate(const flat_ast &program);
+
+    void generate(block *root) {
+        generate(flat_ast{ root });
+    }
 
     void save_to_file(const char *filename);
 };
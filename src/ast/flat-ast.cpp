@@ -0,0 +1,177 @@
+#include "flat-ast.h"
+
+namespace pl0::ast {
+
+class flat_ast::builder : public ast_visitor<builder> {
+    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+
+    flat_ast &ast_;
+    // children of the nodes being built, innermost last
+    std::vector<node> pending_;
+
+    node add(ast_node *n, int32_t operand) {
+        auto id = static_cast<node>(ast_.kinds_.size());
+        ast_.kinds_.push_back(static_cast<uint8_t>(n->get_type()));
+        ast_.operands_.push_back(operand);
+        ast_.first_.push_back(0);
+        ast_.counts_.push_back(0);
+        ast_.lines_.push_back(n->loc().line);
+        return id;
+    }
+
+    // builds a node from its children, which are flattened by `children`
+    template <typename function>
+    void add_with_children(ast_node *n, int32_t operand, function children) {
+        auto id = add(n, operand);
+        auto mark = pending_.size();
+        children();
+        ast_.first_[id] = static_cast<int32_t>(ast_.children_.size());
+        ast_.counts_[id] = static_cast<int32_t>(pending_.size() - mark);
+        ast_.children_.insert(ast_.children_.end(), pending_.begin() + mark, pending_.end());
+        pending_.resize(mark);
+        pending_.push_back(id);
+    }
+
+    void add_leaf(ast_node *n, int32_t operand) {
+        pending_.push_back(add(n, operand));
+    }
+
+    template <typename T>
+    void add_declaration(ast_node *n, const std::vector<T *> &symbols) {
+        auto id = add(n, 0);
+        ast_.first_[id] = static_cast<int32_t>(ast_.symbols_.size());
+        ast_.counts_[id] = static_cast<int32_t>(symbols.size());
+        ast_.symbols_.insert(ast_.symbols_.end(), symbols.begin(), symbols.end());
+        pending_.push_back(id);
+    }
+
+    int32_t add_symbol(symbol *sym) {
+        ast_.symbols_.push_back(sym);
+        return static_cast<int32_t>(ast_.symbols_.size() - 1);
+    }
+public:
+    explicit builder(flat_ast &ast) : ast_(ast) { }
+
+    DECLARE_VISIT_METHODS
+};
+
+void flat_ast::builder::visit_variable_declaration(variable_declaration *node) {
+    add_declaration(node, node->variables());
+}
+
+void flat_ast::builder::visit_constant_declaration(constant_declaration *node) {
+    add_declaration(node, node->constants());
+}
+
+void flat_ast::builder::visit_procedure_declaration(procedure_declaration *node) {
+    add_with_children(node, add_symbol(node->symbol()), [&]() { visit_block(node->main_block()); });
+}
+
+void flat_ast::builder::visit_block(block *node) {
+    ast_.scopes_.push_back(node->belonging_scope());
+    add_with_children(node, static_cast<int32_t>(ast_.scopes_.size() - 1), [&]() {
+        if (node->var_declaration())
+            visit_variable_declaration(node->var_declaration());
+        if (node->const_declaration())
+            visit_constant_declaration(node->const_declaration());
+        for (auto method : node->sub_procedures())
+            visit_procedure_declaration(method);
+        visit(node->body());
+    });
+}
+
+void flat_ast::builder::visit_unary_operation(unary_operation *node) {
+    add_with_children(node, static_cast<int32_t>(node->op()), [&]() { visit(node->expr()); });
+}
+
+void flat_ast::builder::visit_binary_operation(binary_operation *node) {
+    add_with_children(node, static_cast<int32_t>(node->op()), [&]() {
+        visit(node->left());
+        visit(node->right());
+    });
+}
+
+void flat_ast::builder::visit_literal(literal *node) {
+    add_leaf(node, node->value());
+}
+
+void flat_ast::builder::visit_variable_proxy(variable_proxy *node) {
+    add_leaf(node, add_symbol(node->target()));
+}
+
+void flat_ast::builder::visit_statement_list(statement_list *node) {
+    add_with_children(node, 0, [&]() {
+        for (auto stmt : node->statements())
+            visit(stmt);
+    });
+}
+
+void flat_ast::builder::visit_if_statement(if_statement *node) {
+    add_with_children(node, 0, [&]() {
+        visit(node->condition());
+        visit(node->then_statement());
+        if (node->has_else_statement())
+            visit(node->else_statement());
+    });
+}
+
+void flat_ast::builder::visit_while_statement(while_statement *node) {
+    add_with_children(node, 0, [&]() {
+        visit(node->cond());
+        visit(node->body());
+    });
+}
+
+void flat_ast::builder::visit_call_statement(call_statement *node) {
+    ast_.names_.push_back(node->callee());
+    add_leaf(node, static_cast<int32_t>(ast_.names_.size() - 1));
+}
+
+void flat_ast::builder::visit_read_statement(read_statement *node) {
+    add_with_children(node, 0, [&]() {
+        for (auto target : node->targets())
+            visit_variable_proxy(target);
+    });
+}
+
+void flat_ast::builder::visit_write_statement(write_statement *node) {
+    add_with_children(node, 0, [&]() {
+        for (auto expr : node->expressions())
+            visit(expr);
+    });
+}
+
+void flat_ast::builder::visit_assign_statement(assign_statement *node) {
+    add_with_children(node, 0, [&]() {
+        visit_variable_proxy(node->target());
+        visit(node->expr());
+    });
+}
+
+void flat_ast::builder::visit_return_statement(return_statement *node) {
+    add_leaf(node, 0);
+}
+
+flat_ast::flat_ast(block *program) {
+    builder{ *this }.visit_block(program);
+    // the arrays live as long as the flat AST, their growth slack would too
+    kinds_.shrink_to_fit();
+    operands_.shrink_to_fit();
+    first_.shrink_to_fit();
+    counts_.shrink_to_fit();
+    lines_.shrink_to_fit();
+    children_.shrink_to_fit();
+    symbols_.shrink_to_fit();
+    scopes_.shrink_to_fit();
+    names_.shrink_to_fit();
+}
+
+size_t flat_ast::memory_bytes() const {
+    return kinds_.capacity() * sizeof(kinds_[0]) + operands_.capacity() * sizeof(operands_[0]) +
+           first_.capacity() * sizeof(first_[0]) + counts_.capacity() * sizeof(counts_[0]) +
+           lines_.capacity() * sizeof(lines_[0]) + children_.capacity() * sizeof(children_[0]) +
+           symbols_.capacity() * sizeof(symbols_[0]) + scopes_.capacity() * sizeof(scopes_[0]) +
+           names_.capacity() * sizeof(names_[0]);
+}
+
+}
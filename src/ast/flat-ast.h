@@ -0,0 +1,155 @@
+#ifndef PL0_FLAT_AST_H
+#define PL0_FLAT_AST_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+
+namespace pl0::ast {
+
+/**
+ * The AST stored in a few flat arrays instead of a tree of heap nodes. A
+ * node is an index: its kind, operand, source line and the range of its
+ * children in a shared child array are kept in parallel arrays, so a
+ * traversal reads memory mostly in order and dispatches on the kind without
+ * casts. Nodes are numbered in preorder and the program's block is node 0.
+ *
+ * The children of a node, in order:
+ *
+ *     block                  its variable and constant declaration if any,
+ *                            its procedure declarations, its body
+ *     procedure_declaration  the procedure's block
+ *     statement_list         the statements
+ *     if_statement           condition, then statement, else statement if any
+ *     while_statement        condition, body
+ *     read_statement         the variable proxies read into
+ *     write_statement        the expressions written
+ *     assign_statement       the variable proxy assigned, the expression
+ *     unary_operation        the operand
+ *     binary_operation       left, right
+ *
+ * Declarations refer to their symbols instead of having children. Symbols
+ * and scopes stay owned by the tree the flat AST was made from.
+ */
+class flat_ast {
+public:
+    typedef int32_t node;
+
+    static constexpr node root = 0;
+
+    // the children of a node or the symbols of a declaration
+    template <typename T>
+    class range {
+        const T *begin_;
+        const T *end_;
+    public:
+        range(const T *begin, const T *end) : begin_(begin), end_(end) { }
+
+        const T *begin() const { return begin_; }
+
+        const T *end() const { return end_; }
+
+        size_t size() const { return static_cast<size_t>(end_ - begin_); }
+
+        bool empty() const { return begin_ == end_; }
+
+        const T &operator[](size_t index) const { return begin_[index]; }
+
+        const T &back() const { return end_[-1]; }
+    };
+private:
+    std::vector<uint8_t> kinds_;
+    // scope of a block, symbol of a procedure declaration or variable proxy,
+    // name of a callee, operator token or literal value
+    std::vector<int32_t> operands_;
+    // range in children_, or in symbols_ for declarations
+    std::vector<int32_t> first_;
+    std::vector<int32_t> counts_;
+    std::vector<int32_t> lines_;
+    std::vector<node> children_;
+    std::vector<symbol *> symbols_;
+    std::vector<scope *> scopes_;
+    std::vector<std::string> names_;
+
+    class builder;
+public:
+    explicit flat_ast(block *program);
+
+    size_t size() const { return kinds_.size(); }
+
+    ast_node_type kind(node n) const { return static_cast<ast_node_type>(kinds_[n]); }
+
+    // 0 for nodes made by the optimizer
+    int line(node n) const { return lines_[n]; }
+
+    // of any node but a variable or constant declaration
+    range<node> children(node n) const {
+        auto first = children_.data() + first_[n];
+        return { first, first + counts_[n] };
+    }
+
+    node child(node n, int index) const { return children_[first_[n] + index]; }
+
+    // of a block
+    scope *belonging_scope(node n) const { return scopes_[operands_[n]]; }
+
+    // of a procedure declaration
+    procedure *declared_procedure(node n) const { return static_cast<procedure *>(symbols_[operands_[n]]); }
+
+    // of a variable or constant declaration
+    range<symbol *> declared_symbols(node n) const {
+        auto first = symbols_.data() + first_[n];
+        return { first, first + counts_[n] };
+    }
+
+    // of a variable proxy
+    symbol *target(node n) const { return symbols_[operands_[n]]; }
+
+    // of a call statement
+    const std::string &callee(node n) const { return names_[operands_[n]]; }
+
+    // of a unary or binary operation
+    token op(node n) const { return static_cast<token>(operands_[n]); }
+
+    // of a literal
+    int value(node n) const { return operands_[n]; }
+
+    // bytes the arrays hold, not counting callee names too long to be stored inline
+    size_t memory_bytes() const;
+};
+
+template <class Visitor>
+class flat_ast_visitor {
+protected:
+    const flat_ast *ast_ = nullptr;
+
+    Visitor *impl() {
+        return static_cast<Visitor *>(this);
+    }
+};
+
+#define DECLARE_FLAT_VISIT(type) \
+    void visit_##type(ast::flat_ast::node node);
+
+#define DECLARE_FLAT_VISIT_METHODS \
+    AST_NODE_LIST(DECLARE_FLAT_VISIT)
+
+#define GENERATE_FLAT_VISIT_CASE(type) \
+    case ast::ast_node_type::type: \
+        return this->impl()->visit_##type(node);
+
+#define GENERATE_FLAT_AST_VISITOR_SWITCH() \
+    switch (this->ast_->kind(node)) { \
+        AST_NODE_LIST(GENERATE_FLAT_VISIT_CASE) \
+    }
+
+#define DEFINE_FLAT_AST_VISITOR_SUBCLASS_MEMBERS() \
+    void visit(ast::flat_ast::node node) { \
+        GENERATE_FLAT_AST_VISITOR_SWITCH() \
+    }
+
+}
+
+#endif //PL0_FLAT_AST_H
@@ -0,0 +1,98 @@
+#include "node-counter.h"
+
+namespace pl0::ast {
+
+size_t node_counter::count(ast_node *node) {
+    count_ = 0;
+    if (node)
+        visit(node);
+    return count_;
+}
+
+void node_counter::visit_variable_declaration(variable_declaration *node) {
+    count_++;
+}
+
+void node_counter::visit_constant_declaration(constant_declaration *node) {
+    count_++;
+}
+
+void node_counter::visit_procedure_declaration(procedure_declaration *node) {
+    count_++;
+    visit_block(node->main_block());
+}
+
+void node_counter::visit_block(block *node) {
+    count_++;
+    if (node->var_declaration())
+        visit_variable_declaration(node->var_declaration());
+    if (node->const_declaration())
+        visit_constant_declaration(node->const_declaration());
+    for (auto method : node->sub_procedures())
+        visit_procedure_declaration(method);
+    visit(node->body());
+}
+
+void node_counter::visit_unary_operation(unary_operation *node) {
+    count_++;
+    visit(node->expr());
+}
+
+void node_counter::visit_binary_operation(binary_operation *node) {
+    count_++;
+    visit(node->left());
+    visit(node->right());
+}
+
+void node_counter::visit_literal(literal *node) {
+    count_++;
+}
+
+void node_counter::visit_variable_proxy(variable_proxy *node) {
+    count_++;
+}
+
+void node_counter::visit_statement_list(statement_list *node) {
+    count_++;
+    for (auto stmt : node->statements())
+        visit(stmt);
+}
+
+void node_counter::visit_if_statement(if_statement *node) {
+    count_++;
+    visit(node->condition());
+    visit(node->then_statement());
+    if (node->has_else_statement())
+        visit(node->else_statement());
+}
+
+void node_counter::visit_while_statement(while_statement *node) {
+    count_++;
+    visit(node->cond());
+    visit(node->body());
+}
+
+void node_counter::visit_call_statement(call_statement *node) {
+    count_++;
+}
+
+void node_counter::visit_read_statement(read_statement *node) {
+    count_ += 1 + node->targets().size();
+}
+
+void node_counter::visit_write_statement(write_statement *node) {
+    count_++;
+    for (auto expr : node->expressions())
+        visit(expr);
+}
+
+void node_counter::visit_assign_statement(assign_statement *node) {
+    count_ += 2;
+    visit(node->expr());
+}
+
+void node_counter::visit_return_statement(return_statement *node) {
+    count_++;
+}
+
+}
@@ -0,0 +1,24 @@
+#ifndef PL0_NODE_COUNTER_H
+#define PL0_NODE_COUNTER_H
+
+#include <cstddef>
+
+#include "ast.h"
+
+namespace pl0::ast {
+
+class node_counter : public ast_visitor<node_counter> {
+    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+
+    size_t count_;
+
+    DECLARE_VISIT_METHODS
+public:
+    node_counter() : count_(0) { }
+
+    size_t count(ast_node *node);
+};
+
+}
+
+#endif //PL0_NODE_COUNTER_H
@@ -4,112 +4,115 @@ namespace pl0::ast {
 
 // declaration visitor methods
 
-void ast_printer::visit_constant_declaration(constant_declaration *node) {
+void ast_printer::visit_constant_declaration(flat_ast::node node) {
     out_ << "constant declaration [ ";
-    for (auto sym : node->constants())
+    for (auto sym : ast_->declared_symbols(node))
         out_ << sym->get_name() << ' ';
     out_.put(']');
 }
 
-void ast_printer::visit_variable_declaration(variable_declaration *node) {
+void ast_printer::visit_variable_declaration(flat_ast::node node) {
     out_ << "variable declaration [ ";
-    for (auto sym : node->variables())
+    for (auto sym : ast_->declared_symbols(node))
         out_ << sym->get_name() << ' ';
     out_.put(']');
 }
 
-void ast_printer::visit_procedure_declaration(procedure_declaration *node) {
+void ast_printer::visit_procedure_declaration(flat_ast::node node) {
     out_ << "procedure declaration";
     begin_block();
     end_line();
-    visit_block(node->main_block());
+    visit_block(ast_->child(node, 0));
     end_block();
 }
 
 // statement visitor methods
 
-void ast_printer::visit_assign_statement(assign_statement *node) {
+void ast_printer::visit_assign_statement(flat_ast::node node) {
     // assign statement {
     out_ << "assign statement";
     begin_block();
     end_line();
     out_ << "target = ";
-    visit_variable_proxy(node->target());
+    visit_variable_proxy(ast_->child(node, 0));
     // expression =
     end_line();
-    visit(node->expr());
+    visit(ast_->child(node, 1));
     end_block();
 }
 
-void ast_printer::visit_if_statement(if_statement *node) {
+void ast_printer::visit_if_statement(flat_ast::node node) {
+    auto children = ast_->children(node);
     out_ << "while";
     begin_block();
     end_line();
     out_ << "condition = ";
-    visit(node->condition());
+    visit(children[0]);
     end_line();
     out_ << "consequence = ";
-    visit(node->then_statement());
-    if (node->has_else_statement()) {
+    visit(children[1]);
+    if (children.size() == 3) {
         end_line();
         out_ << "alternation = ";
-        visit(node->else_statement());
+        visit(children[2]);
     }
     end_block();
 }
 
-void ast_printer::visit_while_statement(while_statement *node) {
+void ast_printer::visit_while_statement(flat_ast::node node) {
     out_ << "while";
     begin_block();
     end_line();
     out_ << "condition = ";
-    visit(node->cond());
+    visit(ast_->child(node, 0));
     end_line();
     out_ << "body = ";
-    visit(node->body());
+    visit(ast_->child(node, 1));
     end_block();
 }
 
-void ast_printer::visit_call_statement(call_statement *node) {
-    out_ << "invoke " << node->callee();
+void ast_printer::visit_call_statement(flat_ast::node node) {
+    out_ << "invoke " << ast_->callee(node);
 }
 
-void ast_printer::visit_block(block *node) {
+void ast_printer::visit_block(flat_ast::node node) {
+    auto children = ast_->children(node);
     out_ << "block";
     begin_block();
     end_line();
-    if (node->var_declaration()) {
+    size_t next = 0;
+    if (ast_->kind(children[next]) == ast_node_type::variable_declaration) {
         out_ << "variables = ";
-        visit_variable_declaration(node->var_declaration());
+        visit_variable_declaration(children[next++]);
         end_line();
     }
-    if (node->const_declaration()) {
+    if (ast_->kind(children[next]) == ast_node_type::constant_declaration) {
         out_ << "constants = ";
-        visit_constant_declaration(node->const_declaration());
+        visit_constant_declaration(children[next++]);
         end_line();
     }
-    if (!node->sub_procedures().empty()) {
+    if (next + 1 < children.size()) {
         out_ << "procedures:";
         begin_block();
         int index = 0;
-        for (auto method : node->sub_procedures()) {
+        for (; next + 1 < children.size(); next++) {
             end_line();
             out_ << '[' << index++ << "] = ";
-            visit_procedure_declaration(method);
+            visit_procedure_declaration(children[next]);
         }
         end_block();
         end_line();
     }
     out_ << "body = ";
-    visit(node->body());
+    visit(children.back());
     end_block();
 }
 
-void ast_printer::visit_statement_list(statement_list *node) {
+void ast_printer::visit_statement_list(flat_ast::node node) {
     out_ << "statement list";
     increase_indent();
     int index = 0;
-    for (auto statement : node->statements()) {
+    for (auto statement : ast_->children(node)) {
         end_line();
         out_ << '[' << index++ << "] = ";
         visit(statement);
@@ -117,49 +120,49 @@ void ast_printer::visit_statement_list(statement_list *node) {
     end_block();
 }
 
-void ast_printer::visit_read_statement(read_statement *node) {
+void ast_printer::visit_read_statement(flat_ast::node node) {
     out_ << "read statement";
 }
 
-void ast_printer::visit_write_statement(write_statement *node) {
+void ast_printer::visit_write_statement(flat_ast::node node) {
     out_ << "write statement";
 }
 
-void ast_printer::visit_return_statement(return_statement *node) {
+void ast_printer::visit_return_statement(flat_ast::node node) {
     out_ << "return statement";
 }
 
 // expression visitor methods
 
-void ast_printer::visit_unary_operation(unary_operation *node) {
+void ast_printer::visit_unary_operation(flat_ast::node node) {
     out_ << "unary operation";
     begin_block();
     end_line();
-    out_ << "operator = " << *node->op();
+    out_ << "operator = " << *ast_->op(node);
     end_line();
     out_ << "expression = ";
-    visit(node->expr());
+    visit(ast_->child(node, 0));
     end_block();
 }
 
-void ast_printer::visit_binary_operation(binary_operation *node) {
+void ast_printer::visit_binary_operation(flat_ast::node node) {
     // binary operation {
     out_ << "binary operation";
     begin_block();
     end_line();
     // operator =
-    out_ << "operator = '" << *node->op() << '\'';
+    out_ << "operator = '" << *ast_->op(node) << '\'';
     end_line();
     out_ << "left = ";
-    visit(node->left());
+    visit(ast_->child(node, 0));
     end_line();
     out_ << "right = ";
-    visit(node->right());
+    visit(ast_->child(node, 1));
     end_block();
 }
 
-void ast_printer::visit_variable_proxy(variable_proxy *node) {
-    symbol *sym = node->target();
+void ast_printer::visit_variable_proxy(flat_ast::node node) {
+    symbol *sym = ast_->target(node);
     if (sym->is_constant()) {
         out_ << "constant ";
     } else if (sym->is_variable()) {
@@ -167,11 +170,17 @@ void ast_printer::visit_variable_proxy(variable_proxy *node) {
     } else if (sym->is_procedure()) {
         out_ << "procedure ";
     }
-    out_ << node->target()->get_name();
+    out_ << sym->get_name();
 }
 
-void ast_printer::visit_literal(literal *node) {
-    out_ << "literal " << node->value();
+void ast_printer::visit_literal(flat_ast::node node) {
+    out_ << "literal " << ast_->value(node);
+}
+
+void ast_printer::print(const flat_ast &program) {
+    ast_ = &program;
+    visit_block(flat_ast::root);
+    ast_ = nullptr;
 }
 
 }
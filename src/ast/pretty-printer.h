@@ -4,11 +4,12 @@
 #include <ostream>
 
 #include "ast.h"
+#include "flat-ast.h"
 
 namespace pl0::ast {
 
-class ast_printer : public ast_visitor<ast_printer> {
-    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+class ast_printer : public flat_ast_visitor<ast_printer> {
+    DEFINE_FLAT_AST_VISITOR_SUBCLASS_MEMBERS()
 
     std::ostream &out_;
     const int indent_size_;
@@ -39,11 +40,17 @@ class ast_printer : public ast_visitor<ast_printer> {
         out_ << "}";
     }
 
+    DECLARE_FLAT_VISIT_METHODS
+
 public:
     explicit ast_printer(std::ostream &out, int indent_size = 2)
             : out_(out), indent_size_(indent_size), indent_level_(0) { }
 
-    DECLARE_VISIT_METHODS
+    void print(const flat_ast &program);
+
+    void print(block *program) {
+        print(flat_ast{ program });
+    }
 };
 
 }
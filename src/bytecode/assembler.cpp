@@ -6,6 +6,7 @@ namespace pl0 {
 
 void assembler::emit(opcode op, int level, int address) {
     code_.push_back({ op, level, address });
+    lines_.append(line_);
 }
 
 int assembler::get_next_address() {
@@ -37,6 +38,16 @@ backpatcher assembler::call(int caller_level) {
     return backpatcher { code_, get_last_address() };
 }
 
+backpatcher assembler::tail_call(int caller_level) {
+    emit(opcode::TCL, caller_level, IGNORE);
+    return backpatcher { code_, get_last_address() };
+}
+
+backpatcher assembler::static_call(int caller_level) {
+    emit(opcode::SCL, caller_level, IGNORE);
+    return backpatcher { code_, get_last_address() };
+}
+
 void assembler::branch(int target) {
     emit(opcode::JMP, IGNORE, target);
 }
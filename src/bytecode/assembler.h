@@ -10,6 +10,8 @@ namespace pl0 {
 
 class assembler {
     bytecode code_;
+    line_table lines_;
+    int line_ = 0;
 
     void emit(opcode op, int level, int address);
 public:
@@ -20,6 +22,8 @@ public:
     void store(int distance, int index);
     void        call(int distance, int entry);
     backpatcher call(int caller_level);
+    backpatcher tail_call(int caller_level);
+    backpatcher static_call(int caller_level);
     void        branch(int target);
     backpatcher branch();
     void        branch_if_false(int target);
@@ -30,7 +34,12 @@ public:
     void write();
     void operation(token tk);
 
+    // source line of the instructions emitted from now on
+    void set_line(int line) { line_ = line; }
+    int  get_line() const { return line_; }
+
     const bytecode &get_bytecode();
+    const line_table &get_lines() const { return lines_; }
 };
 
 }
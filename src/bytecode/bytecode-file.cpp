@@ -0,0 +1,108 @@
+#include <string>
+
+#include "bytecode-file.h"
+#include "../util.h"
+
+namespace pl0 {
+
+namespace {
+
+const char *const magic = "pl0-bytecode";
+const int version = 1;
+
+void expect(std::istream &in, const char *word) {
+    std::string actual;
+    if (!(in >> actual) || actual != word)
+        throw general_error("malformed bytecode file: expected \"", word, '"');
+}
+
+int read_count(std::istream &in, const char *what) {
+    int count;
+    if (!(in >> count) || count < 0)
+        throw general_error("malformed bytecode file: bad ", what, " count");
+    return count;
+}
+
+}
+
+void save_bytecode(std::ostream &out, const bytecode &code, const procedure_table &procedures,
+                   const line_table &lines) {
+    out << magic << ' ' << version << '\n';
+    out << "procedures " << procedures.size() << '\n';
+    for (auto &info : procedures)
+        out << info.entry << ' ' << info.level << ' ' << info.name << '\n';
+    out << "code " << code.size() << '\n';
+    for (auto &ins : code)
+        out << *ins.op << ' ' << ins.level << ' ' << ins.address << '\n';
+    if (lines.empty() || lines.size() != static_cast<int>(code.size()))
+        return;
+    out << "lines " << lines.runs().size() << '\n';
+    for (auto &run : lines.runs())
+        out << run.start << ' ' << run.line << '\n';
+}
+
+void load_bytecode(std::istream &in, bytecode &code, procedure_table &procedures, line_table &lines) {
+    int file_version;
+    expect(in, magic);
+    if (!(in >> file_version) || file_version != version)
+        throw general_error("unsupported bytecode file version");
+
+    expect(in, "procedures");
+    int count = read_count(in, "procedure");
+    procedures.clear();
+    for (int i = 0; i < count; i++) {
+        procedure_info info;
+        if (!(in >> info.entry >> info.level >> info.name))
+            throw general_error("malformed bytecode file: bad procedure ", i);
+        procedures.push_back(std::move(info));
+    }
+
+    expect(in, "code");
+    count = read_count(in, "instruction");
+    code.clear();
+    for (int i = 0; i < count; i++) {
+        std::string name;
+        instruction ins{ };
+        if (!(in >> name >> ins.level >> ins.address))
+            throw general_error("malformed bytecode file: bad instruction ", i);
+        int op = 0;
+        while (op < static_cast<int>(sizeof opcode_name / sizeof opcode_name[0]) && name != opcode_name[op])
+            op++;
+        if (op == static_cast<int>(sizeof opcode_name / sizeof opcode_name[0]))
+            throw general_error("malformed bytecode file: unknown opcode ", name);
+        ins.op = opcode(op);
+        code.push_back(ins);
+    }
+
+    // the VM trusts its jump targets
+    for (auto &ins : code) {
+        bool jumps = ins.op == opcode::JMP || ins.op == opcode::JPC || ins.op == opcode::CAL ||
+                     ins.op == opcode::TCL || ins.op == opcode::SCL;
+        if (jumps && (ins.address < 0 || ins.address > static_cast<int>(code.size())))
+            throw general_error("malformed bytecode file: jump target ", ins.address, " out of range");
+    }
+
+    lines = line_table{ };
+    std::string section;
+    if (!(in >> section))
+        return;
+    if (section != "lines")
+        throw general_error("malformed bytecode file: expected \"lines\"");
+    count = read_count(in, "line");
+    int previous = -1, line = 0;
+    for (int i = 0; i < count; i++) {
+        int start;
+        if (!(in >> start >> line) || start <= previous || (i == 0 && start != 0) ||
+            start >= static_cast<int>(code.size()) || line < 0)
+            throw general_error("malformed bytecode file: bad line ", i);
+        // fill in the run before this one
+        for (int address = lines.size(); address < start; address++)
+            lines.append(lines.line(lines.size() - 1));
+        lines.append(line);
+        previous = start;
+    }
+    while (lines.size() < static_cast<int>(code.size()))
+        lines.append(line);
+}
+
+}
@@ -0,0 +1,35 @@
+#ifndef PL0_BYTECODE_FILE_H
+#define PL0_BYTECODE_FILE_H
+
+#include <istream>
+#include <ostream>
+
+#include "bytecode.h"
+
+namespace pl0 {
+
+/*
+ * A line based text format for compiled programs, so that a program can be
+ * compiled (and partially evaluated) once and run many times:
+ *
+ *     pl0-bytecode 1
+ *     procedures <count>
+ *     <entry> <level> <name>      one line per procedure
+ *     code <count>
+ *     <opcode> <level> <address>  one line per instruction
+ *     lines <count>               optional
+ *     <address> <line>            one line per run of the line table
+ *
+ * Procedure symbols are not saved, so loaded procedures have none. Files
+ * without a line table load with every line unknown.
+ */
+
+void save_bytecode(std::ostream &out, const bytecode &code, const procedure_table &procedures,
+                   const line_table &lines);
+
+// throws general_error if the input is not a well-formed bytecode file
+void load_bytecode(std::istream &in, bytecode &code, procedure_table &procedures, line_table &lines);
+
+}
+
+#endif //PL0_BYTECODE_FILE_H
@@ -1,14 +1,18 @@
 #ifndef PL_ZERO_BYTECODE_H
 #define PL_ZERO_BYTECODE_H
 
+#include <algorithm>
+#include <iterator>
+#include <string>
 #include <vector>
 
+#include "../parsing/symbol.h"
 #include "../parsing/token.h"
 
 namespace pl0 {
 
 #define OPCODE_LIST(T) \
-    T(LIT) T(LOD) T(STO) T(CAL) T(INT) T(JMP) T(JPC) T(OPR)
+    T(LIT) T(LOD) T(STO) T(CAL) T(INT) T(JMP) T(JPC) T(OPR) T(TCL) T(SCL)
 
 #define T(x) x,
 enum class opcode : int {
@@ -43,6 +47,12 @@ const std::unordered_map<token, opt> token2opt = {
 };
 #undef OPERATOR
 
+#define OPERATOR(name, string) { opt::name, token::name },
+const std::unordered_map<opt, token> opt2token = {
+    TOKEN_LIST(IGNORE_TOKEN, OPERATOR, IGNORE_TOKEN)
+};
+#undef OPERATOR
+
 struct instruction {
     opcode op;
     int level;
@@ -51,6 +61,55 @@ struct instruction {
 
 typedef std::vector<instruction> bytecode;
 
+/**
+ * Source line of every instruction, kept beside the code instead of in it.
+ * Consecutive instructions of one line form a run stored as its first
+ * address and the line, so a table has about one entry per statement.
+ * Line 0 means unknown, e.g. for code the compiler made up.
+ */
+class line_table {
+public:
+    struct run {
+        int start;
+        int line;
+    };
+private:
+    std::vector<run> runs_;
+    // number of instructions covered
+    int size_ = 0;
+public:
+    // the line of the next instruction
+    void append(int line) {
+        if (runs_.empty() || runs_.back().line != line)
+            runs_.push_back({ size_, line });
+        size_++;
+    }
+
+    int line(int address) const {
+        if (address < 0 || address >= size_)
+            return 0;
+        auto iter = std::upper_bound(runs_.begin(), runs_.end(), address,
+                                     [](int address, const run &r) { return address < r.start; });
+        return std::prev(iter)->line;
+    }
+
+    const std::vector<run> &runs() const { return runs_; }
+
+    int size() const { return size_; }
+
+    bool empty() const { return runs_.empty(); }
+};
+
+struct procedure_info {
+    std::string name;
+    int entry;
+    int level;
+    // nullptr for the main program
+    procedure *symbol = nullptr;
+};
+
+typedef std::vector<procedure_info> procedure_table;
+
 class backpatcher {
     bytecode *code_;
     int pos_;
@@ -0,0 +1,374 @@
+#include "c-generator.h"
+
+namespace pl0::code {
+
+namespace {
+
+// Runtime support every generated file starts with. read() mirrors
+// `std::cin >> int` as used by the VM: a malformed or out of range number
+// fails the stream, and every later read yields zero. pl0_div() stops the
+// program like the VM does on a division error.
+const char *const runtime = R"(#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static char pl0_out[1 << 16];
+static int pl0_out_size;
+static char pl0_in[1 << 16];
+static int pl0_in_pos, pl0_in_size;
+static int pl0_in_failed;
+
+static void pl0_flush(void) {
+    int done = 0;
+    while (done < pl0_out_size) {
+        int n = (int) write(1, pl0_out + done, (size_t) (pl0_out_size - done));
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    pl0_out_size = 0;
+}
+
+static inline void pl0_write(int value) {
+    char digits[10];
+    int n = 0;
+    unsigned magnitude = value < 0 ? 0u - (unsigned) value : (unsigned) value;
+    if (pl0_out_size + 12 > (int) sizeof pl0_out)
+        pl0_flush();
+    if (value < 0)
+        pl0_out[pl0_out_size++] = '-';
+    do {
+        digits[n++] = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    while (n)
+        pl0_out[pl0_out_size++] = digits[--n];
+    pl0_out[pl0_out_size++] = '\n';
+}
+
+static inline int pl0_peek(void) {
+    if (pl0_in_pos == pl0_in_size) {
+        /* about to wait for input, show what has been written so far */
+        pl0_flush();
+        pl0_in_pos = 0;
+        pl0_in_size = (int) read(0, pl0_in, sizeof pl0_in);
+        if (pl0_in_size <= 0) {
+            pl0_in_size = 0;
+            return -1;
+        }
+    }
+    return (unsigned char) pl0_in[pl0_in_pos];
+}
+
+static inline int pl0_read(void) {
+    int c, negative = 0, digits = 0;
+    long long value = 0;
+    if (pl0_in_failed)
+        return 0;
+    while ((c = pl0_peek()) == ' ' || (c >= '\t' && c <= '\r'))
+        pl0_in_pos++;
+    if (c == '+' || c == '-') {
+        negative = c == '-';
+        pl0_in_pos++;
+        c = pl0_peek();
+    }
+    while (c >= '0' && c <= '9') {
+        if (value <= (long long) INT_MAX + 1)
+            value = value * 10 + (c - '0');
+        digits++;
+        pl0_in_pos++;
+        c = pl0_peek();
+    }
+    if (negative)
+        value = -value;
+    if (digits == 0 || value > INT_MAX || value < INT_MIN) {
+        pl0_in_failed = 1;
+        return digits == 0 ? 0 : value > 0 ? INT_MAX : INT_MIN;
+    }
+    return (int) value;
+}
+
+static inline int pl0_add(int a, int b) { return (int) ((unsigned) a + (unsigned) b); }
+
+static inline int pl0_sub(int a, int b) { return (int) ((unsigned) a - (unsigned) b); }
+
+static inline int pl0_mul(int a, int b) { return (int) ((unsigned) a * (unsigned) b); }
+
+static void pl0_fail(const char *message, int line) {
+    pl0_flush();
+    if (line)
+        fprintf(stderr, "Error: %s at line %d\n", message, line);
+    else
+        fprintf(stderr, "Error: %s\n", message);
+    exit(1);
+}
+
+static inline int pl0_div(int a, int b, int line) {
+    if (b == 0)
+        pl0_fail("division by zero", line);
+    if (a == INT_MIN && b == -1)
+        pl0_fail("the division overflows", line);
+    return a / b;
+}
+)";
+
+std::string sanitize(const std::string &name) {
+    std::string result = name;
+    for (auto &ch : result) {
+        if (!isalnum(static_cast<unsigned char>(ch)) && ch != '_')
+            ch = '_';
+    }
+    return result;
+}
+
+std::string field_name(variable *var) {
+    return concat('v', var->get_index(), '_', sanitize(var->get_name()));
+}
+
+// C spelling of the operators that map directly onto one
+const char *c_operator(token op) {
+    switch (op) {
+    case token::EQ: return "==";
+    case token::NEQ: return "!=";
+    case token::LE: return "<";
+    case token::LEQ: return "<=";
+    case token::GE: return ">";
+    case token::GEQ: return ">=";
+    default: return nullptr;
+    }
+}
+
+}
+
+void c_generator::generate(ast::block *program) {
+    layout_ = std::make_unique<analysis::frame_layout>(program);
+    assign_names(nullptr, program);
+    generate_function(nullptr, program);
+}
+
+void c_generator::assign_names(procedure *symbol, ast::block *block) {
+    auto name = symbol ? concat('p', names_.size(), '_', sanitize(symbol->get_name())) : std::string{ "program" };
+    names_[block->belonging_scope()] = name;
+    if (symbol)
+        function_names_[symbol] = name;
+    for (auto method : block->sub_procedures())
+        assign_names(method->symbol(), method->main_block());
+}
+
+void c_generator::generate_function(procedure *symbol, ast::block *block) {
+    auto s = block->belonging_scope();
+    auto name = names_.at(s);
+
+    // nested procedures reach this frame through their static link
+    bool has_frame = !block->sub_procedures().empty();
+    if (has_frame) {
+        types_ << frame_type(s) << " {\n    ";
+        types_ << (symbol ? frame_type(s->get_enclosing_scope()) + " *" : std::string{ "void *" }) << "up;\n";
+        for (auto var : s->get_variables()) {
+            if (layout_->is_captured(var))
+                types_ << "    int " << field_name(var) << ";\n";
+        }
+        types_ << "};\n\n";
+    }
+
+    auto signature = "static void " + name +
+                     (symbol ? "(" + frame_type(s->get_enclosing_scope()) + " *up)" : std::string{ "(void)" });
+    prototypes_ << signature << ";\n";
+
+    top_scope_ = s;
+    body_.str("");
+    current_ = symbol;
+    restarts_ = false;
+    indent_ = 1;
+    line_ = block->loc().line;
+    tail_position_ = true;
+    visit(block->body());
+    tail_position_ = false;
+
+    functions_ << signature << " {\n";
+    if (has_frame)
+        functions_ << "    " << frame_type(s) << " frame = { " << (symbol ? "up" : "0") << " };\n";
+    for (auto var : s->get_variables()) {
+        if (!layout_->is_captured(var))
+            functions_ << "    int " << variable_reference(var) << " = 0;\n";
+    }
+    if (restarts_)
+        functions_ << "entry:;\n";
+    functions_ << body_.str() << "}\n\n";
+
+    for (auto method : block->sub_procedures())
+        visit_procedure_declaration(method);
+}
+
+std::ostream &c_generator::line() {
+    for (int i = 0; i < indent_; i++)
+        body_ << "    ";
+    return body_;
+}
+
+std::string c_generator::expression(ast::expression *expr, bool nested) {
+    bool saved = nested_;
+    nested_ = nested;
+    visit(expr);
+    nested_ = saved;
+    return std::move(value_);
+}
+
+std::string c_generator::static_link(int level) const {
+    int distance = top_scope_->get_level() - level;
+    if (distance == 0)
+        return "&frame";
+    std::string result = "up";
+    for (int i = 1; i < distance; i++)
+        result += "->up";
+    return result;
+}
+
+std::string c_generator::variable_reference(variable *var) const {
+    auto field = field_name(var);
+    if (var->get_level() == top_scope_->get_level())
+        return layout_->is_captured(var) ? "frame." + field : field;
+    return static_link(var->get_level()) + "->" + field;
+}
+
+void c_generator::visit_variable_declaration(ast::variable_declaration *node) { }
+
+void c_generator::visit_constant_declaration(ast::constant_declaration *node) { }
+
+void c_generator::visit_procedure_declaration(ast::procedure_declaration *node) {
+    generate_function(node->symbol(), node->main_block());
+}
+
+void c_generator::visit_block(ast::block *node) { }
+
+void c_generator::visit_unary_operation(ast::unary_operation *node) {
+    // odd is the only unary operator
+    value_ = expression(node->expr(), true) + " % 2";
+    if (nested_)
+        value_ = "(" + value_ + ")";
+}
+
+void c_generator::visit_binary_operation(ast::binary_operation *node) {
+    switch (node->op()) {
+    case token::ADD:
+    case token::SUB:
+    case token::MUL:
+        value_ = concat("pl0_", node->op() == token::ADD ? "add" : node->op() == token::SUB ? "sub" : "mul", '(',
+                        expression(node->left()), ", ", expression(node->right()), ')');
+        break;
+    case token::DIV:
+        value_ = concat("pl0_div(", expression(node->left()), ", ", expression(node->right()), ", ", line_, ')');
+        break;
+    default: {
+        auto op = c_operator(node->op());
+        if (op == nullptr)
+            throw general_error("unexpected operator ", *node->op());
+        value_ = concat(expression(node->left(), true), ' ', op, ' ', expression(node->right(), true));
+        if (nested_)
+            value_ = "(" + value_ + ")";
+        break;
+    }
+    }
+}
+
+void c_generator::visit_literal(ast::literal *node) {
+    value_ = std::to_string(node->value());
+}
+
+void c_generator::visit_variable_proxy(ast::variable_proxy *node) {
+    auto sym = node->target();
+    if (sym->is_variable())
+        value_ = variable_reference(static_cast<variable *>(sym));
+    else if (sym->is_constant())
+        value_ = std::to_string(static_cast<constant *>(sym)->get_value());
+    else
+        throw general_error(sym->get_name() + " is a procedure so that cannot be used in expression");
+}
+
+void c_generator::visit_statement_list(ast::statement_list *node) {
+    bool tail = tail_position_;
+    auto &statements = node->statements();
+    for (size_t i = 0; i < statements.size(); i++) {
+        tail_position_ = tail && i + 1 == statements.size();
+        visit(statements[i]);
+    }
+    tail_position_ = tail;
+}
+
+void c_generator::visit_if_statement(ast::if_statement *node) {
+    line() << "if (" << expression(node->condition()) << ") {\n";
+    indent_++;
+    visit(node->then_statement());
+    indent_--;
+    if (node->has_else_statement()) {
+        line() << "} else {\n";
+        indent_++;
+        visit(node->else_statement());
+        indent_--;
+    }
+    line() << "}\n";
+}
+
+void c_generator::visit_while_statement(ast::while_statement *node) {
+    bool tail = tail_position_;
+    line() << "while (" << expression(node->cond()) << ") {\n";
+    indent_++;
+    tail_position_ = false;
+    visit(node->body());
+    tail_position_ = tail;
+    indent_--;
+    line() << "}\n";
+}
+
+void c_generator::visit_call_statement(ast::call_statement *node) {
+    auto sym = top_scope_->resolve(node->callee());
+    if (sym == nullptr) throw general_error("no procedure named \"" + node->callee() + "\" to be called");
+    if (!sym->is_procedure()) throw general_error(node->callee() + " is not a procedure");
+    auto method = static_cast<procedure *>(sym);
+    // A procedure calling itself last restarts in place, like TCL reusing
+    // the frame, so tail recursion does not grow the C stack.
+    if (tail_position_ && method == current_) {
+        for (auto var : top_scope_->get_variables())
+            line() << variable_reference(var) << " = 0;\n";
+        line() << "goto entry;\n";
+        restarts_ = true;
+        return;
+    }
+    line() << function_names_.at(method) << '(' << static_link(method->get_level()) << ");\n";
+}
+
+void c_generator::visit_read_statement(ast::read_statement *node) {
+    for (auto target : node->targets()) {
+        auto sym = target->target();
+        if (!sym->is_variable())
+            throw general_error(sym->get_name() + " is not assignable");
+        line() << variable_reference(static_cast<variable *>(sym)) << " = pl0_read();\n";
+    }
+}
+
+void c_generator::visit_write_statement(ast::write_statement *node) {
+    for (auto expr : node->expressions())
+        line() << "pl0_write(" << expression(expr) << ");\n";
+}
+
+void c_generator::visit_assign_statement(ast::assign_statement *node) {
+    auto sym = node->target()->target();
+    if (sym->is_constant())
+        throw general_error("constant " + sym->get_name() + " is not assignable");
+    if (!sym->is_variable())
+        throw general_error("procedure " + sym->get_name() + " is not assignable");
+    line() << variable_reference(static_cast<variable *>(sym)) << " = " << expression(node->expr()) << ";\n";
+}
+
+void c_generator::visit_return_statement(ast::return_statement *node) {
+    line() << "return;\n";
+}
+
+void c_generator::write(std::ostream &out) const {
+    out << "/* generated from PL/0 source, do not edit */\n" << runtime << '\n';
+    out << types_.str() << prototypes_.str() << '\n' << functions_.str();
+    out << "int main(void) {\n    program();\n    pl0_flush();\n    return 0;\n}\n";
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef PL0_C_GENERATOR_H
+#define PL0_C_GENERATOR_H
+
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "../ast/ast.h"
+#include "../analysis/frame-layout.h"
+#include "../util.h"
+
+namespace pl0::code {
+
+/**
+ * Translates a program into a self-contained C source file, for running
+ * long jobs as native code instead of in the VM. Every procedure becomes a
+ * C function taking its static link. Variables that nested procedures
+ * access live in a frame struct the nested procedures reach through the
+ * chain of static links; all other locals are plain C locals. Arithmetic
+ * wraps around like it does in the VM, and read/write go through buffers
+ * in the generated runtime. A division the VM would stop on prints the
+ * VM's error with the source line and exits with status 1, after writing
+ * out what the program wrote before.
+ */
+class c_generator : public ast::ast_visitor<c_generator> {
+    std::unique_ptr<analysis::frame_layout> layout_;
+    // C names of the function of each scope and of each procedure
+    std::unordered_map<scope *, std::string> names_;
+    std::unordered_map<procedure *, std::string> function_names_;
+    std::ostringstream types_;
+    std::ostringstream prototypes_;
+    std::ostringstream functions_;
+
+    // per function state
+    std::ostringstream body_;
+    std::string value_;
+    bool nested_;
+    scope *top_scope_;
+    procedure *current_;
+    bool tail_position_;
+    bool restarts_;
+    int indent_;
+    // source line reported by runtime errors of the code being generated
+    int line_;
+
+    DECLARE_VISIT_METHODS
+
+    void dispatch(ast::ast_node *node) {
+        GENERATE_AST_VISITOR_SWITCH()
+    }
+
+    // code takes the line of the innermost node it comes from, like bytecode does
+    void visit(ast::ast_node *node) {
+        int line = line_;
+        if (node->loc().line != 0)
+            line_ = node->loc().line;
+        dispatch(node);
+        line_ = line;
+    }
+
+    void assign_names(procedure *symbol, ast::block *block);
+    void generate_function(procedure *symbol, ast::block *block);
+    std::ostream &line();
+
+    std::string expression(ast::expression *expr, bool nested = false);
+    std::string static_link(int level) const;
+    std::string variable_reference(variable *var) const;
+    std::string frame_type(scope *s) const { return "struct " + names_.at(s) + "_frame"; }
+public:
+    c_generator()
+            : nested_(false), top_scope_(nullptr), current_(nullptr), tail_position_(false), restarts_(false),
+              indent_(0), line_(0) { }
+
+    void generate(ast::block *program);
+
+    void write(std::ostream &out) const;
+};
+
+}
+
+#endif //PL0_C_GENERATOR_H
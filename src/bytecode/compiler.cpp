@@ -8,13 +8,18 @@ void compiler::visit_constant_declaration(ast::constant_declaration *node) { }
 
 void compiler::visit_procedure_declaration(ast::procedure_declaration *node) {
     entry_points_[node->symbol()] = assembler_.get_next_address();
+    procedures_.push_back({ node->symbol()->get_name(), assembler_.get_next_address(), node->symbol()->get_level() + 1,
+                            node->symbol() });
     visit_block(node->main_block());
 }
 
 void compiler::visit_block(ast::block *node) {
     top_scope_ = node->belonging_scope();
-    assembler_.enter(top_scope_->get_variable_count() + 3);
+    assembler_.set_line(node->loc().line);
+    assembler_.enter(layout_->frame_size(top_scope_) + 3);
+    tail_position_ = true;
     visit(node->body());
+    tail_position_ = false;
     assembler_.leave();
     for (auto method : node->sub_procedures())
         visit_procedure_declaration(method);
@@ -44,7 +49,7 @@ void compiler::visit_lvalue(ast::variable_proxy *node) {
     auto sym = node->target();
     if (sym->is_variable()) {
         auto var = dynamic_cast<variable *>(sym);
-        assembler_.store(top_scope_->get_level() - var->get_level(), var->get_index());
+        assembler_.store(top_scope_->get_level() - var->get_level(), layout_->slot(var));
     } else if (sym->is_constant())
         throw general_error("constant " + sym->get_name() + " is not assignable");
     else
@@ -55,7 +60,7 @@ void compiler::visit_rvalue(ast::variable_proxy *node) {
     auto sym = node->target();
     if (sym->is_variable()) {
         auto var = dynamic_cast<variable *>(sym);
-        assembler_.load(top_scope_->get_level() - var->get_level(), var->get_index());
+        assembler_.load(top_scope_->get_level() - var->get_level(), layout_->slot(var));
     } else if (sym->is_constant()) {
         auto var = dynamic_cast<constant *>(sym);
         assembler_.load(var->get_value());
@@ -73,7 +78,14 @@ void compiler::visit_call_statement(ast::call_statement *node) {
     if (sym == nullptr) throw general_error("no procedure named \"" + node->callee() + "\" to be called");
     if (!sym->is_procedure()) throw general_error(node->callee() + " is not a procedure");
     auto method = dynamic_cast<procedure *>(sym);
-    patch_list_[method].push_back(assembler_.call(top_scope_->get_level()));
+    // A call followed only by RET may reuse the caller's frame, unless the
+    // callee is nested in the caller and needs that frame as its static link.
+    if (tail_position_ && top_scope_->get_level() > method->get_level())
+        patch_list_[method].push_back(assembler_.tail_call(top_scope_->get_level()));
+    else if (static_frames_.count(method))
+        patch_list_[method].push_back(assembler_.static_call(top_scope_->get_level()));
+    else
+        patch_list_[method].push_back(assembler_.call(top_scope_->get_level()));
 }
 
 void compiler::visit_write_statement(ast::write_statement *node) {
@@ -84,10 +96,13 @@ void compiler::visit_write_statement(ast::write_statement *node) {
 }
 
 void compiler::visit_while_statement(ast::while_statement *node) {
+    bool tail = tail_position_;
     auto beginning = assembler_.get_next_address();
     visit(node->cond());
     auto goto_end = assembler_.branch_if_false();
+    tail_position_ = false;
     visit(node->body());
+    tail_position_ = tail;
     assembler_.branch(beginning);
     goto_end.set_address(assembler_.get_next_address());
 }
@@ -120,11 +135,23 @@ void compiler::visit_if_statement(ast::if_statement *node) {
 }
 
 void compiler::visit_statement_list(ast::statement_list *node) {
-    for (auto stmt : node->statements())
-        visit(stmt);
+    bool tail = tail_position_;
+    auto &statements = node->statements();
+    for (size_t i = 0; i < statements.size(); i++) {
+        tail_position_ = tail && i + 1 == statements.size();
+        visit(statements[i]);
+    }
+    tail_position_ = tail;
 }
 
 void compiler::generate(ast::block *program) {
+    procedures_.push_back({ "<program>", assembler_.get_next_address(), 0 });
+    layout_ = std::make_unique<analysis::frame_layout>(program);
+    analysis::call_graph graph{program};
+    for (auto proc : graph.procedures()) {
+        if (proc && !graph.is_recursive(proc))
+            static_frames_.insert(proc);
+    }
     visit_block(program);
     for (auto kv : patch_list_) {
         for (auto patch : kv.second) {
@@ -1,11 +1,15 @@
 #ifndef PL0_CODE_GENERATOR_H
 #define PL0_CODE_GENERATOR_H
 
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "../ast/ast.h"
+#include "../analysis/call-graph.h"
+#include "../analysis/frame-layout.h"
 #include "assembler.h"
 #include "../util.h"
 
@@ -14,20 +18,41 @@ namespace pl0::code {
 class compiler : public ast::ast_visitor<compiler> {
     std::unordered_map<procedure *, int> entry_points_;
     std::unordered_map<procedure *, std::vector<backpatcher>> patch_list_;
+    procedure_table procedures_;
+    std::unique_ptr<analysis::frame_layout> layout_;
+    // procedures with at most one activation at a time, called with SCL
+    std::unordered_set<procedure *> static_frames_;
     assembler assembler_;
     scope *top_scope_;
+    bool tail_position_;
 
-    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
     DECLARE_VISIT_METHODS
 
+    void dispatch(ast::ast_node *node) {
+        GENERATE_AST_VISITOR_SWITCH()
+    }
+
+    // instructions take the line of the innermost node they come from
+    void visit(ast::ast_node *node) {
+        int line = assembler_.get_line();
+        if (node->loc().line != 0)
+            assembler_.set_line(node->loc().line);
+        dispatch(node);
+        assembler_.set_line(line);
+    }
+
     void visit_rvalue(ast::variable_proxy *node);
     void visit_lvalue(ast::variable_proxy *node);
 public:
-    compiler() : top_scope_(nullptr) { }
+    compiler() : top_scope_(nullptr), tail_position_(false) { }
 
     void generate(ast::block *program);
 
     const bytecode &code() { return assembler_.get_bytecode(); }
+
+    const line_table &lines() const { return assembler_.get_lines(); }
+
+    const procedure_table &procedures() const { return procedures_; }
 };
 
 }
@@ -0,0 +1,211 @@
+#include "partial-evaluator.h"
+#include "../analysis/constant-folding.h"
+#include "../util.h"
+
+namespace pl0::code {
+
+namespace {
+
+struct frame {
+    int return_address;
+    int level;
+    // frame the display held for this level before, -1 if none
+    int saved_display;
+    std::vector<int> locals;
+    std::vector<int> intermediates;
+};
+
+}
+
+void partial_evaluator::run(const bytecode &code) {
+    original_size_ = code.size();
+    evaluate(code);
+    build_residual(code);
+}
+
+void partial_evaluator::evaluate(const bytecode &code) {
+    auto code_length = static_cast<int>(code.size());
+    std::vector<frame> frames;
+    std::vector<int> display;
+    frames.push_back({ code_length, 0, -1, { }, { } });
+    display.push_back(0);
+
+    int program_counter = 0;
+    long executed = 0;
+    auto stop = [this](std::string reason) {
+        stop_reason_ = std::move(reason);
+    };
+    auto local = [&](int level, int index) -> int * {
+        if (level < 0 || level >= static_cast<int>(display.size()) || display[level] < 0)
+            return nullptr;
+        auto &locals = frames[display[level]].locals;
+        return index >= 0 && index < static_cast<int>(locals.size()) ? &locals[index] : nullptr;
+    };
+    auto enter = [&](int level) {
+        if (level >= static_cast<int>(display.size()))
+            display.resize(level + 1, -1);
+        frames.back().level = level;
+        frames.back().saved_display = display[level];
+        display[level] = static_cast<int>(frames.size()) - 1;
+    };
+
+    while (true) {
+        if (frames.empty()) {
+            finished_ = true;
+            stop("the end of the program");
+            return;
+        }
+        if (frames.size() == 1) {
+            resume_.program_counter = program_counter;
+            resume_.locals = frames[0].locals;
+            resume_.intermediates = frames[0].intermediates;
+            resume_.output_size = output_.size();
+            resume_.executed = executed;
+        }
+        if (executed == budget_)
+            return stop(concat("the budget of ", budget_, " instructions"));
+        if (program_counter < 0 || program_counter >= code_length)
+            return stop("a jump out of the program");
+
+        auto ins = code[program_counter++];
+        executed++;
+        auto &top = frames.back();
+        auto &stack = top.intermediates;
+        switch (ins.op) {
+        case opcode::LIT:
+            stack.push_back(ins.address);
+            break;
+        case opcode::LOD: {
+            auto var = local(top.level - ins.level, ins.address);
+            if (var == nullptr)
+                return stop("an access outside of a frame");
+            stack.push_back(*var);
+            break;
+        }
+        case opcode::STO: {
+            auto var = local(top.level - ins.level, ins.address);
+            if (var == nullptr || stack.empty())
+                return stop("an access outside of a frame");
+            *var = stack.back();
+            stack.pop_back();
+            break;
+        }
+        case opcode::CAL:
+        case opcode::SCL: {
+            int level = top.level - ins.level + 1;
+            frames.push_back({ program_counter, 0, -1, { }, { } });
+            enter(level);
+            program_counter = ins.address;
+            break;
+        }
+        case opcode::TCL: {
+            int level = top.level - ins.level + 1;
+            display[top.level] = top.saved_display;
+            top.locals.clear();
+            top.intermediates.clear();
+            enter(level);
+            program_counter = ins.address;
+            break;
+        }
+        case opcode::INT:
+            top.locals.resize(top.locals.size() + ins.address - 3, 0);
+            break;
+        case opcode::JMP:
+            program_counter = ins.address;
+            break;
+        case opcode::JPC:
+            if (stack.empty())
+                return stop("an empty evaluation stack");
+            if (!stack.back())
+                program_counter = ins.address;
+            stack.pop_back();
+            break;
+        case opcode::OPR: {
+            auto op = opt(ins.address);
+            if (op == opt::READ)
+                return stop("the first read");
+            if (op == opt::RET) {
+                display[top.level] = top.saved_display;
+                program_counter = top.return_address;
+                frames.pop_back();
+                break;
+            }
+            size_t operands = op == opt::WRITE || op == opt::ODD ? 1 : 2;
+            if (stack.size() < operands)
+                return stop("an empty evaluation stack");
+            if (op == opt::WRITE) {
+                output_.push_back(stack.back());
+                stack.pop_back();
+                break;
+            }
+            if (op == opt::ODD) {
+                stack.back() %= 2;
+                break;
+            }
+            auto iter = opt2token.find(op);
+            if (iter == opt2token.end())
+                return stop("an unknown operation");
+            int rhs = stack.back();
+            stack.pop_back();
+            int result;
+            // a trapping division is left to the residual program, which traps like the original
+            if (!analysis::fold(iter->second, stack.back(), rhs, result))
+                return stop("a division that traps");
+            stack.back() = result;
+            break;
+        }
+        }
+    }
+}
+
+void partial_evaluator::build_residual(const bytecode &code) {
+    auto emit = [this](opcode op, int level, int address) {
+        code_.push_back({ op, level, address });
+    };
+    auto write_output = [&]() {
+        for (size_t i = 0; i < resume_.output_size; i++) {
+            emit(opcode::LIT, 0, output_[i]);
+            emit(opcode::OPR, 0, *opt::WRITE);
+        }
+    };
+
+    code_.clear();
+    if (finished_) {
+        write_output();
+        return;
+    }
+    // main starts by allocating its frame, which the prologue takes over;
+    // stopping right after that leaves nothing worth a prologue
+    if (resume_.program_counter <= 1 || code.empty() || code[0].op != opcode::INT) {
+        code_ = code;
+        return;
+    }
+
+    code_ = code;
+    code_[0] = { opcode::JMP, 0, static_cast<int>(code.size()) };
+    emit(opcode::INT, 0, static_cast<int>(resume_.locals.size()) + 3);
+    for (size_t i = 0; i < resume_.locals.size(); i++) {
+        if (resume_.locals[i] != 0) {
+            emit(opcode::LIT, 0, resume_.locals[i]);
+            emit(opcode::STO, 0, static_cast<int>(i));
+        }
+    }
+    write_output();
+    for (int value : resume_.intermediates)
+        emit(opcode::LIT, 0, value);
+    emit(opcode::JMP, 0, resume_.program_counter);
+}
+
+void partial_evaluator::report(std::ostream &out) const {
+    out << "evaluated " << resume_.executed << " instructions before " << stop_reason_;
+    if (!finished_ && resume_.program_counter <= 1)
+        out << ", the program is left unchanged\n";
+    else if (finished_)
+        out << ", the residual program only writes " << resume_.output_size << " values\n";
+    else
+        out << ", the residual program resumes at " << resume_.program_counter << " after writing "
+            << resume_.output_size << " values\n";
+    out << "bytecode: " << code_.size() << " instructions, " << original_size_ << " before\n";
+}
+
+}
@@ -0,0 +1,57 @@
+#ifndef PL0_PARTIAL_EVALUATOR_H
+#define PL0_PARTIAL_EVALUATOR_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bytecode.h"
+
+namespace pl0::code {
+
+/**
+ * Runs the part of a program that does not depend on input at compile
+ * time. Execution stops before the first read, before an operation that
+ * would trap, or when the instruction budget runs out, and falls back to
+ * the last state in which only the main program was active. The residual
+ * program starts from that state: a prologue writes the buffered output,
+ * restores the globals and the evaluation stack and jumps to where the
+ * evaluation stopped. A program that finishes is reduced to its output.
+ */
+class partial_evaluator {
+    struct state {
+        int program_counter = 0;
+        std::vector<int> locals;
+        std::vector<int> intermediates;
+        size_t output_size = 0;
+        long executed = 0;
+    };
+
+    long budget_;
+    bytecode code_;
+    std::vector<int> output_;
+    state resume_;
+    bool finished_;
+    std::string stop_reason_;
+    size_t original_size_;
+
+    void evaluate(const bytecode &code);
+    void build_residual(const bytecode &code);
+public:
+    explicit partial_evaluator(long budget = 10000000)
+            : budget_(budget), finished_(false), original_size_(0) { }
+
+    void run(const bytecode &code);
+
+    const bytecode &code() const { return code_; }
+
+    // the residual program only writes the output; otherwise it keeps the
+    // original code at the original addresses
+    bool finished() const { return finished_; }
+
+    void report(std::ostream &out) const;
+};
+
+}
+
+#endif //PL0_PARTIAL_EVALUATOR_H
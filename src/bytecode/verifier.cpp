@@ -0,0 +1,185 @@
+#include <climits>
+
+#include "verifier.h"
+#include "../util.h"
+
+namespace pl0::code {
+
+bool verifier::verify(const bytecode &code) {
+    code_ = &code;
+    procedures_.clear();
+    entries_.clear();
+    states_.assign(code.size(), abstract_state{ });
+    outer_accesses_.clear();
+    error_.clear();
+    try {
+        if (!code.empty())
+            enter(0, 0, -1);
+        // analyzing a procedure may discover more
+        for (size_t i = 0; i < procedures_.size(); i++)
+            analyze(static_cast<int>(i));
+        for (auto &access : outer_accesses_) {
+            auto &owner = procedures_[access.owner];
+            if (owner.call_locals >= 0 && access.address >= owner.call_locals)
+                throw general_error("instruction ", access.program_counter, " accesses local ", access.address,
+                                    " of the procedure at ", owner.entry, ", which has ", owner.call_locals,
+                                    " locals");
+        }
+    } catch (general_error &error) {
+        error_ = error.what();
+        return false;
+    }
+    return true;
+}
+
+void verifier::enter(int entry, int level, int parent) {
+    auto iter = entries_.find(entry);
+    if (iter != entries_.end()) {
+        auto &known = procedures_[iter->second];
+        if (known.level != level)
+            throw general_error("procedure ", entry, " is called at levels ", known.level, " and ", level);
+        if (known.parent != parent)
+            throw general_error("procedure ", entry, " is called in the procedures at ",
+                                procedures_[known.parent].entry, " and ", procedures_[parent].entry);
+        return;
+    }
+    if (states_[entry].procedure >= 0)
+        throw general_error("call to ", entry, ", which is inside another procedure");
+    int index = static_cast<int>(procedures_.size());
+    procedures_.push_back({ entry, level, parent, -1 });
+    entries_[entry] = index;
+    states_[entry] = { index, 0, 0 };
+}
+
+void verifier::flow(int target, const abstract_state &state, std::vector<int> &worklist) {
+    // running off the end stops the machine
+    if (target == static_cast<int>(code_->size()))
+        return;
+    auto &known = states_[target];
+    if (known.procedure < 0) {
+        known = state;
+        worklist.push_back(target);
+    } else if (known.procedure != state.procedure) {
+        throw general_error("instruction ", target, " is reached from two procedures");
+    } else if (known.depth != state.depth || known.locals != state.locals) {
+        throw general_error("instruction ", target, " is reached with different stack depths");
+    }
+}
+
+void verifier::analyze(int index) {
+    auto &code = *code_;
+    auto code_length = static_cast<int>(code.size());
+    std::vector<int> worklist{ procedures_[index].entry };
+    while (!worklist.empty()) {
+        int program_counter = worklist.back();
+        worklist.pop_back();
+        auto ins = code[program_counter];
+        auto state = states_[program_counter];
+        int level = procedures_[index].level;
+        // the procedure whose frame the display holds that many levels up
+        auto ancestor = [&](int levels) {
+            int result = index;
+            while (levels-- > 0)
+                result = procedures_[result].parent;
+            return result;
+        };
+        auto fail = [program_counter](const char *what) {
+            throw general_error("instruction ", program_counter, ": ", what);
+        };
+        auto pop = [&](int count) {
+            if (state.depth < count)
+                fail("the stack underflows");
+            state.depth -= count;
+        };
+        auto access = [&]() {
+            if (ins.level < 0 || ins.level > level)
+                fail("level out of range");
+            if (ins.address < 0)
+                fail("negative local index");
+            if (ins.level == 0 && ins.address >= state.locals)
+                fail("local index out of range");
+            if (ins.level > 0)
+                outer_accesses_.push_back({ program_counter, ancestor(ins.level), ins.address });
+        };
+        auto jump_target = [&]() {
+            if (ins.address < 0 || ins.address > code_length)
+                fail("jump target out of range");
+            return ins.address;
+        };
+        auto call = [&](int min_level) {
+            if (ins.level < min_level || ins.level > level)
+                fail("call level out of range");
+            if (ins.address < 0 || ins.address >= code_length)
+                fail("call target out of range");
+            enter(ins.address, level - ins.level + 1, ancestor(ins.level));
+        };
+
+        switch (ins.op) {
+        case opcode::LIT:
+            state.depth++;
+            flow(program_counter + 1, state, worklist);
+            break;
+        case opcode::LOD:
+            access();
+            state.depth++;
+            flow(program_counter + 1, state, worklist);
+            break;
+        case opcode::STO:
+            pop(1);
+            access();
+            flow(program_counter + 1, state, worklist);
+            break;
+        case opcode::CAL:
+        case opcode::SCL: {
+            call(0);
+            auto &allocated = procedures_[index].call_locals;
+            if (allocated < 0 || state.locals < allocated)
+                allocated = state.locals;
+            flow(program_counter + 1, state, worklist);
+            break;
+        }
+        case opcode::TCL:
+            // the frame is given up, so the callee must not be nested in it
+            call(1);
+            break;
+        case opcode::INT:
+            if (ins.address < 3 || ins.address - 3 > INT_MAX - state.locals)
+                fail("bad frame size");
+            state.locals += ins.address - 3;
+            flow(program_counter + 1, state, worklist);
+            break;
+        case opcode::JMP:
+            flow(jump_target(), state, worklist);
+            break;
+        case opcode::JPC: {
+            pop(1);
+            int target = jump_target();
+            flow(program_counter + 1, state, worklist);
+            flow(target, state, worklist);
+            break;
+        }
+        case opcode::OPR:
+            if (ins.address == *opt::RET)
+                break;
+            if (ins.address == *opt::ODD) {
+                pop(1);
+                state.depth++;
+            } else if (ins.address == *opt::READ) {
+                state.depth++;
+            } else if (ins.address == *opt::WRITE) {
+                pop(1);
+            } else if (ins.address >= *opt::SUB && ins.address <= *opt::NEQ) {
+                pop(2);
+                state.depth++;
+            } else {
+                fail("unknown operation");
+            }
+            flow(program_counter + 1, state, worklist);
+            break;
+        default:
+            fail("unknown opcode");
+        }
+    }
+}
+
+}
@@ -0,0 +1,72 @@
+#ifndef PL0_VERIFIER_H
+#define PL0_VERIFIER_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bytecode.h"
+
+namespace pl0::code {
+
+/**
+ * Proves once that a program cannot make the interpreter misbehave, so the
+ * machine can run it without checking every instruction. Procedures are
+ * found from the main program through their calls and each one is
+ * interpreted abstractly: at every instruction the evaluation stack must
+ * have the same depth on all paths and never underflow, jumps must stay in
+ * the code, calls must enter procedures at one consistent nesting level and
+ * loads and stores must name an allocated local of a frame that is on the
+ * static chain.
+ *
+ * Every procedure must be called with one static parent, found by going up
+ * as many parents from the caller as the call's level difference. A frame
+ * the display holds for an enclosing level belongs to such a parent and is
+ * always suspended in a call, so a variable of an enclosing procedure is
+ * known to exist if every call that procedure makes has it allocated.
+ */
+class verifier {
+    struct procedure {
+        int entry;
+        int level;
+        // index of the static parent, -1 for the main program
+        int parent;
+        // fewest locals the frame has when it calls, -1 if it never does
+        int call_locals;
+    };
+
+    // what is known about the machine before an instruction
+    struct abstract_state {
+        int procedure = -1;
+        int depth = 0;
+        int locals = 0;
+    };
+
+    struct outer_access {
+        int program_counter;
+        // index of the procedure whose frame is accessed
+        int owner;
+        int address;
+    };
+
+    const bytecode *code_ = nullptr;
+    std::vector<procedure> procedures_;
+    std::unordered_map<int, int> entries_;
+    std::vector<abstract_state> states_;
+    std::vector<outer_access> outer_accesses_;
+    std::string error_;
+
+    void enter(int entry, int level, int parent);
+    void analyze(int index);
+    void flow(int target, const abstract_state &state, std::vector<int> &worklist);
+public:
+    // true if the program is safe for the unchecked interpreter
+    bool verify(const bytecode &code);
+
+    // why the last program failed verification
+    const std::string &error() const { return error_; }
+};
+
+}
+
+#endif //PL0_VERIFIER_H
@@ -0,0 +1,259 @@
+#include "builder.h"
+#include "../analysis/captured-variables.h"
+
+namespace pl0::ir {
+
+void builder::build(ast::block *program) {
+    captured_ = analysis::find_captured_variables(program);
+    build_function(nullptr, program);
+}
+
+void builder::build_function(procedure *symbol, ast::block *body) {
+    auto fn = new function(symbol, body, body->belonging_scope()->get_level());
+    module_.functions.push_back(fn);
+
+    fn_ = fn;
+    scope_ = body->belonging_scope();
+    definitions_.clear();
+    incomplete_phis_.clear();
+    sealed_.clear();
+    zero_ = nullptr;
+
+    current_ = fn->create_block();
+    seal_block(current_);
+    line_ = body->loc().line;
+    visit(body->body());
+    emit(op::ret);
+
+    for (auto method : body->sub_procedures())
+        build_function(method->symbol(), method->main_block());
+}
+
+bool builder::is_memory(variable *var) const {
+    return var->get_level() != fn_->level || captured_.count(var) > 0;
+}
+
+instruction *builder::emit(op kind, std::vector<instruction *> operands) {
+    auto ins = fn_->create(kind);
+    ins->operands = std::move(operands);
+    ins->line = line_;
+    current_->append(ins);
+    return ins;
+}
+
+instruction *builder::zero() {
+    if (zero_ == nullptr) {
+        zero_ = fn_->create(op::constant);
+        zero_->parent = fn_->entry();
+        auto &entry = fn_->entry()->instructions;
+        entry.insert(entry.begin(), zero_);
+    }
+    return zero_;
+}
+
+instruction *builder::evaluate(ast::expression *expr) {
+    value_ = nullptr;
+    visit(expr);
+    return value_;
+}
+
+void builder::assign(variable *var, instruction *value) {
+    if (is_memory(var)) {
+        auto store = emit(op::store, { value });
+        store->var = var;
+    } else {
+        write_variable(var, current_, value);
+    }
+}
+
+void builder::add_edge(basic_block *from, basic_block *to) {
+    to->predecessors.push_back(from);
+}
+
+void builder::jump(basic_block *target) {
+    auto ins = emit(op::jump);
+    ins->targets = { target };
+    add_edge(current_, target);
+}
+
+void builder::write_variable(variable *var, basic_block *block, instruction *value) {
+    definitions_[block][var] = value;
+}
+
+instruction *builder::read_variable(variable *var, basic_block *block) {
+    auto &defs = definitions_[block];
+    auto iter = defs.find(var);
+    if (iter != defs.end())
+        return iter->second;
+    return read_variable_recursive(var, block);
+}
+
+instruction *builder::read_variable_recursive(variable *var, basic_block *block) {
+    instruction *value;
+    if (!sealed_.count(block)) {
+        value = fn_->create(op::phi);
+        block->insert_phi(value);
+        incomplete_phis_[block].emplace_back(var, value);
+    } else if (block->predecessors.empty()) {
+        // a fresh frame starts with every local set to zero
+        value = zero();
+    } else if (block->predecessors.size() == 1) {
+        value = read_variable(var, block->predecessors.front());
+    } else {
+        value = fn_->create(op::phi);
+        block->insert_phi(value);
+        write_variable(var, block, value);
+        add_phi_operands(var, value);
+    }
+    write_variable(var, block, value);
+    return value;
+}
+
+void builder::add_phi_operands(variable *var, instruction *phi) {
+    for (auto pred : phi->parent->predecessors)
+        phi->operands.push_back(read_variable(var, pred));
+}
+
+void builder::seal_block(basic_block *block) {
+    for (auto &pending : incomplete_phis_[block])
+        add_phi_operands(pending.first, pending.second);
+    incomplete_phis_.erase(block);
+    sealed_.insert(block);
+}
+
+void builder::visit_variable_declaration(ast::variable_declaration *node) { }
+
+void builder::visit_constant_declaration(ast::constant_declaration *node) { }
+
+void builder::visit_procedure_declaration(ast::procedure_declaration *node) { }
+
+void builder::visit_block(ast::block *node) { }
+
+void builder::visit_unary_operation(ast::unary_operation *node) {
+    auto ins = emit(op::unary, { evaluate(node->expr()) });
+    ins->opr = node->op();
+    value_ = ins;
+}
+
+void builder::visit_binary_operation(ast::binary_operation *node) {
+    auto left = evaluate(node->left());
+    auto right = evaluate(node->right());
+    auto ins = emit(op::binary, { left, right });
+    ins->opr = node->op();
+    value_ = ins;
+}
+
+void builder::visit_literal(ast::literal *node) {
+    value_ = emit(op::constant);
+    value_->value = node->value();
+}
+
+void builder::visit_variable_proxy(ast::variable_proxy *node) {
+    auto sym = node->target();
+    if (sym->is_variable()) {
+        auto var = static_cast<variable *>(sym);
+        if (is_memory(var)) {
+            value_ = emit(op::load);
+            value_->var = var;
+        } else {
+            value_ = read_variable(var, current_);
+        }
+    } else if (sym->is_constant()) {
+        value_ = emit(op::constant);
+        value_->value = static_cast<constant *>(sym)->get_value();
+    } else {
+        throw general_error(sym->get_name() + " is a procedure so that cannot be used in expression");
+    }
+}
+
+void builder::visit_statement_list(ast::statement_list *node) {
+    for (auto stmt : node->statements())
+        visit(stmt);
+}
+
+void builder::visit_if_statement(ast::if_statement *node) {
+    auto cond = evaluate(node->condition());
+    auto branch = emit(op::branch, { cond });
+    auto from = current_;
+
+    auto then_block = fn_->create_block();
+    auto else_block = node->has_else_statement() ? fn_->create_block() : nullptr;
+    auto join_block = fn_->create_block();
+    branch->targets = { then_block, else_block ? else_block : join_block };
+    add_edge(from, then_block);
+    add_edge(from, branch->targets[1]);
+
+    seal_block(then_block);
+    current_ = then_block;
+    visit(node->then_statement());
+    jump(join_block);
+
+    if (else_block) {
+        seal_block(else_block);
+        current_ = else_block;
+        visit(node->else_statement());
+        jump(join_block);
+    }
+
+    seal_block(join_block);
+    current_ = join_block;
+}
+
+void builder::visit_while_statement(ast::while_statement *node) {
+    auto header = fn_->create_block();
+    jump(header);
+
+    current_ = header;
+    auto cond = evaluate(node->cond());
+    auto branch = emit(op::branch, { cond });
+    auto body = fn_->create_block();
+    auto exit = fn_->create_block();
+    branch->targets = { body, exit };
+    add_edge(header, body);
+    add_edge(header, exit);
+
+    seal_block(body);
+    current_ = body;
+    visit(node->body());
+    jump(header);
+    seal_block(header);
+
+    seal_block(exit);
+    current_ = exit;
+}
+
+void builder::visit_call_statement(ast::call_statement *node) {
+    auto sym = scope_->resolve(node->callee());
+    if (sym == nullptr) throw general_error("no procedure named \"" + node->callee() + "\" to be called");
+    if (!sym->is_procedure()) throw general_error(node->callee() + " is not a procedure");
+    auto call = emit(op::call);
+    call->callee = static_cast<procedure *>(sym);
+}
+
+void builder::visit_read_statement(ast::read_statement *node) {
+    for (auto target : node->targets())
+        assign(static_cast<variable *>(target->target()), emit(op::read));
+}
+
+void builder::visit_write_statement(ast::write_statement *node) {
+    for (auto expr : node->expressions())
+        emit(op::write, { evaluate(expr) });
+}
+
+void builder::visit_assign_statement(ast::assign_statement *node) {
+    auto value = evaluate(node->expr());
+    auto var = node->target()->target();
+    if (!var->is_variable())
+        throw general_error(var->get_name() + " is not assignable");
+    auto target = static_cast<variable *>(var);
+    assign(target, is_memory(target) ? value : emit(op::copy, { value }));
+}
+
+void builder::visit_return_statement(ast::return_statement *node) {
+    emit(op::ret);
+    // anything after return is unreachable
+    current_ = fn_->create_block();
+    seal_block(current_);
+}
+
+}
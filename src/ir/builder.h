@@ -0,0 +1,71 @@
+#ifndef PL0_IR_BUILDER_H
+#define PL0_IR_BUILDER_H
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ir.h"
+
+namespace pl0::ir {
+
+/**
+ * Translates the AST into SSA form using the on-the-fly construction of
+ * Braun et al., "Simple and Efficient Construction of Static Single
+ * Assignment Form" (CC 2013). Every assignment to a promoted local produces
+ * a copy and no trivial phi is removed here; that is left to the passes.
+ */
+class builder : public ast::ast_visitor<builder> {
+    void dispatch(ast::ast_node *node) {
+        GENERATE_AST_VISITOR_SWITCH()
+    }
+
+    // instructions take the line of the innermost node they come from
+    void visit(ast::ast_node *node) {
+        int line = line_;
+        if (node->loc().line != 0)
+            line_ = node->loc().line;
+        dispatch(node);
+        line_ = line;
+    }
+
+    module &module_;
+    std::unordered_set<variable *> captured_;
+
+    function *fn_;
+    scope *scope_;
+    basic_block *current_;
+    instruction *value_;
+    instruction *zero_;
+    int line_;
+    std::unordered_map<basic_block *, std::unordered_map<variable *, instruction *>> definitions_;
+    std::unordered_map<basic_block *, std::vector<std::pair<variable *, instruction *>>> incomplete_phis_;
+    std::unordered_set<basic_block *> sealed_;
+
+    DECLARE_VISIT_METHODS
+
+    void build_function(procedure *symbol, ast::block *body);
+
+    bool is_memory(variable *var) const;
+    instruction *emit(op kind, std::vector<instruction *> operands = { });
+    instruction *evaluate(ast::expression *expr);
+    void assign(variable *var, instruction *value);
+    void jump(basic_block *target);
+    void add_edge(basic_block *from, basic_block *to);
+    instruction *zero();
+
+    void write_variable(variable *var, basic_block *block, instruction *value);
+    instruction *read_variable(variable *var, basic_block *block);
+    instruction *read_variable_recursive(variable *var, basic_block *block);
+    void add_phi_operands(variable *var, instruction *phi);
+    void seal_block(basic_block *block);
+public:
+    explicit builder(module &m)
+            : module_(m), fn_(nullptr), scope_(nullptr), current_(nullptr), value_(nullptr), zero_(nullptr), line_(0) { }
+
+    void build(ast::block *program);
+};
+
+}
+
+#endif //PL0_IR_BUILDER_H
@@ -0,0 +1,89 @@
+#include <unordered_set>
+
+#include "cfg.h"
+
+namespace pl0::ir {
+
+std::vector<basic_block *> reverse_postorder(const function &fn) {
+    std::vector<basic_block *> order;
+    std::unordered_set<basic_block *> visited;
+    // explicit stack: generated programs can nest deeply
+    std::vector<std::pair<basic_block *, size_t>> stack{ { fn.entry(), 0 } };
+    visited.insert(fn.entry());
+    while (!stack.empty()) {
+        auto &top = stack.back();
+        auto succs = top.first->successors();
+        if (top.second < succs.size()) {
+            // last successor first, so the first one directly follows its block in the order
+            auto next = succs[succs.size() - ++top.second];
+            if (visited.insert(next).second)
+                stack.emplace_back(next, 0);
+        } else {
+            order.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+    return std::vector<basic_block *>(order.rbegin(), order.rend());
+}
+
+dominator_tree::dominator_tree(const function &fn) : order_(reverse_postorder(fn)) {
+    for (size_t i = 0; i < order_.size(); i++)
+        index_[order_[i]] = static_cast<int>(i);
+
+    auto entry = order_.front();
+    idom_[entry] = entry;
+    auto intersect = [this](basic_block *a, basic_block *b) {
+        while (a != b) {
+            while (index_[a] > index_[b])
+                a = idom_[a];
+            while (index_[b] > index_[a])
+                b = idom_[b];
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < order_.size(); i++) {
+            auto bb = order_[i];
+            basic_block *new_idom = nullptr;
+            for (auto pred : bb->predecessors) {
+                // unreachable or not yet processed
+                if (!idom_.count(pred))
+                    continue;
+                new_idom = new_idom ? intersect(pred, new_idom) : pred;
+            }
+            auto iter = idom_.find(bb);
+            if (new_idom && (iter == idom_.end() || iter->second != new_idom)) {
+                idom_[bb] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    for (size_t i = 1; i < order_.size(); i++)
+        children_[idom_[order_[i]]].push_back(order_[i]);
+    idom_[entry] = nullptr;
+}
+
+basic_block *dominator_tree::idom(basic_block *block) const {
+    auto iter = idom_.find(block);
+    return iter == idom_.end() ? nullptr : iter->second;
+}
+
+const std::vector<basic_block *> &dominator_tree::children(basic_block *block) const {
+    static const std::vector<basic_block *> none;
+    auto iter = children_.find(block);
+    return iter == children_.end() ? none : iter->second;
+}
+
+bool dominator_tree::dominates(basic_block *a, basic_block *b) const {
+    if (!index_.count(b))
+        return false;
+    while (b != nullptr && b != a)
+        b = idom(b);
+    return b == a;
+}
+
+}
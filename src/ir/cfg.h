@@ -0,0 +1,39 @@
+#ifndef PL0_IR_CFG_H
+#define PL0_IR_CFG_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "ir.h"
+
+namespace pl0::ir {
+
+// blocks reachable from the entry, each appearing before its successors except along back edges
+std::vector<basic_block *> reverse_postorder(const function &fn);
+
+/**
+ * Immediate dominators computed with the iterative algorithm of Cooper,
+ * Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+ */
+class dominator_tree {
+    std::vector<basic_block *> order_;
+    std::unordered_map<basic_block *, int> index_;
+    std::unordered_map<basic_block *, basic_block *> idom_;
+    std::unordered_map<basic_block *, std::vector<basic_block *>> children_;
+public:
+    explicit dominator_tree(const function &fn);
+
+    // reverse postorder of the reachable blocks
+    const std::vector<basic_block *> &order() const { return order_; }
+
+    // nullptr for the entry block
+    basic_block *idom(basic_block *block) const;
+
+    const std::vector<basic_block *> &children(basic_block *block) const;
+
+    bool dominates(basic_block *a, basic_block *b) const;
+};
+
+}
+
+#endif //PL0_IR_CFG_H
@@ -0,0 +1,208 @@
+#include <algorithm>
+
+#include "ir.h"
+
+namespace pl0::ir {
+
+#define T(x) #x,
+static const char *const ir_op_name[] = {
+    IR_OPCODE_LIST(T)
+};
+#undef T
+
+const char *op_name(op kind) {
+    return ir_op_name[static_cast<int>(kind)];
+}
+
+basic_block::~basic_block() {
+    for (auto ins : instructions)
+        delete ins;
+}
+
+std::vector<basic_block *> basic_block::successors() const {
+    auto term = terminator();
+    return term ? term->targets : std::vector<basic_block *>{ };
+}
+
+int basic_block::predecessor_index(basic_block *pred) const {
+    auto iter = std::find(predecessors.begin(), predecessors.end(), pred);
+    return iter == predecessors.end() ? -1 : static_cast<int>(iter - predecessors.begin());
+}
+
+function::~function() {
+    for (auto bb : blocks)
+        delete bb;
+}
+
+basic_block *function::create_block() {
+    auto bb = new basic_block(next_block_id_++, this);
+    blocks.push_back(bb);
+    return bb;
+}
+
+instruction *function::create(op kind) {
+    return new instruction(kind, next_value_id_++);
+}
+
+size_t function::instruction_count() const {
+    size_t count = 0;
+    for (auto bb : blocks)
+        count += bb->instructions.size();
+    return count;
+}
+
+int function::remove_unreachable_blocks() {
+    std::unordered_set<basic_block *> reachable{ entry() };
+    std::vector<basic_block *> worklist{ entry() };
+    while (!worklist.empty()) {
+        auto bb = worklist.back();
+        worklist.pop_back();
+        for (auto succ : bb->successors()) {
+            if (reachable.insert(succ).second)
+                worklist.push_back(succ);
+        }
+    }
+
+    int removed = 0;
+    for (auto bb : blocks) {
+        if (reachable.count(bb))
+            continue;
+        for (auto succ : bb->successors()) {
+            if (!reachable.count(succ))
+                continue;
+            int index;
+            while ((index = succ->predecessor_index(bb)) >= 0) {
+                succ->predecessors.erase(succ->predecessors.begin() + index);
+                for (auto ins : succ->instructions) {
+                    if (ins->kind == op::phi)
+                        ins->operands.erase(ins->operands.begin() + index);
+                }
+            }
+        }
+        removed++;
+    }
+    if (removed == 0)
+        return 0;
+
+    // values defined in dead blocks may still appear as operands of other dead instructions only
+    std::vector<basic_block *> kept;
+    for (auto bb : blocks) {
+        if (reachable.count(bb))
+            kept.push_back(bb);
+        else
+            delete bb;
+    }
+    blocks = std::move(kept);
+    return removed;
+}
+
+void function::replace_values(const std::unordered_map<instruction *, instruction *> &replacements) {
+    if (replacements.empty())
+        return;
+    auto resolve = [&replacements](instruction *value) {
+        auto iter = replacements.find(value);
+        while (iter != replacements.end()) {
+            value = iter->second;
+            iter = replacements.find(value);
+        }
+        return value;
+    };
+    for (auto bb : blocks) {
+        std::vector<instruction *> kept;
+        for (auto ins : bb->instructions) {
+            if (replacements.count(ins)) {
+                delete ins;
+                continue;
+            }
+            for (auto &operand : ins->operands)
+                operand = resolve(operand);
+            kept.push_back(ins);
+        }
+        bb->instructions = std::move(kept);
+    }
+}
+
+void function::erase(const std::unordered_set<instruction *> &dead) {
+    if (dead.empty())
+        return;
+    for (auto bb : blocks) {
+        std::vector<instruction *> kept;
+        for (auto ins : bb->instructions) {
+            if (dead.count(ins))
+                delete ins;
+            else
+                kept.push_back(ins);
+        }
+        bb->instructions = std::move(kept);
+    }
+}
+
+std::unordered_map<instruction *, int> function::use_counts() const {
+    std::unordered_map<instruction *, int> counts;
+    for (auto bb : blocks) {
+        for (auto ins : bb->instructions) {
+            for (auto operand : ins->operands)
+                counts[operand]++;
+        }
+    }
+    return counts;
+}
+
+size_t module::instruction_count() const {
+    size_t count = 0;
+    for (auto fn : functions)
+        count += fn->instruction_count();
+    return count;
+}
+
+static void print_instruction(std::ostream &out, const instruction *ins) {
+    out << "    ";
+    if (ins->has_result())
+        out << '%' << ins->id << " = ";
+    out << op_name(ins->kind);
+    switch (ins->kind) {
+    case op::constant:
+        out << ' ' << ins->value;
+        break;
+    case op::unary:
+    case op::binary:
+        out << " '" << *ins->opr << '\'';
+        break;
+    case op::load:
+    case op::store:
+        out << ' ' << ins->var->get_name() << '@' << ins->var->get_level() << '[' << ins->var->get_index() << ']';
+        break;
+    case op::call:
+        out << ' ' << ins->callee->get_name();
+        break;
+    default:
+        break;
+    }
+    for (size_t i = 0; i < ins->operands.size(); i++) {
+        out << ' ' << '%' << ins->operands[i]->id;
+        if (ins->kind == op::phi)
+            out << "(bb" << ins->parent->predecessors[i]->id << ')';
+    }
+    for (auto target : ins->targets)
+        out << " bb" << target->id;
+    out << '\n';
+}
+
+void module::print(std::ostream &out) const {
+    for (auto fn : functions) {
+        out << "function " << fn->name() << " (level " << fn->level << ")\n";
+        for (auto bb : fn->blocks) {
+            out << "  bb" << bb->id << ':';
+            if (!bb->predecessors.empty()) {
+                out << " ; preds";
+                for (auto pred : bb->predecessors)
+                    out << " bb" << pred->id;
+            }
+            out << '\n';
+            for (auto ins : bb->instructions)
+                print_instruction(out, ins);
+        }
+    }
+}
+
+}
@@ -0,0 +1,183 @@
+#ifndef PL0_IR_H
+#define PL0_IR_H
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../ast/ast.h"
+
+namespace pl0::ir {
+
+/*
+ * A mid-level SSA representation. Locals of a procedure that no nested
+ * procedure refers to are promoted to SSA values; every other variable
+ * (globals, variables of enclosing procedures and locals captured by nested
+ * procedures) is memory, accessed with load and store. Calls may read and
+ * write any memory variable.
+ */
+
+#define IR_OPCODE_LIST(T) \
+    T(constant) T(phi) T(copy) T(unary) T(binary) \
+    T(load) T(store) T(read) T(write) T(call) \
+    T(jump) T(branch) T(ret)
+
+#define T(x) x,
+enum class op : int {
+    IR_OPCODE_LIST(T)
+};
+#undef T
+
+const char *op_name(op kind);
+
+class basic_block;
+class function;
+
+class instruction {
+public:
+    op kind;
+    int id;
+    basic_block *parent;
+    std::vector<instruction *> operands;
+    // constant: the value
+    int value;
+    // unary and binary: the operator
+    token opr;
+    // load and store: the memory variable
+    variable *var;
+    // call: the procedure called
+    procedure *callee;
+    // jump: [target], branch: [if true, if false]
+    std::vector<basic_block *> targets;
+    // source line of the statement it comes from, 0 if unknown
+    int line = 0;
+
+    instruction(op kind, int id)
+            : kind(kind), id(id), parent(nullptr), value(0), opr(token::UNUSED), var(nullptr), callee(nullptr) { }
+
+    bool is_terminator() const {
+        return kind == op::jump || kind == op::branch || kind == op::ret;
+    }
+
+    // produces a value that other instructions can use
+    bool has_result() const {
+        return kind == op::constant || kind == op::phi || kind == op::copy || kind == op::unary ||
+               kind == op::binary || kind == op::load || kind == op::read;
+    }
+
+    // may be removed when unused and freely moved or duplicated
+    bool is_pure() const {
+        return kind == op::constant || kind == op::copy || kind == op::unary || kind == op::binary;
+    }
+
+    // touches memory, input or output, or transfers control
+    bool has_side_effects() const {
+        return kind == op::store || kind == op::read || kind == op::write || kind == op::call || is_terminator();
+    }
+
+    // true if executing this instruction may change the memory variable `v`
+    bool may_write(variable *v) const {
+        return kind == op::call || (kind == op::store && var == v);
+    }
+};
+
+class basic_block {
+public:
+    int id;
+    function *parent;
+    std::vector<instruction *> instructions;
+    // phi operands are ordered like this list
+    std::vector<basic_block *> predecessors;
+
+    basic_block(int id, function *parent) : id(id), parent(parent) { }
+
+    ~basic_block();
+
+    instruction *terminator() const {
+        return !instructions.empty() && instructions.back()->is_terminator() ? instructions.back() : nullptr;
+    }
+
+    std::vector<basic_block *> successors() const;
+
+    int predecessor_index(basic_block *pred) const;
+
+    void append(instruction *ins) {
+        ins->parent = this;
+        instructions.push_back(ins);
+    }
+
+    void insert_phi(instruction *phi) {
+        phi->parent = this;
+        auto iter = instructions.begin();
+        while (iter != instructions.end() && (*iter)->kind == op::phi)
+            ++iter;
+        instructions.insert(iter, phi);
+    }
+};
+
+class function {
+    int next_block_id_;
+    int next_value_id_;
+public:
+    // nullptr for the main program
+    procedure *symbol;
+    ast::block *body;
+    int level;
+    std::vector<basic_block *> blocks;
+
+    function(procedure *symbol, ast::block *body, int level)
+            : next_block_id_(0), next_value_id_(0), symbol(symbol), body(body), level(level) { }
+
+    ~function();
+
+    function(const function &) = delete;
+    function &operator=(const function &) = delete;
+
+    basic_block *entry() const { return blocks.front(); }
+
+    std::string name() const { return symbol ? symbol->get_name() : "<program>"; }
+
+    basic_block *create_block();
+
+    instruction *create(op kind);
+
+    size_t instruction_count() const;
+
+    // forgets blocks that cannot be reached from the entry block
+    int remove_unreachable_blocks();
+
+    // redirects every operand in `replacements` (following chains) and deletes the replaced instructions
+    void replace_values(const std::unordered_map<instruction *, instruction *> &replacements);
+
+    // deletes instructions that are no longer used by anything outside the set
+    void erase(const std::unordered_set<instruction *> &dead);
+
+    // number of operands referring to each value
+    std::unordered_map<instruction *, int> use_counts() const;
+};
+
+class module {
+public:
+    // main program first, then procedures in declaration order
+    std::vector<function *> functions;
+
+    module() = default;
+
+    ~module() {
+        for (auto fn : functions)
+            delete fn;
+    }
+
+    module(const module &) = delete;
+    module &operator=(const module &) = delete;
+
+    size_t instruction_count() const;
+
+    void print(std::ostream &out) const;
+};
+
+}
+
+#endif //PL0_IR_H
@@ -0,0 +1,58 @@
+#include <algorithm>
+
+#include "loops.h"
+
+namespace pl0::ir {
+
+std::vector<basic_block *> loop::body(const dominator_tree &tree) const {
+    std::vector<basic_block *> result;
+    for (auto bb : tree.order()) {
+        if (contains(bb))
+            result.push_back(bb);
+    }
+    return result;
+}
+
+std::vector<loop> find_loops(const function &fn, const dominator_tree &tree) {
+    std::vector<loop> loops;
+    for (auto header : tree.order()) {
+        loop l{ header, nullptr, { }, { header } };
+        for (auto pred : header->predecessors) {
+            if (tree.dominates(header, pred))
+                l.latches.push_back(pred);
+        }
+        if (l.latches.empty())
+            continue;
+
+        // everything that reaches a latch without passing the header
+        std::vector<basic_block *> worklist = l.latches;
+        while (!worklist.empty()) {
+            auto bb = worklist.back();
+            worklist.pop_back();
+            if (!l.blocks.insert(bb).second)
+                continue;
+            for (auto pred : bb->predecessors) {
+                // unreachable blocks may jump into the loop as well
+                if (tree.dominates(header, pred))
+                    worklist.push_back(pred);
+            }
+        }
+
+        for (auto pred : header->predecessors) {
+            if (l.contains(pred))
+                continue;
+            if (l.preheader != nullptr || pred->successors().size() != 1) {
+                l.preheader = nullptr;
+                break;
+            }
+            l.preheader = pred;
+        }
+        loops.push_back(std::move(l));
+    }
+    std::stable_sort(loops.begin(), loops.end(), [](const loop &a, const loop &b) {
+        return a.blocks.size() < b.blocks.size();
+    });
+    return loops;
+}
+
+}
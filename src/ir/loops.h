@@ -0,0 +1,32 @@
+#ifndef PL0_IR_LOOPS_H
+#define PL0_IR_LOOPS_H
+
+#include <unordered_set>
+#include <vector>
+
+#include "cfg.h"
+
+namespace pl0::ir {
+
+struct loop {
+    basic_block *header;
+    // the only block outside the loop that enters it, nullptr if there is none
+    basic_block *preheader;
+    // blocks jumping back to the header
+    std::vector<basic_block *> latches;
+    std::unordered_set<basic_block *> blocks;
+
+    bool contains(basic_block *bb) const { return blocks.count(bb) > 0; }
+
+    bool contains(instruction *ins) const { return contains(ins->parent); }
+
+    // loop blocks in reverse postorder, so definitions come before their uses
+    std::vector<basic_block *> body(const dominator_tree &tree) const;
+};
+
+// natural loops of the function, inner loops before the loops containing them
+std::vector<loop> find_loops(const function &fn, const dominator_tree &tree);
+
+}
+
+#endif //PL0_IR_LOOPS_H
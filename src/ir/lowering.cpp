@@ -0,0 +1,508 @@
+#include <algorithm>
+
+#include "lowering.h"
+#include "cfg.h"
+#include "../analysis/call-graph.h"
+
+namespace pl0::ir {
+
+namespace {
+
+// true if evaluating `moved` after `other` instead of before it may change the program
+bool conflicts(instruction *moved, instruction *other) {
+    if (moved->kind == op::load)
+        return other->may_write(moved->var);
+    if (moved->kind == op::read)
+        return other->kind == op::read || other->kind == op::write || other->kind == op::call;
+    return false;
+}
+
+/**
+ * Union-find over values with the interference of each class kept at its
+ * representative, so two classes can be merged whenever they do not interfere.
+ */
+class slot_classes {
+    std::unordered_map<instruction *, instruction *> parent_;
+    std::unordered_map<instruction *, std::unordered_set<instruction *>> interference_;
+public:
+    instruction *find(instruction *value) {
+        auto iter = parent_.find(value);
+        if (iter == parent_.end())
+            return value;
+        auto root = find(iter->second);
+        iter->second = root;
+        return root;
+    }
+
+    void interfere(instruction *a, instruction *b) {
+        a = find(a);
+        b = find(b);
+        if (a == b)
+            return;
+        interference_[a].insert(b);
+        interference_[b].insert(a);
+    }
+
+    const std::unordered_set<instruction *> &neighbours(instruction *value) {
+        return interference_[find(value)];
+    }
+
+    bool try_merge(instruction *a, instruction *b) {
+        a = find(a);
+        b = find(b);
+        if (a == b)
+            return true;
+        auto &into = interference_[b];
+        if (into.count(a))
+            return false;
+        for (auto n : interference_[a]) {
+            auto &others = interference_[n];
+            others.erase(a);
+            others.insert(b);
+            into.insert(n);
+        }
+        interference_.erase(a);
+        parent_[a] = b;
+        return true;
+    }
+};
+
+}
+
+void lowering::split_critical_edges() {
+    auto blocks = fn_->blocks;
+    for (auto bb : blocks) {
+        if (bb->instructions.empty() || bb->instructions.front()->kind != op::phi)
+            continue;
+        for (auto &pred : bb->predecessors) {
+            auto term = pred->terminator();
+            if (term->targets.size() < 2)
+                continue;
+            // phi copies need a place that runs on this edge only
+            auto split = fn_->create_block();
+            auto jump = fn_->create(op::jump);
+            jump->targets = { bb };
+            split->append(jump);
+            split->predecessors = { pred };
+            *std::find(term->targets.begin(), term->targets.end(), bb) = split;
+            pred = split;
+        }
+    }
+}
+
+bool lowering::needs_slot(instruction *ins) const {
+    if (!ins->has_result() || ins->kind == op::constant || inlined_.count(ins))
+        return false;
+    auto iter = uses_.find(ins);
+    return (iter != uses_.end() && iter->second > 0) || ins->kind == op::read;
+}
+
+void lowering::select_trees(basic_block *bb) {
+    auto &instructions = bb->instructions;
+    std::unordered_map<instruction *, size_t> position;
+    std::unordered_map<instruction *, instruction *> user;
+    for (size_t i = 0; i < instructions.size(); i++) {
+        position[instructions[i]] = i;
+        for (auto operand : instructions[i]->operands)
+            user[operand] = instructions[i];
+    }
+
+    // scanning backwards decides every user before its operands
+    std::vector<size_t> root(instructions.size());
+    for (size_t i = instructions.size(); i-- > 0;) {
+        auto ins = instructions[i];
+        root[i] = i;
+        if (!ins->has_result() || ins->kind == op::constant || ins->kind == op::phi || uses_[ins] != 1)
+            continue;
+        auto iter = user.find(ins);
+        if (iter == user.end() || iter->second->kind == op::phi)
+            continue;
+        auto consumer = iter->second;
+        if (consumer->has_result() && !inlined_.count(consumer) && !needs_slot(consumer))
+            continue;
+
+        size_t at = root[position[consumer]];
+        bool movable = true;
+        for (size_t j = i + 1; j < at && movable; j++)
+            movable = !conflicts(ins, instructions[j]);
+        if (movable) {
+            inlined_.insert(ins);
+            root[i] = at;
+        }
+    }
+}
+
+void lowering::collect_uses(instruction *ins, std::vector<instruction *> &out) const {
+    for (auto operand : ins->operands) {
+        if (operand->kind == op::constant)
+            continue;
+        if (inlined_.count(operand))
+            collect_uses(operand, out);
+        else
+            out.push_back(operand);
+    }
+}
+
+int lowering::allocate_slots(const std::vector<basic_block *> &layout) {
+    typedef std::unordered_set<instruction *> value_set;
+
+    auto phi_operands = [this](basic_block *from, basic_block *to, value_set &out) {
+        int index = to->predecessor_index(from);
+        for (auto ins : to->instructions) {
+            if (ins->kind != op::phi)
+                break;
+            auto operand = ins->operands[index];
+            if (needs_slot(ins) && needs_slot(operand))
+                out.insert(operand);
+        }
+    };
+
+    // walks the block backwards from `live`, calling `define` for every value it defines
+    auto transfer = [this](basic_block *bb, value_set &live, auto &&define) {
+        std::vector<instruction *> used;
+        for (auto iter = bb->instructions.rbegin(); iter != bb->instructions.rend(); ++iter) {
+            auto ins = *iter;
+            if (ins->kind == op::phi || inlined_.count(ins) || (ins->has_result() && !needs_slot(ins)))
+                continue;
+            if (ins->has_result()) {
+                define(ins, live);
+                live.erase(ins);
+            }
+            used.clear();
+            collect_uses(ins, used);
+            live.insert(used.begin(), used.end());
+        }
+    };
+    auto ignore = [](instruction *, const value_set &) { };
+
+    std::unordered_map<basic_block *, value_set> live_in, live_out;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto iter = layout.rbegin(); iter != layout.rend(); ++iter) {
+            auto bb = *iter;
+            value_set live;
+            for (auto succ : bb->successors()) {
+                auto &in = live_in[succ];
+                live.insert(in.begin(), in.end());
+                phi_operands(bb, succ, live);
+            }
+            live_out[bb] = live;
+            transfer(bb, live, ignore);
+            for (auto ins : bb->instructions) {
+                if (ins->kind == op::phi)
+                    live.erase(ins);
+            }
+            if (live != live_in[bb]) {
+                live_in[bb] = std::move(live);
+                changed = true;
+            }
+        }
+    }
+
+    slot_classes classes;
+    for (auto bb : layout) {
+        auto live = live_out[bb];
+        transfer(bb, live, [&classes](instruction *def, const value_set &live) {
+            for (auto other : live) {
+                if (other != def)
+                    classes.interfere(def, other);
+            }
+        });
+        // phis are all defined on entry to the block
+        for (auto ins : bb->instructions) {
+            if (ins->kind != op::phi)
+                break;
+            if (!needs_slot(ins))
+                continue;
+            live.erase(ins);
+            for (auto other : live)
+                classes.interfere(ins, other);
+            for (auto phi : bb->instructions) {
+                if (phi->kind != op::phi)
+                    break;
+                if (phi != ins && needs_slot(phi))
+                    classes.interfere(ins, phi);
+            }
+        }
+    }
+
+    for (auto bb : layout) {
+        for (auto ins : bb->instructions) {
+            if (!needs_slot(ins) || (ins->kind != op::phi && ins->kind != op::copy))
+                continue;
+            for (auto operand : ins->operands) {
+                if (needs_slot(operand))
+                    classes.try_merge(operand, ins);
+            }
+        }
+    }
+
+    // variables of this procedure that nested procedures access keep their slots
+    std::unordered_set<int> reserved;
+    int frame_size = 0;
+    for (auto var : fn_->body->belonging_scope()->get_variables()) {
+        if (memory_variables_.count(var)) {
+            reserved.insert(var->get_index());
+            frame_size = std::max(frame_size, var->get_index() + 1);
+        }
+    }
+
+    std::unordered_map<instruction *, int> colors;
+    for (auto bb : layout) {
+        for (auto ins : bb->instructions) {
+            if (!needs_slot(ins))
+                continue;
+            auto rep = classes.find(ins);
+            auto iter = colors.find(rep);
+            if (iter == colors.end()) {
+                std::unordered_set<int> taken = reserved;
+                for (auto n : classes.neighbours(rep)) {
+                    auto color = colors.find(n);
+                    if (color != colors.end())
+                        taken.insert(color->second);
+                }
+                int color = 0;
+                while (taken.count(color))
+                    color++;
+                iter = colors.emplace(rep, color).first;
+                frame_size = std::max(frame_size, color + 1);
+            }
+            slots_[ins] = iter->second;
+        }
+    }
+    return frame_size;
+}
+
+void lowering::emit_value(instruction *value) {
+    if (value->kind == op::constant)
+        assembler_.load(value->value);
+    else if (inlined_.count(value))
+        emit_computation(value);
+    else
+        assembler_.load(0, slots_.at(value));
+}
+
+void lowering::emit_computation(instruction *ins) {
+    for (auto operand : ins->operands)
+        emit_value(operand);
+    switch (ins->kind) {
+    case op::unary:
+    case op::binary:
+        assembler_.operation(ins->opr);
+        break;
+    case op::load:
+        assembler_.load(fn_->level - ins->var->get_level(), ins->var->get_index());
+        break;
+    case op::read:
+        assembler_.read();
+        break;
+    default:
+        break;
+    }
+}
+
+void lowering::emit_phi_copies(basic_block *from, basic_block *to) {
+    int index = to->predecessor_index(from);
+    std::vector<instruction *> targets;
+    for (auto ins : to->instructions) {
+        if (ins->kind != op::phi)
+            break;
+        auto operand = ins->operands[index];
+        if (!needs_slot(ins) || (needs_slot(operand) && slots_[operand] == slots_[ins]))
+            continue;
+        // all operands are loaded before any phi is stored, as the copies happen in parallel
+        emit_value(operand);
+        targets.push_back(ins);
+    }
+    for (auto iter = targets.rbegin(); iter != targets.rend(); ++iter)
+        assembler_.store(0, slots_[*iter]);
+}
+
+bool lowering::is_empty_edge(basic_block *bb) {
+    if (bb == fn_->entry() || bb->instructions.size() != 1 || bb->instructions.front()->kind != op::jump)
+        return false;
+    auto target = bb->instructions.front()->targets[0];
+    int index = target->predecessor_index(bb);
+    for (auto ins : target->instructions) {
+        if (ins->kind != op::phi)
+            break;
+        auto operand = ins->operands[index];
+        if (needs_slot(ins) && !(needs_slot(operand) && slots_[operand] == slots_[ins]))
+            return false;
+    }
+    return true;
+}
+
+basic_block *lowering::forward(basic_block *target) const {
+    auto iter = forwarding_.find(target);
+    return iter == forwarding_.end() ? target : iter->second;
+}
+
+void lowering::emit_jump(basic_block *target, basic_block *next) {
+    target = forward(target);
+    if (target == next)
+        return;
+    // returning directly is as short as jumping to a return
+    if (target->instructions.size() == 1 && target->instructions.front()->kind == op::ret)
+        assembler_.leave();
+    else
+        jumps_.emplace_back(assembler_.branch(), target);
+}
+
+bool lowering::is_tail_call(basic_block *bb, size_t index) const {
+    auto call = bb->instructions[index];
+    // the callee must not need this frame as its static link
+    if (fn_->level <= call->callee->get_level() || index + 1 >= bb->instructions.size())
+        return false;
+    auto next = bb->instructions[index + 1];
+    if (next->kind == op::ret)
+        return true;
+    if (next->kind != op::jump)
+        return false;
+    auto &target = next->targets[0]->instructions;
+    return target.size() == 1 && target.front()->kind == op::ret;
+}
+
+void lowering::lower_block(basic_block *bb, basic_block *next) {
+    auto &instructions = bb->instructions;
+    for (size_t i = 0; i < instructions.size(); i++) {
+        auto ins = instructions[i];
+        // instructions the passes made up belong to the line before them
+        if (ins->line != 0)
+            assembler_.set_line(ins->line);
+        switch (ins->kind) {
+        case op::constant:
+        case op::phi:
+            break;
+        case op::copy:
+        case op::unary:
+        case op::binary:
+        case op::load:
+        case op::read:
+            if (!needs_slot(ins))
+                break;
+            if (ins->kind == op::copy && needs_slot(ins->operands[0]) && slots_[ins->operands[0]] == slots_[ins])
+                break;
+            emit_computation(ins);
+            assembler_.store(0, slots_[ins]);
+            break;
+        case op::store:
+            emit_value(ins->operands[0]);
+            assembler_.store(fn_->level - ins->var->get_level(), ins->var->get_index());
+            break;
+        case op::write:
+            emit_value(ins->operands[0]);
+            assembler_.write();
+            break;
+        case op::call:
+            if (is_tail_call(bb, i)) {
+                patch_list_[ins->callee].push_back(assembler_.tail_call(fn_->level));
+                return;
+            }
+            if (static_frames_.count(ins->callee))
+                patch_list_[ins->callee].push_back(assembler_.static_call(fn_->level));
+            else
+                patch_list_[ins->callee].push_back(assembler_.call(fn_->level));
+            break;
+        case op::jump:
+            emit_phi_copies(bb, ins->targets[0]);
+            emit_jump(ins->targets[0], next);
+            break;
+        case op::branch:
+            emit_value(ins->operands[0]);
+            jumps_.emplace_back(assembler_.branch_if_false(), forward(ins->targets[1]));
+            emit_jump(ins->targets[0], next);
+            break;
+        case op::ret:
+            assembler_.leave();
+            break;
+        }
+    }
+}
+
+void lowering::lower_function(function *fn) {
+    fn_ = fn;
+    inlined_.clear();
+    slots_.clear();
+    labels_.clear();
+    jumps_.clear();
+
+    fn->remove_unreachable_blocks();
+    split_critical_edges();
+    uses_ = fn->use_counts();
+    auto layout = reverse_postorder(*fn);
+    for (auto bb : layout)
+        select_trees(bb);
+    int frame_size = allocate_slots(layout);
+
+    // blocks that only jump on without copying anything are skipped altogether
+    forwarding_.clear();
+    for (auto bb : layout) {
+        if (is_empty_edge(bb))
+            forwarding_[bb] = bb->instructions.front()->targets[0];
+    }
+    std::unordered_map<basic_block *, basic_block *> resolved;
+    for (auto &kv : forwarding_) {
+        auto target = kv.second;
+        for (size_t steps = 0; forwarding_.count(target) && steps < forwarding_.size(); steps++)
+            target = forwarding_.at(target);
+        // a loop made of nothing but jumps has to stay
+        if (!forwarding_.count(target))
+            resolved[kv.first] = target;
+    }
+    forwarding_ = std::move(resolved);
+    std::vector<basic_block *> kept;
+    for (auto bb : layout) {
+        if (!forwarding_.count(bb))
+            kept.push_back(bb);
+    }
+    layout = std::move(kept);
+
+    if (fn->symbol) {
+        entry_points_[fn->symbol] = assembler_.get_next_address();
+        procedures_.push_back({ fn->name(), assembler_.get_next_address(), fn->symbol->get_level() + 1, fn->symbol });
+    } else {
+        procedures_.push_back({ fn->name(), assembler_.get_next_address(), 0 });
+    }
+    assembler_.set_line(fn->body->loc().line);
+    assembler_.enter(frame_size + 3);
+    for (size_t i = 0; i < layout.size(); i++) {
+        labels_[layout[i]] = assembler_.get_next_address();
+        lower_block(layout[i], i + 1 < layout.size() ? layout[i + 1] : nullptr);
+    }
+    for (auto &jump : jumps_)
+        jump.first.set_address(labels_.at(jump.second));
+}
+
+void lowering::generate(module &m) {
+    for (auto fn : m.functions) {
+        for (auto bb : fn->blocks) {
+            for (auto ins : bb->instructions) {
+                if (ins->kind == op::load || ins->kind == op::store)
+                    memory_variables_.insert(ins->var);
+            }
+        }
+    }
+
+    analysis::call_graph graph{m.functions.front()->body};
+    for (auto proc : graph.procedures()) {
+        if (proc && !graph.is_recursive(proc))
+            static_frames_.insert(proc);
+    }
+
+    for (auto fn : m.functions)
+        lower_function(fn);
+
+    for (auto &kv : patch_list_) {
+        auto entry = entry_points_.find(kv.first);
+        if (entry == entry_points_.end())
+            throw general_error("unexpected error");
+        for (auto patch : kv.second) {
+            patch.set_level(patch.get_level() - kv.first->get_level());
+            patch.set_address(entry->second);
+        }
+    }
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef PL0_IR_LOWERING_H
+#define PL0_IR_LOWERING_H
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ir.h"
+#include "../bytecode/assembler.h"
+
+namespace pl0::ir {
+
+/**
+ * Lowers the SSA form back to stack bytecode. Values used once, right where
+ * they are computed, are evaluated on the operand stack like the tree-walking
+ * compiler would; every other value gets a frame slot. Slots are assigned by
+ * coloring the interference graph after coalescing phis with their operands,
+ * so promoted locals no longer need a slot of their own.
+ */
+class lowering {
+    assembler assembler_;
+    procedure_table procedures_;
+    std::unordered_map<procedure *, int> entry_points_;
+    std::unordered_map<procedure *, std::vector<backpatcher>> patch_list_;
+    // variables some function loads or stores, their frame slots cannot be reused
+    std::unordered_set<variable *> memory_variables_;
+    // procedures with at most one activation at a time, called with SCL
+    std::unordered_set<procedure *> static_frames_;
+
+    // per function state
+    function *fn_;
+    std::unordered_map<instruction *, int> uses_;
+    std::unordered_set<instruction *> inlined_;
+    std::unordered_map<instruction *, int> slots_;
+    std::unordered_map<basic_block *, int> labels_;
+    std::unordered_map<basic_block *, basic_block *> forwarding_;
+    std::vector<std::pair<backpatcher, basic_block *>> jumps_;
+
+    void split_critical_edges();
+    void select_trees(basic_block *bb);
+    void collect_uses(instruction *ins, std::vector<instruction *> &out) const;
+    bool needs_slot(instruction *ins) const;
+    int allocate_slots(const std::vector<basic_block *> &layout);
+
+    void lower_function(function *fn);
+    void lower_block(basic_block *bb, basic_block *next);
+    void emit_value(instruction *value);
+    void emit_computation(instruction *ins);
+    void emit_phi_copies(basic_block *from, basic_block *to);
+    void emit_jump(basic_block *target, basic_block *next);
+    bool is_empty_edge(basic_block *bb);
+    basic_block *forward(basic_block *target) const;
+    bool is_tail_call(basic_block *bb, size_t index) const;
+public:
+    lowering() : fn_(nullptr) { }
+
+    void generate(module &m);
+
+    const bytecode &code() { return assembler_.get_bytecode(); }
+
+    const line_table &lines() const { return assembler_.get_lines(); }
+
+    const procedure_table &procedures() const { return procedures_; }
+};
+
+}
+
+#endif //PL0_IR_LOWERING_H
@@ -0,0 +1,51 @@
+#include <iomanip>
+#include <sstream>
+
+#include "pass-manager.h"
+#include "passes/passes.h"
+
+namespace pl0::ir {
+
+const char *const pass_manager::default_pipeline = "copy-prop,gvn,licm,sr,copy-prop,dse,dce";
+
+std::unique_ptr<pass> pass_manager::create(const std::string &name) {
+#define CREATE_PASS(type, pass_name) \
+    if (name == pass_name) \
+        return std::make_unique<type>();
+    IR_PASS_LIST(CREATE_PASS)
+#undef CREATE_PASS
+    return nullptr;
+}
+
+void pass_manager::add_pipeline(const std::string &pipeline) {
+    std::istringstream in(pipeline);
+    std::string name;
+    while (std::getline(in, name, ',')) {
+        if (name.empty())
+            continue;
+        auto p = create(name);
+        if (!p)
+            throw general_error("unknown IR pass '", name, '\'');
+        add(std::move(p));
+    }
+}
+
+void pass_manager::run(module &m) {
+    for (auto &p : passes_) {
+        size_t before = m.instruction_count();
+        for (auto fn : m.functions)
+            p->run(*fn);
+        records_.push_back({ p->name(), before, m.instruction_count() });
+    }
+}
+
+void pass_manager::report(std::ostream &out) const {
+    out << std::left << std::setw(16) << "pass" << std::right << std::setw(10) << "before"
+        << std::setw(10) << "after" << '\n';
+    for (auto &r : records_) {
+        out << std::left << std::setw(16) << r.name << std::right << std::setw(10) << r.before
+            << std::setw(10) << r.after << '\n';
+    }
+}
+
+}
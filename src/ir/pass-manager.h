@@ -0,0 +1,54 @@
+#ifndef PL0_IR_PASS_MANAGER_H
+#define PL0_IR_PASS_MANAGER_H
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ir.h"
+
+namespace pl0::ir {
+
+class pass {
+public:
+    virtual ~pass() = default;
+
+    virtual const char *name() const = 0;
+
+    // returns true if the function was changed
+    virtual bool run(function &fn) = 0;
+};
+
+/**
+ * Runs a pipeline of passes over every function of a module and records the
+ * module's instruction count before and after each pass.
+ */
+class pass_manager {
+    struct record {
+        std::string name;
+        size_t before;
+        size_t after;
+    };
+
+    std::vector<std::unique_ptr<pass>> passes_;
+    std::vector<record> records_;
+public:
+    static const char *const default_pipeline;
+
+    // creates a pass from its name, nullptr if there is no such pass
+    static std::unique_ptr<pass> create(const std::string &name);
+
+    void add(std::unique_ptr<pass> p) { passes_.push_back(std::move(p)); }
+
+    // adds the passes of a comma-separated pipeline description
+    void add_pipeline(const std::string &pipeline);
+
+    void run(module &m);
+
+    void report(std::ostream &out) const;
+};
+
+}
+
+#endif //PL0_IR_PASS_MANAGER_H
@@ -0,0 +1,49 @@
+#include "passes.h"
+
+namespace pl0::ir {
+
+bool copy_propagation::run(function &fn) {
+    bool changed = false;
+    while (true) {
+        std::unordered_map<instruction *, instruction *> replacements;
+        auto resolve = [&replacements](instruction *value) {
+            auto iter = replacements.find(value);
+            while (iter != replacements.end()) {
+                value = iter->second;
+                iter = replacements.find(value);
+            }
+            return value;
+        };
+
+        for (auto bb : fn.blocks) {
+            for (auto ins : bb->instructions) {
+                if (ins->kind == op::copy) {
+                    replacements[ins] = resolve(ins->operands[0]);
+                } else if (ins->kind == op::phi) {
+                    // a phi whose operands are itself or one other value is that value
+                    instruction *same = nullptr;
+                    bool trivial = true;
+                    for (auto operand : ins->operands) {
+                        operand = resolve(operand);
+                        if (operand == ins || operand == same)
+                            continue;
+                        if (same != nullptr) {
+                            trivial = false;
+                            break;
+                        }
+                        same = operand;
+                    }
+                    if (trivial && same != nullptr)
+                        replacements[ins] = same;
+                }
+            }
+        }
+
+        if (replacements.empty())
+            return changed;
+        fn.replace_values(replacements);
+        changed = true;
+    }
+}
+
+}
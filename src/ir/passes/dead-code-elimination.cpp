@@ -0,0 +1,35 @@
+#include "passes.h"
+
+namespace pl0::ir {
+
+bool dead_code_elimination::run(function &fn) {
+    // mark from the instructions that must stay, so unused phi cycles die too
+    std::unordered_set<instruction *> live;
+    std::vector<instruction *> worklist;
+    for (auto bb : fn.blocks) {
+        for (auto ins : bb->instructions) {
+            if (ins->has_side_effects() && live.insert(ins).second)
+                worklist.push_back(ins);
+        }
+    }
+    while (!worklist.empty()) {
+        auto ins = worklist.back();
+        worklist.pop_back();
+        for (auto operand : ins->operands) {
+            if (live.insert(operand).second)
+                worklist.push_back(operand);
+        }
+    }
+
+    std::unordered_set<instruction *> dead;
+    for (auto bb : fn.blocks) {
+        for (auto ins : bb->instructions) {
+            if (!live.count(ins))
+                dead.insert(ins);
+        }
+    }
+    fn.erase(dead);
+    return !dead.empty();
+}
+
+}
@@ -0,0 +1,59 @@
+#include "passes.h"
+
+namespace pl0::ir {
+
+/*
+ * Works within a block: a store is dead when the same variable is stored
+ * again before any load of it or any call, when it targets a local of this
+ * procedure and the procedure returns before reading it back, or when it
+ * writes the value the variable already holds.
+ */
+bool dead_store_elimination::run(function &fn) {
+    std::unordered_set<instruction *> dead;
+    for (auto bb : fn.blocks) {
+        std::unordered_map<variable *, instruction *> pending;
+        // the value each variable is known to hold
+        std::unordered_map<variable *, instruction *> current;
+        for (auto ins : bb->instructions) {
+            switch (ins->kind) {
+            case op::store: {
+                // storing back what was just loaded changes nothing
+                auto loaded = current.find(ins->var);
+                if (loaded != current.end() && loaded->second == ins->operands[0]) {
+                    dead.insert(ins);
+                    break;
+                }
+                current[ins->var] = ins->operands[0];
+                auto &previous = pending[ins->var];
+                if (previous != nullptr)
+                    dead.insert(previous);
+                previous = ins;
+                break;
+            }
+            case op::load:
+                pending.erase(ins->var);
+                current.emplace(ins->var, ins);
+                break;
+            case op::ret:
+                for (auto &kv : pending) {
+                    if (kv.first->get_level() == fn.level)
+                        dead.insert(kv.second);
+                }
+                pending.clear();
+                break;
+            case op::call:
+            case op::jump:
+            case op::branch:
+                pending.clear();
+                current.clear();
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    fn.erase(dead);
+    return !dead.empty();
+}
+
+}
@@ -0,0 +1,94 @@
+#include "passes.h"
+#include "../loops.h"
+
+namespace pl0::ir {
+
+namespace {
+
+bool is_hoistable(instruction *ins) {
+    return ins->kind == op::constant || ins->kind == op::copy || ins->kind == op::unary ||
+           ins->kind == op::binary || ins->kind == op::load;
+}
+
+// division traps on a zero divisor, so it may only run as often as before
+bool may_trap(instruction *ins) {
+    if (ins->kind != op::binary || ins->opr != token::DIV)
+        return false;
+    auto divisor = ins->operands[1];
+    return divisor->kind != op::constant || divisor->value == 0 || divisor->value == -1;
+}
+
+bool hoist(const dominator_tree &tree, const loop &l) {
+    bool has_call = false;
+    std::unordered_set<variable *> written;
+    for (auto bb : l.blocks) {
+        for (auto ins : bb->instructions) {
+            if (ins->kind == op::call)
+                has_call = true;
+            else if (ins->kind == op::store)
+                written.insert(ins->var);
+        }
+    }
+
+    std::unordered_set<instruction *> invariant;
+    std::vector<instruction *> candidates;
+    for (auto bb : l.body(tree)) {
+        for (auto ins : bb->instructions) {
+            if (!is_hoistable(ins))
+                continue;
+            if (ins->kind == op::load && (has_call || written.count(ins->var)))
+                continue;
+            if (bb != l.header && may_trap(ins))
+                continue;
+            bool operands_invariant = true;
+            for (auto operand : ins->operands)
+                operands_invariant &= !l.contains(operand) || invariant.count(operand) > 0;
+            if (operands_invariant) {
+                invariant.insert(ins);
+                candidates.push_back(ins);
+            }
+        }
+    }
+
+    // a constant or a load on its own is as cheap to redo as to reload from a slot
+    std::unordered_set<instruction *> hoisted;
+    for (auto iter = candidates.rbegin(); iter != candidates.rend(); ++iter) {
+        auto ins = *iter;
+        if (ins->kind != op::constant && ins->kind != op::load)
+            hoisted.insert(ins);
+        if (hoisted.count(ins))
+            hoisted.insert(ins->operands.begin(), ins->operands.end());
+    }
+    if (hoisted.empty())
+        return false;
+
+    auto &target = l.preheader->instructions;
+    for (auto bb : l.body(tree)) {
+        std::vector<instruction *> kept;
+        for (auto ins : bb->instructions) {
+            if (hoisted.count(ins) && l.contains(ins)) {
+                ins->parent = l.preheader;
+                target.insert(target.end() - 1, ins);
+            } else {
+                kept.push_back(ins);
+            }
+        }
+        bb->instructions = std::move(kept);
+    }
+    return true;
+}
+
+}
+
+bool loop_invariant_code_motion::run(function &fn) {
+    bool changed = false;
+    dominator_tree tree{fn};
+    // hoisting out of an inner loop lands in the preheader, which belongs to the outer loop
+    for (auto &l : find_loops(fn, tree)) {
+        if (l.preheader != nullptr)
+            changed |= hoist(tree, l);
+    }
+    return changed;
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef PL0_IR_PASSES_H
+#define PL0_IR_PASSES_H
+
+#include "../pass-manager.h"
+
+namespace pl0::ir {
+
+#define IR_PASS_LIST(V) \
+    V(copy_propagation, "copy-prop") \
+    V(value_numbering, "gvn") \
+    V(loop_invariant_code_motion, "licm") \
+    V(strength_reduction, "sr") \
+    V(dead_store_elimination, "dse") \
+    V(dead_code_elimination, "dce")
+
+// Replaces copies and trivial phis by the value they forward.
+class copy_propagation : public pass {
+public:
+    const char *name() const override { return "copy-prop"; }
+
+    bool run(function &fn) override;
+};
+
+// Dominator-scoped value numbering of pure computations with constant folding.
+class value_numbering : public pass {
+public:
+    const char *name() const override { return "gvn"; }
+
+    bool run(function &fn) override;
+};
+
+// Moves computations that give the same result in every iteration into the loop's preheader.
+class loop_invariant_code_motion : public pass {
+public:
+    const char *name() const override { return "licm"; }
+
+    bool run(function &fn) override;
+};
+
+// Replaces multiplications of an induction variable by a constant with a new induction variable.
+class strength_reduction : public pass {
+public:
+    const char *name() const override { return "sr"; }
+
+    bool run(function &fn) override;
+};
+
+// Removes stores to memory variables that are overwritten or die before being read.
+class dead_store_elimination : public pass {
+public:
+    const char *name() const override { return "dse"; }
+
+    bool run(function &fn) override;
+};
+
+// Removes values that nothing uses and that have no side effects.
+class dead_code_elimination : public pass {
+public:
+    const char *name() const override { return "dce"; }
+
+    bool run(function &fn) override;
+};
+
+}
+
+#endif //PL0_IR_PASSES_H
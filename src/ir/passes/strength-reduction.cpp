@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <climits>
+
+#include "passes.h"
+#include "../loops.h"
+
+namespace pl0::ir {
+
+namespace {
+
+bool fits(long long value) {
+    return value >= INT_MIN && value <= INT_MAX;
+}
+
+instruction *other_operand(instruction *binary, instruction *value) {
+    return binary->operands[0] == value ? binary->operands[1] : binary->operands[0];
+}
+
+void insert_before(instruction *position, instruction *ins) {
+    auto &instructions = position->parent->instructions;
+    ins->parent = position->parent;
+    instructions.insert(std::find(instructions.begin(), instructions.end(), position), ins);
+}
+
+/**
+ * A basic induction variable `i = phi(init, i + step)` whose only other uses
+ * are multiplications by one constant and the loop's exit test.
+ */
+struct induction {
+    instruction *phi = nullptr;
+    instruction *init = nullptr;
+    instruction *next = nullptr;
+    int step = 0;
+    int factor = 0;
+    std::vector<instruction *> products;
+    instruction *test = nullptr;
+};
+
+class reducer {
+    function &fn_;
+    const loop &loop_;
+    std::unordered_map<instruction *, std::vector<instruction *>> users_;
+    int preheader_index_;
+    int latch_index_;
+
+    bool match_step(induction &iv);
+    bool match_uses(induction &iv);
+    bool test_in_range(const induction &iv) const;
+    void rewrite(induction &iv);
+public:
+    reducer(function &fn, const loop &l) : fn_(fn), loop_(l) {
+        preheader_index_ = l.header->predecessor_index(l.preheader);
+        latch_index_ = l.header->predecessor_index(l.latches.front());
+        for (auto bb : fn.blocks) {
+            for (auto ins : bb->instructions) {
+                for (auto operand : ins->operands)
+                    users_[operand].push_back(ins);
+            }
+        }
+    }
+
+    bool run();
+};
+
+bool reducer::match_step(induction &iv) {
+    auto next = iv.phi->operands[latch_index_];
+    if (next->kind != op::binary || !loop_.contains(next) || users_[next].size() != 1)
+        return false;
+    if (next->opr == token::ADD && (next->operands[0] == iv.phi || next->operands[1] == iv.phi)) {
+        auto step = other_operand(next, iv.phi);
+        if (step->kind != op::constant)
+            return false;
+        iv.step = step->value;
+    } else if (next->opr == token::SUB && next->operands[0] == iv.phi && next->operands[1]->kind == op::constant &&
+               next->operands[1]->value != INT_MIN) {
+        iv.step = -next->operands[1]->value;
+    } else {
+        return false;
+    }
+    iv.next = next;
+    iv.init = iv.phi->operands[preheader_index_];
+    return iv.step != 0;
+}
+
+bool reducer::match_uses(induction &iv) {
+    auto branch = loop_.header->terminator();
+    for (auto user : users_[iv.phi]) {
+        if (user == iv.next)
+            continue;
+        if (user->kind != op::binary || user->operands[0] == user->operands[1])
+            return false;
+        auto other = other_operand(user, iv.phi);
+        if (other->kind != op::constant)
+            return false;
+        if (user->opr == token::MUL && other->value > 0 && (iv.factor == 0 || iv.factor == other->value)) {
+            iv.factor = other->value;
+            iv.products.push_back(user);
+        } else if (iv.test == nullptr && branch->kind == op::branch && branch->operands[0] == user &&
+                   users_[user].size() == 1 && loop_.contains(branch->targets[0]) &&
+                   !loop_.contains(branch->targets[1])) {
+            iv.test = user;
+        } else {
+            return false;
+        }
+    }
+    return !iv.products.empty();
+}
+
+/*
+ * Comparing i * factor against bound * factor only means the same as
+ * comparing i against bound if no value the test sees overflows. The test
+ * must move i towards the bound, which keeps every tested value between
+ * init and bound + step.
+ */
+bool reducer::test_in_range(const induction &iv) const {
+    if (iv.test == nullptr)
+        return true;
+    if (iv.init->kind != op::constant)
+        return false;
+    bool phi_on_left = iv.test->operands[0] == iv.phi;
+    auto opr = iv.test->opr;
+    // normalize to "i opr bound"
+    if (!phi_on_left) {
+        if (opr == token::LE) opr = token::GE;
+        else if (opr == token::LEQ) opr = token::GEQ;
+        else if (opr == token::GE) opr = token::LE;
+        else if (opr == token::GEQ) opr = token::LEQ;
+    }
+    bool upwards = opr == token::LE || opr == token::LEQ;
+    bool downwards = opr == token::GE || opr == token::GEQ;
+    if (!(upwards && iv.step > 0) && !(downwards && iv.step < 0))
+        return false;
+
+    long long bound = other_operand(iv.test, iv.phi)->value;
+    long long factor = iv.factor;
+    return fits(iv.init->value * factor) && fits(bound * factor) && fits((bound + iv.step) * factor) &&
+           fits(iv.step * factor);
+}
+
+void reducer::rewrite(induction &iv) {
+    instruction *init;
+    if (iv.init->kind == op::constant) {
+        init = fn_.create(op::constant);
+        init->value = static_cast<int>(iv.init->value * static_cast<long long>(iv.factor));
+        insert_before(loop_.preheader->terminator(), init);
+    } else {
+        auto factor = fn_.create(op::constant);
+        factor->value = iv.factor;
+        insert_before(loop_.preheader->terminator(), factor);
+        init = fn_.create(op::binary);
+        init->opr = token::MUL;
+        init->operands = { iv.init, factor };
+        insert_before(loop_.preheader->terminator(), init);
+    }
+
+    auto phi = fn_.create(op::phi);
+    phi->operands.resize(2);
+    loop_.header->insert_phi(phi);
+
+    auto step = fn_.create(op::constant);
+    step->value = iv.step * iv.factor;
+    insert_before(iv.next, step);
+    auto next = fn_.create(op::binary);
+    next->opr = token::ADD;
+    next->operands = { phi, step };
+    insert_before(iv.next, next);
+
+    phi->operands[preheader_index_] = init;
+    phi->operands[latch_index_] = next;
+
+    if (iv.test) {
+        auto bound = fn_.create(op::constant);
+        bound->value = other_operand(iv.test, iv.phi)->value * iv.factor;
+        insert_before(iv.test, bound);
+        for (auto &operand : iv.test->operands)
+            operand = operand == iv.phi ? phi : bound;
+    }
+
+    std::unordered_map<instruction *, instruction *> replacements;
+    for (auto product : iv.products)
+        replacements[product] = phi;
+    fn_.replace_values(replacements);
+    fn_.erase({ iv.phi, iv.next });
+}
+
+/*
+ * On the stack VM a multiplication costs as much as an addition, so turning
+ * one into the other only pays off when the original induction variable dies
+ * and its update disappears from the loop. Everything else is left alone.
+ */
+bool reducer::run() {
+    std::vector<instruction *> phis;
+    for (auto ins : loop_.header->instructions) {
+        if (ins->kind == op::phi)
+            phis.push_back(ins);
+    }
+    for (auto phi : phis) {
+        induction iv;
+        iv.phi = phi;
+        if (match_step(iv) && match_uses(iv) && test_in_range(iv)) {
+            rewrite(iv);
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+bool strength_reduction::run(function &fn) {
+    bool changed = false;
+    bool reduced = true;
+    while (reduced) {
+        reduced = false;
+        dominator_tree tree{fn};
+        for (auto &l : find_loops(fn, tree)) {
+            if (l.preheader == nullptr || l.latches.size() != 1 || l.header->predecessors.size() != 2)
+                continue;
+            if (reducer{fn, l}.run()) {
+                reduced = changed = true;
+                break;
+            }
+        }
+    }
+    return changed;
+}
+
+}
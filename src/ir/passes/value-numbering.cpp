@@ -0,0 +1,104 @@
+#include <map>
+#include <tuple>
+
+#include "passes.h"
+#include "../cfg.h"
+#include "../../analysis/constant-folding.h"
+
+namespace pl0::ir {
+
+namespace {
+
+typedef std::tuple<op, token, int, int, int> value_key;
+
+bool is_commutative(token opr) {
+    return opr == token::ADD || opr == token::MUL || opr == token::EQ || opr == token::NEQ;
+}
+
+void try_fold(instruction *ins) {
+    for (auto operand : ins->operands) {
+        if (operand->kind != op::constant)
+            return;
+    }
+    int result;
+    if (ins->kind == op::unary && ins->opr == token::ODD)
+        result = ins->operands[0]->value % 2;
+    else if (ins->kind != op::binary || !analysis::fold(ins->opr, ins->operands[0]->value, ins->operands[1]->value, result))
+        return;
+    ins->kind = op::constant;
+    ins->value = result;
+    ins->opr = token::UNUSED;
+    ins->operands.clear();
+}
+
+}
+
+/*
+ * Only pure computations are numbered. Loads are left alone on purpose:
+ * reusing a loaded value means keeping it in a frame slot, and on the stack
+ * VM reloading that slot costs exactly as much as the LOD it replaces.
+ */
+bool value_numbering::run(function &fn) {
+    dominator_tree tree{fn};
+    std::map<value_key, instruction *> table;
+    std::vector<value_key> scoped;
+    std::unordered_map<instruction *, instruction *> replacements;
+    bool changed = false;
+
+    struct frame {
+        basic_block *block;
+        size_t next_child;
+        size_t table_mark;
+    };
+    std::vector<frame> stack;
+    auto enter = [&](basic_block *bb) {
+        stack.push_back({ bb, 0, scoped.size() });
+        for (auto ins : bb->instructions) {
+            for (auto &operand : ins->operands) {
+                auto iter = replacements.find(operand);
+                if (iter != replacements.end())
+                    operand = iter->second;
+            }
+            if (ins->kind != op::constant && ins->kind != op::unary && ins->kind != op::binary)
+                continue;
+            if (ins->kind != op::constant) {
+                try_fold(ins);
+                changed |= ins->kind == op::constant;
+            }
+
+            int lhs = ins->operands.size() > 0 ? ins->operands[0]->id : -1;
+            int rhs = ins->operands.size() > 1 ? ins->operands[1]->id : -1;
+            if (ins->kind == op::binary && is_commutative(ins->opr) && lhs > rhs)
+                std::swap(lhs, rhs);
+            value_key key{ ins->kind, ins->opr, ins->value, lhs, rhs };
+            auto iter = table.find(key);
+            if (iter != table.end()) {
+                replacements[ins] = iter->second;
+            } else {
+                table.emplace(key, ins);
+                scoped.push_back(key);
+            }
+        }
+    };
+
+    enter(fn.entry());
+    while (!stack.empty()) {
+        auto &top = stack.back();
+        auto &children = tree.children(top.block);
+        if (top.next_child < children.size()) {
+            enter(children[top.next_child++]);
+            continue;
+        }
+        while (scoped.size() > top.table_mark) {
+            table.erase(scoped.back());
+            scoped.pop_back();
+        }
+        stack.pop_back();
+    }
+
+    // phis may refer to values of blocks visited later
+    fn.replace_values(replacements);
+    return changed || !replacements.empty();
+}
+
+}
@@ -1,31 +1,129 @@
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "parsing/parser.h"
 #include "vm.h"
+#include "memo-cache.h"
+#include "metrics.h"
+#include "snapshot.h"
+#include "statistics.h"
+#include "trace.h"
+#include "analysis/side-effects.h"
 #include "ast/ast.h"
 #include "ast/pretty-printer.h"
 #include "ast/dot-generator.h"
+#include "ast/node-counter.h"
+#include "bytecode/bytecode-file.h"
+#include "bytecode/c-generator.h"
 #include "bytecode/compiler.h"
+#include "bytecode/partial-evaluator.h"
+#include "bytecode/verifier.h"
+#include "optimizer/dead-code.h"
+#include "optimizer/inliner.h"
+#include "ir/builder.h"
+#include "ir/lowering.h"
+#include "ir/pass-manager.h"
+#include "runtime/event-loop.h"
+#include "runtime/server.h"
 #include "argparser.h"
 
 
-void print_bytecode(const pl0::bytecode &code) {
+void prepare_memo_cache(pl0::memo_cache &memo, pl0::ast::block *program, const pl0::procedure_table &procedures) {
+    pl0::analysis::call_graph graph{program};
+    pl0::analysis::side_effects effects{graph};
+    for (auto &info : procedures) {
+        if (info.symbol == nullptr || !effects.is_deterministic(info.symbol))
+            continue;
+        // A variable the callee may leave untouched is part of the key too,
+        // so a call never restores the value it had before another call.
+        auto &summary = effects.of(info.symbol);
+        pl0::memo_cache::variable_list inputs, outputs;
+        for (auto var : summary.reads)
+            inputs.emplace_back(var->get_level(), var->get_index());
+        for (auto var : summary.writes) {
+            outputs.emplace_back(var->get_level(), var->get_index());
+            auto &must = summary.must_writes;
+            if (std::find(must.begin(), must.end(), var) == must.end() &&
+                std::find(summary.reads.begin(), summary.reads.end(), var) == summary.reads.end())
+                inputs.push_back(outputs.back());
+        }
+        memo.add(info.name, info.entry, std::move(inputs), std::move(outputs));
+    }
+}
+
+void print_bytecode(const pl0::bytecode &code, const pl0::line_table &lines) {
     for (size_t i = 0; i < code.size(); i++) {
         std::cout << i << '\t' << *code[i].op << '\t'
-            << code[i].level << '\t' << code[i].address << '\n';
+            << code[i].level << '\t' << code[i].address;
+        if (int line = lines.line(static_cast<int>(i)))
+            std::cout << "\t; line " << line;
+        std::cout << '\n';
     }
 }
 
+void count_scopes(pl0::ast::block *block, uint64_t &scopes, uint64_t &symbols) {
+    scopes++;
+    symbols += block->belonging_scope()->size();
+    for (auto procedure : block->sub_procedures())
+        count_scopes(procedure->main_block(), scopes, symbols);
+}
+
 struct options {
     bool show_bytecode = false;
     bool show_tokens = false;
     bool compile_only = false;
     bool show_ast = false;
+    bool perf_counters = false;
+    bool perf_opcodes = false;
+    bool inline_procedures = false;
+    bool inline_report = false;
+    bool eliminate_dead_code = false;
+    bool dead_code_report = false;
+    bool use_ir = false;
+    bool show_ir = false;
+    bool ir_stats = false;
+    bool memoize = false;
+    bool memo_report = false;
+    bool partial_eval = false;
+    bool partial_eval_report = false;
+    bool load_bytecode = false;
+    bool event_loop = false;
+    bool verify_report = false;
+    bool time_passes = false;
+    bool metrics_procedures = false;
+    long partial_eval_budget = 10000000;
+    long fuel = pl0::machine::unlimited;
+    long trace_size = 65536;
+    std::string ir_passes = pl0::ir::pass_manager::default_pipeline;
     std::string output_graph_file = "";
+    std::string output_c_file = "";
+    std::string save_bytecode_file = "";
+    std::string daemon_socket = "";
+    std::string snapshot_file = "";
+    std::string restore_file = "";
+    std::string trace_file = "";
+    std::string decode_trace_file = "";
+    std::string stats_file = "";
+    std::string metrics_file = "";
+    std::string metrics_format = "prometheus";
     std::string input_file = "";
 };
 
+long parse_count(const std::string &value) {
+    char *end;
+    long count = std::strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || count < 0)
+        throw pl0::general_error("invalid count: ", value);
+    return count;
+}
+
 options parse_args(int argc, const char *argv[]) {
     try {
         options option;
@@ -35,12 +133,119 @@ options parse_args(int argc, const char *argv[]) {
         parser.flags({"--show-tokens", "-l"}, "Print all tokens.", &options::show_tokens);
         parser.flags({"--compile-only", "-c"}, "If specified, bytecode will not be executed.", &options::compile_only);
         parser.flags({"--show-ast", "-t"}, "Print abstract syntax tree.", &options::show_ast);
+        parser.flags({"--perf-counters"}, "Report hardware counters per procedure after execution.",
+                     &options::perf_counters);
+        parser.flags({"--perf-opcodes"}, "Also attribute hardware counters to opcodes (slow).",
+                     &options::perf_opcodes);
+        parser.flags({"--inline"}, "Inline small non-recursive procedures at their call sites.",
+                     &options::inline_procedures);
+        parser.flags({"--inline-report"}, "Inline procedures and report what was inlined.", &options::inline_report);
+        parser.flags({"--dce"}, "Remove uncalled procedures, unreachable statements and dead stores.",
+                     &options::eliminate_dead_code);
+        parser.flags({"--dce-report"}, "Remove dead code and report what was removed.", &options::dead_code_report);
+        parser.flags({"--ir"}, "Generate bytecode through the optimizing SSA intermediate representation.",
+                     &options::use_ir);
+        parser.flags({"--show-ir"}, "Print the optimized intermediate representation (implies --ir).",
+                     &options::show_ir);
+        parser.flags({"--ir-stats"}, "Report instruction counts before and after each IR pass (implies --ir).",
+                     &options::ir_stats);
+        parser.flags({"--memo"}, "Skip calls to procedures without input or output that repeat an earlier call.",
+                     &options::memoize);
+        parser.flags({"--memo-report"}, "Memoize calls and report hit rates per procedure.", &options::memo_report);
+        parser.flags({"--partial-eval"}, "Run the program up to its first read at compile time.",
+                     &options::partial_eval);
+        parser.flags({"--partial-eval-report"}, "Evaluate the program prefix and report how far it got.",
+                     &options::partial_eval_report);
+        parser.flags({"--load-bytecode"}, "Treat the input file as bytecode saved by --save-bytecode.",
+                     &options::load_bytecode);
+        parser.flags({"--event-loop"},
+                     "Run on the epoll event loop, parking the program while input or output would block.",
+                     &options::event_loop);
+        parser.flags({"--verify-report"},
+                     "Report whether the bytecode passed verification or runs on the checked interpreter.",
+                     &options::verify_report);
+        parser.flags({"--time-passes"},
+                     "Report wall time and allocations of every compiler phase and the size of what it produced.",
+                     &options::time_passes);
+        parser.store<std::initializer_list<const char *>>(
+                {"--partial-eval-budget"},
+                "Number of instructions --partial-eval may execute at most (default 10000000).",
+                &options::partial_eval_budget,
+                parse_count);
+        parser.store<std::initializer_list<const char *>>(
+                {"--fuel"},
+                "Stop the program after this many calls and backward jumps.",
+                &options::fuel,
+                parse_count);
+        parser.store<std::initializer_list<const char *>>(
+                {"--daemon"},
+                "Serve compile and run requests on this Unix domain socket instead of running a file.",
+                &options::daemon_socket);
+        parser.store<std::initializer_list<const char *>>(
+                {"--snapshot"},
+                "Run the program up to its first read (or until --fuel runs out) and save its state to a file.",
+                &options::snapshot_file);
+        parser.store<std::initializer_list<const char *>>(
+                {"--restore"},
+                "Continue the program from a state saved with --snapshot.",
+                &options::restore_file);
+        parser.store<std::initializer_list<const char *>>(
+                {"--trace"},
+                "Record the last calls, jumps and returns and write them to a file when the program ends or crashes.",
+                &options::trace_file);
+        parser.store<std::initializer_list<const char *>>(
+                {"--trace-size"},
+                "Number of control transfers --trace keeps (default 65536).",
+                &options::trace_size,
+                parse_count);
+        parser.store<std::initializer_list<const char *>>(
+                {"--decode-trace"},
+                "Print a file written by --trace instead of running a program, with source lines if the program is given.",
+                &options::decode_trace_file);
+        parser.store<std::initializer_list<const char *>>(
+                {"--stats"},
+                "Write the statistics of --time-passes to a file as JSON.",
+                &options::stats_file);
+        parser.store<std::initializer_list<const char *>>(
+                {"--metrics"},
+                "Count instructions, calls, call depth, frame memory, reads, writes and time and write them to a file "
+                "when the program ends.",
+                &options::metrics_file);
+        parser.store<std::initializer_list<const char *>>(
+                {"--metrics-format"},
+                "Format of --metrics: prometheus (default) or json.",
+                &options::metrics_format);
+        parser.flags({"--metrics-procedures"}, "Also break the --metrics calls and instructions down by procedure.",
+                     &options::metrics_procedures);
+        parser.store<std::initializer_list<const char *>>(
+                {"--save-bytecode"},
+                "Save the bytecode to a file that --load-bytecode can run later.",
+                &options::save_bytecode_file);
+        parser.store<std::initializer_list<const char *>>(
+                {"--ir-passes"},
+                "Comma-separated IR passes to run instead of the default copy-prop,gvn,licm,sr,copy-prop,dse,dce.",
+                &options::ir_passes);
         parser.store<std::initializer_list<const char *>>(
                 {"--plot-tree", "-t"},
                 "If specified, the GraphViz representation of abstract syntax tree will be output to file.",
                 &options::output_graph_file);
+        parser.store<std::initializer_list<const char *>>(
+                {"--emit-c"},
+                "Translate the program to a self-contained C source file instead of executing it.",
+                &options::output_c_file);
         parser.parse(argc, argv, option, rest);
 
+        if (!option.daemon_socket.empty())
+            return option;
+        if (!option.decode_trace_file.empty()) {
+            if (!rest.empty())
+                option.input_file = rest[0];
+            return option;
+        }
+        if (option.trace_size < 1 || option.trace_size > (1l << 30))
+            throw pl0::general_error("--trace-size must be between 1 and 2^30");
+        if (option.metrics_format != "prometheus" && option.metrics_format != "json")
+            throw pl0::general_error("unknown --metrics-format: ", option.metrics_format);
         if (rest.empty())
             parser.show_help();
 
@@ -63,51 +268,436 @@ options parse_args(int argc, const char *argv[]) {
     exit(EXIT_SUCCESS);
 }
 
-int main(int argc, const char* argv[]) {
-    options option = parse_args(argc, argv);
-
-    std::ifstream fin(option.input_file);
-    if (fin.fail()) {
-        std::cerr << "Error: failed to open file: \"" << option.input_file << "\"\n";
-        return 1;
+// Compiles the source program to bytecode. Returns false with the exit code
+// set if there is nothing left to execute.
+bool compile_source(const options &option, std::istream &in, pl0::ast::block *&program,
+                    pl0::bytecode &code, pl0::procedure_table &procedures, pl0::line_table &lines,
+                    pl0::compile_statistics &stats, int &exit_code) {
+    // the parser pulls tokens as it needs them, so lexing is measured on its
+    // own first and is part of the parse phase as well
+    std::istringstream source;
+    if (stats.enabled()) {
+        {
+            pl0::phase_timer timer{stats, "read"};
+            source.str(std::string{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()});
+        }
+        uint64_t tokens = 0;
+        {
+            pl0::phase_timer timer{stats, "lex", "parse"};
+            pl0::lexer lex(source);
+            for (; !lex.peek(pl0::token::EOS) && !lex.peek(pl0::token::ILLEGAL); lex.advance())
+                tokens++;
+        }
+        stats.count("tokens", tokens);
+        source.clear();
+        source.seekg(0);
     }
-
-    pl0::lexer lex(fin);
+    pl0::lexer lex(stats.enabled() ? source : in);
 
     if (option.show_tokens)
         print_tokens(lex);
 
     pl0::parser parser(lex);
-    pl0::ast::block *program = nullptr;
 
     try {
+        pl0::phase_timer timer{stats, "parse"};
         program = parser.program();
     } catch (pl0::general_error &error) {
         pl0::location loc = lex.loc();
         std::cout << "Error(" << loc.to_string() << "): " << error.what() << '\n';
-        return EXIT_FAILURE;
+        exit_code = EXIT_FAILURE;
+        return false;
+    }
+    if (stats.enabled()) {
+        uint64_t scopes = 0, symbols = 0;
+        count_scopes(program, scopes, symbols);
+        stats.count("ast_nodes", pl0::ast::node_counter{}.count(program));
+        stats.count("scopes", scopes);
+        stats.count("symbols", symbols);
+    }
+
+
+    if (option.inline_procedures || option.inline_report) {
+        pl0::phase_timer timer{stats, "inline"};
+        pl0::optimizer::inliner inliner;
+        inliner.run(program);
+        if (option.inline_report)
+            inliner.report(std::cerr);
+    }
+
+    if (option.eliminate_dead_code || option.dead_code_report) {
+        pl0::phase_timer timer{stats, "dce"};
+        pl0::optimizer::dead_code_eliminator eliminator;
+        eliminator.run(program);
+        if (option.dead_code_report)
+            eliminator.report(std::cerr);
     }
 
+    if (!option.output_c_file.empty()) {
+        pl0::phase_timer timer{stats, "emit-c"};
+        pl0::code::c_generator generator;
+        try {
+            generator.generate(program);
+        } catch (pl0::general_error &error) {
+            std::cout << "Error: " << error.what() << '\n';
+            exit_code = EXIT_FAILURE;
+            return false;
+        }
+        std::ofstream out(option.output_c_file);
+        if (out.fail()) {
+            std::cerr << "Error: failed to open file: \"" << option.output_c_file << "\"\n";
+            exit_code = EXIT_FAILURE;
+            return false;
+        }
+        generator.write(out);
+        exit_code = EXIT_SUCCESS;
+        return false;
+    }
 
     pl0::code::compiler compiler{};
-    compiler.generate(program);
+    pl0::ir::lowering lowering{};
+    bool use_ir = option.use_ir || option.show_ir || option.ir_stats;
+    if (use_ir) {
+        pl0::ir::module module;
+        pl0::ir::pass_manager passes;
+        try {
+            passes.add_pipeline(option.ir_passes);
+        } catch (pl0::general_error &error) {
+            std::cout << "Error: " << error.what() << '\n';
+            exit_code = EXIT_FAILURE;
+            return false;
+        }
+        {
+            pl0::phase_timer timer{stats, "ir-build"};
+            pl0::ir::builder{module}.build(program);
+        }
+        if (stats.enabled())
+            stats.count("ir_instructions", module.instruction_count());
+        {
+            pl0::phase_timer timer{stats, "ir-passes"};
+            passes.run(module);
+        }
+        if (stats.enabled())
+            stats.count("ir_optimized", module.instruction_count());
+        if (option.show_ir)
+            module.print(std::cout);
+        {
+            pl0::phase_timer timer{stats, "ir-lowering"};
+            lowering.generate(module);
+        }
+        if (option.ir_stats) {
+            compiler.generate(program);
+            passes.report(std::cerr);
+            std::cerr << "bytecode: " << lowering.code().size() << " instructions, "
+                      << compiler.code().size() << " without the IR\n";
+        }
+    } else {
+        pl0::phase_timer timer{stats, "compile"};
+        compiler.generate(program);
+    }
+    code = use_ir ? lowering.code() : compiler.code();
+    procedures = use_ir ? lowering.procedures() : compiler.procedures();
+    lines = use_ir ? lowering.lines() : compiler.lines();
 
     if (!option.output_graph_file.empty()) {
+        pl0::phase_timer timer{stats, "dot"};
         pl0::ast::dot_generator plotter;
         plotter.generate(program);
         plotter.save_to_file(option.output_graph_file.c_str());
     }
 
     if (option.show_ast) {
+        pl0::phase_timer timer{stats, "print-ast"};
         pl0::ast::ast_printer printer{std::cout};
-        printer.visit_block(program);
+        printer.print(program);
+    }
+    return true;
+}
+
+// returns false if the JSON file cannot be written
+bool report_statistics(const options &option, const pl0::compile_statistics &stats) {
+    if (option.time_passes)
+        stats.report(std::cerr);
+    if (!option.stats_file.empty()) {
+        std::ofstream out(option.stats_file);
+        if (out.fail()) {
+            std::cerr << "Error: failed to open file: \"" << option.stats_file << "\"\n";
+            return false;
+        }
+        stats.report_json(out);
+    }
+    return true;
+}
+
+int main(int argc, const char* argv[]) {
+    options option = parse_args(argc, argv);
+
+    if (!option.daemon_socket.empty()) {
+        try {
+            pl0::runtime::server{option.fuel}.serve(option.daemon_socket);
+        } catch (pl0::general_error &error) {
+            std::cerr << "Error: " << error.what() << '\n';
+        }
+        return EXIT_FAILURE;
+    }
+
+    if (!option.decode_trace_file.empty()) {
+        std::ifstream in(option.decode_trace_file, std::ios::binary);
+        if (in.fail()) {
+            std::cerr << "Error: failed to open file: \"" << option.decode_trace_file << "\"\n";
+            return EXIT_FAILURE;
+        }
+        // the program has to be compiled with the options it was traced with
+        pl0::line_table lines;
+        if (!option.input_file.empty()) {
+            std::ifstream source(option.input_file);
+            if (source.fail()) {
+                std::cerr << "Error: failed to open file: \"" << option.input_file << "\"\n";
+                return EXIT_FAILURE;
+            }
+            pl0::ast::block *program = nullptr;
+            pl0::bytecode code;
+            pl0::procedure_table procedures;
+            pl0::compile_statistics stats{false};
+            int exit_code;
+            if (!compile_source(option, source, program, code, procedures, lines, stats, exit_code))
+                return exit_code;
+        }
+        try {
+            pl0::decode_trace(in, std::cout, option.input_file.empty() ? nullptr : &lines);
+        } catch (pl0::general_error &error) {
+            std::cout.flush();
+            std::cerr << "Error: " << error.what() << '\n';
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    std::ifstream fin(option.input_file);
+    if (fin.fail()) {
+        std::cerr << "Error: failed to open file: \"" << option.input_file << "\"\n";
+        return 1;
+    }
+
+    pl0::ast::block *program = nullptr;
+    pl0::bytecode code;
+    pl0::procedure_table procedures;
+    pl0::line_table lines;
+    pl0::compile_statistics stats{option.time_passes || !option.stats_file.empty()};
+    if (option.load_bytecode) {
+        if (option.memoize || option.memo_report || !option.output_c_file.empty()) {
+            std::cout << "Error: --memo and --emit-c need the source program, not saved bytecode\n";
+            return EXIT_FAILURE;
+        }
+        try {
+            pl0::phase_timer timer{stats, "load"};
+            pl0::load_bytecode(fin, code, procedures, lines);
+        } catch (pl0::general_error &error) {
+            std::cout << "Error: " << error.what() << '\n';
+            return EXIT_FAILURE;
+        }
+    } else {
+        int exit_code;
+        if (!compile_source(option, fin, program, code, procedures, lines, stats, exit_code)) {
+            if (exit_code == EXIT_SUCCESS && !report_statistics(option, stats))
+                return EXIT_FAILURE;
+            return exit_code;
+        }
+    }
+
+    if (option.partial_eval || option.partial_eval_report) {
+        pl0::code::partial_evaluator evaluator{option.partial_eval_budget};
+        {
+            pl0::phase_timer timer{stats, "partial-eval"};
+            evaluator.run(code);
+        }
+        if (option.partial_eval_report)
+            evaluator.report(std::cerr);
+        code = evaluator.code();
+        // a residual program keeps the addresses of the code it resumes, and
+        // its prologue has no source line
+        if (evaluator.finished())
+            lines = pl0::line_table{ };
+        while (lines.size() < static_cast<int>(code.size()))
+            lines.append(0);
     }
 
     if (option.show_bytecode)
-        print_bytecode(compiler.code());
+        print_bytecode(code, lines);
+
+    if (option.verify_report) {
+        pl0::code::verifier verifier;
+        if (verifier.verify(code))
+            std::cerr << "bytecode verified, running without checks\n";
+        else
+            std::cerr << "bytecode not verified (" << verifier.error() << "), running with checks\n";
+    }
+
+    if (!option.save_bytecode_file.empty()) {
+        std::ofstream out(option.save_bytecode_file);
+        if (out.fail()) {
+            std::cerr << "Error: failed to open file: \"" << option.save_bytecode_file << "\"\n";
+            return EXIT_FAILURE;
+        }
+        pl0::save_bytecode(out, code, procedures, lines);
+    }
 
-    if (!option.compile_only)
-        pl0::execute(compiler.code());
+    if (stats.enabled()) {
+        stats.count("procedures", procedures.size());
+        stats.count("instructions", code.size());
+        stats.count("line_runs", lines.runs().size());
+        if (!report_statistics(option, stats))
+            return EXIT_FAILURE;
+    }
 
+    std::unique_ptr<pl0::trace_buffer> trace;
+    int trace_fd = -1;
+    if (!option.compile_only && !option.trace_file.empty()) {
+        if (option.event_loop || !option.snapshot_file.empty()) {
+            std::cout << "Error: --trace cannot be combined with --event-loop or --snapshot\n";
+            return EXIT_FAILURE;
+        }
+        // opened now, so that a signal handler only has to write
+        trace_fd = open(option.trace_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (trace_fd < 0) {
+            std::cerr << "Error: failed to open file: \"" << option.trace_file << "\"\n";
+            return EXIT_FAILURE;
+        }
+        trace = std::make_unique<pl0::trace_buffer>(static_cast<uint32_t>(option.trace_size));
+        pl0::dump_trace_on_signals(*trace, trace_fd);
+    }
+    std::unique_ptr<pl0::run_metrics> metrics;
+    if (!option.compile_only && !option.metrics_file.empty()) {
+        if (option.event_loop || !option.snapshot_file.empty() || !option.restore_file.empty()) {
+            std::cout << "Error: --metrics cannot be combined with --event-loop, --snapshot or --restore\n";
+            return EXIT_FAILURE;
+        }
+        metrics = std::make_unique<pl0::run_metrics>(procedures, option.metrics_procedures);
+    }
+    // written however the program ends
+    auto save_metrics = [&]() {
+        if (!metrics)
+            return true;
+        std::ofstream out(option.metrics_file);
+        if (out.fail()) {
+            std::cerr << "Error: failed to open file: \"" << option.metrics_file << "\"\n";
+            return false;
+        }
+        if (option.metrics_format == "json")
+            metrics->write_json(out);
+        else
+            metrics->write_prometheus(out);
+        return true;
+    };
+    auto fail = [&](const std::string &message, int program_counter) {
+        std::cout.flush();
+        std::cerr << "Error: " << message;
+        if (int line = lines.line(program_counter))
+            std::cerr << " at line " << line;
+        std::cerr << '\n';
+        if (trace)
+            pl0::dump_trace_once(*trace, trace_fd, pl0::trace_buffer::dump_reason::error);
+        save_metrics();
+        return EXIT_FAILURE;
+    };
+
+    if (!option.compile_only && !option.snapshot_file.empty()) {
+        pl0::output_recorder recorder;
+        pl0::machine machine{code, nullptr, nullptr, &recorder};
+        try {
+            machine.run(option.fuel);
+        } catch (pl0::general_error &error) {
+            return fail(error.what(), machine.program_counter() - 1);
+        }
+        std::ofstream out(option.snapshot_file, std::ios::binary);
+        if (out.fail()) {
+            std::cerr << "Error: failed to open file: \"" << option.snapshot_file << "\"\n";
+            return EXIT_FAILURE;
+        }
+        pl0::save_snapshot(out, code, {machine.capture(), recorder.output()});
+    } else if (!option.compile_only && !option.restore_file.empty()) {
+        if (option.memoize || option.memo_report || option.perf_counters || option.perf_opcodes) {
+            std::cout << "Error: --restore cannot be combined with --memo or --perf-counters\n";
+            return EXIT_FAILURE;
+        }
+        std::ifstream in(option.restore_file, std::ios::binary);
+        if (in.fail()) {
+            std::cerr << "Error: failed to open file: \"" << option.restore_file << "\"\n";
+            return EXIT_FAILURE;
+        }
+        pl0::machine machine{code};
+        machine.set_trace(trace.get());
+        try {
+            auto image = pl0::load_snapshot(in, code);
+            machine.resume(image.state);
+            for (int value : image.output)
+                std::cout << value << '\n';
+        } catch (pl0::general_error &error) {
+            std::cout << "Error: " << error.what() << '\n';
+            return EXIT_FAILURE;
+        }
+        try {
+            if (machine.run(option.fuel) == pl0::machine::status::suspended)
+                return fail("the program ran out of fuel", machine.program_counter());
+        } catch (pl0::general_error &error) {
+            return fail(error.what(), machine.program_counter() - 1);
+        }
+    } else if (!option.compile_only && option.event_loop) {
+        // the descriptors are shared with whoever started us, so leave them as they were
+        int input_flags = fcntl(STDIN_FILENO, F_GETFL), output_flags = fcntl(STDOUT_FILENO, F_GETFL);
+        std::cout.flush();
+        std::string program_error;
+        int error_address = -1;
+        try {
+            pl0::runtime::event_loop loop;
+            loop.spawn(code, STDIN_FILENO, STDOUT_FILENO,
+                       [&](int, int, const std::string &error, int program_counter) {
+                           program_error = error;
+                           error_address = program_counter;
+                       });
+            loop.run();
+        } catch (pl0::general_error &error) {
+            std::cerr << "Error: " << error.what() << '\n';
+            return EXIT_FAILURE;
+        }
+        fcntl(STDIN_FILENO, F_SETFL, input_flags);
+        fcntl(STDOUT_FILENO, F_SETFL, output_flags);
+        if (!program_error.empty())
+            return fail(program_error, error_address);
+    } else if (!option.compile_only) {
+        std::unique_ptr<pl0::memo_cache> memo;
+        if (option.memoize || option.memo_report) {
+            memo = std::make_unique<pl0::memo_cache>();
+            prepare_memo_cache(*memo, program, procedures);
+        }
+        std::unique_ptr<pl0::procedure_profiler> profiler;
+        if (option.perf_counters || option.perf_opcodes) {
+            profiler = std::make_unique<pl0::procedure_profiler>(procedures, option.perf_opcodes);
+            if (!lines.empty())
+                profiler->set_lines(&lines);
+        }
+        pl0::machine machine{code, profiler.get(), memo.get()};
+        machine.set_trace(trace.get());
+        machine.set_metrics(metrics.get());
+        pl0::machine::status status;
+        try {
+            status = machine.run(option.fuel);
+        } catch (pl0::general_error &error) {
+            return fail(error.what(), machine.program_counter() - 1);
+        }
+        if (profiler)
+            profiler->report(std::cerr);
+        if (option.memo_report)
+            memo->report(std::cerr);
+        if (status == pl0::machine::status::suspended)
+            return fail("the program ran out of fuel", machine.program_counter());
+        if (!save_metrics())
+            return EXIT_FAILURE;
+    }
+
+    if (trace) {
+        std::cout.flush();
+        pl0::dump_trace_once(*trace, trace_fd, pl0::trace_buffer::dump_reason::exit);
+    }
     return EXIT_SUCCESS;
 }
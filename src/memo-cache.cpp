@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <iomanip>
+
+#include "memo-cache.h"
+
+namespace pl0 {
+
+void memo_cache::add(const std::string &name, int entry, variable_list inputs, variable_list outputs) {
+    auto &record = records_[entry];
+    record.name = name;
+    record.inputs = std::move(inputs);
+    record.outputs = std::move(outputs);
+}
+
+bool memo_cache::lookup(int entry, const display &frames) {
+    missed_.record = nullptr;
+    auto iter = records_.find(entry);
+    if (iter == records_.end())
+        return false;
+
+    auto &record = iter->second;
+    if (record.disabled)
+        return false;
+    record.calls++;
+    if (record.calls == trial_calls && record.hits * 16 < record.calls) {
+        record.disabled = true;
+        record.results.clear();
+        return false;
+    }
+    missed_.key.clear();
+    for (auto &input : record.inputs)
+        missed_.key.push_back(frames[input.first]->local(input.second));
+
+    auto result = record.results.find(missed_.key);
+    if (result != record.results.end()) {
+        record.hits++;
+        for (size_t i = 0; i < record.outputs.size(); i++)
+            frames[record.outputs[i].first]->local(record.outputs[i].second) = result->second[i];
+        return true;
+    }
+
+    // the frames holding the outputs stay put until the callee returns
+    missed_.record = &record;
+    missed_.outputs.clear();
+    for (auto &output : record.outputs)
+        missed_.outputs.push_back(&frames[output.first]->local(output.second));
+    return false;
+}
+
+void memo_cache::enter(stack_frame *frame) {
+    if (missed_.record == nullptr)
+        return;
+    missed_.frame = frame;
+    pending_.push_back(std::move(missed_));
+    missed_ = pending_call{ };
+}
+
+void memo_cache::leave(stack_frame *frame) {
+    // a frame reused by tail calls may have several calls waiting for it
+    while (!pending_.empty() && pending_.back().frame == frame) {
+        auto &call = pending_.back();
+        if (call.record->results.size() < capacity_) {
+            std::vector<int> values;
+            for (auto output : call.outputs)
+                values.push_back(*output);
+            call.record->results.emplace(std::move(call.key), std::move(values));
+        }
+        pending_.pop_back();
+    }
+}
+
+void memo_cache::report(std::ostream &out) const {
+    std::vector<const procedure_record *> order;
+    for (auto &kv : records_)
+        order.push_back(&kv.second);
+    std::sort(order.begin(), order.end(), [](const procedure_record *a, const procedure_record *b) {
+        return a->calls != b->calls ? a->calls > b->calls : a->name < b->name;
+    });
+
+    out << std::left << std::setw(24) << "memoized procedure" << std::right << std::setw(12) << "calls"
+        << std::setw(12) << "hits" << std::setw(12) << "hit rate" << std::setw(12) << "results" << '\n';
+    for (auto record : order) {
+        out << std::left << std::setw(24) << record->name << std::right << std::setw(12) << record->calls
+            << std::setw(12) << record->hits << std::setw(11) << std::fixed << std::setprecision(1)
+            << (record->calls ? 100.0 * record->hits / record->calls : 0.0) << '%'
+            << std::setw(12) << record->results.size() << (record->disabled ? "  (gave up, calls rarely repeat)" : "")
+            << '\n';
+    }
+    if (order.empty())
+        out << "no procedure can be memoized\n";
+}
+
+}
@@ -0,0 +1,88 @@
+#ifndef PL0_MEMO_CACHE_H
+#define PL0_MEMO_CACHE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "vm.h"
+
+namespace pl0 {
+
+/**
+ * Remembers the effect of calls to deterministic procedures. A call is
+ * keyed by the values of every variable outside the callee's frame that it
+ * may read or write; when the same key comes up again, the VM stores the
+ * recorded results into the variables the callee may write and skips the
+ * call. Variables are given as (level, slot) pairs, which address the
+ * frames of the callee's static chain through the display. A procedure
+ * whose first thousands of calls almost never repeat is no longer cached,
+ * so the cache costs little where it does not help.
+ */
+class memo_cache {
+public:
+    typedef std::vector<std::pair<int, int>> variable_list;
+private:
+    struct key_hash {
+        size_t operator()(const std::vector<int> &key) const {
+            uint64_t hash = 14695981039346656037ull;
+            for (int value : key)
+                hash = (hash ^ static_cast<uint32_t>(value)) * 1099511628211ull;
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    struct procedure_record {
+        std::string name;
+        variable_list inputs;
+        variable_list outputs;
+        std::unordered_map<std::vector<int>, std::vector<int>, key_hash> results;
+        uint64_t calls = 0;
+        uint64_t hits = 0;
+        // stopped caching because the calls rarely repeat
+        bool disabled = false;
+    };
+
+    // a call that missed, waiting for the callee to return
+    struct pending_call {
+        stack_frame *frame;
+        procedure_record *record;
+        std::vector<int> key;
+        std::vector<int *> outputs;
+    };
+
+    // calls after which a procedure hitting less than one in 16 times is given up on
+    static constexpr uint64_t trial_calls = 4096;
+
+    std::unordered_map<int, procedure_record> records_;
+    std::vector<pending_call> pending_;
+    pending_call missed_;
+    size_t capacity_;
+public:
+    // at most `capacity` results are remembered per procedure
+    explicit memo_cache(size_t capacity = 1 << 16) : missed_{ }, capacity_(capacity) { }
+
+    void add(const std::string &name, int entry, variable_list inputs, variable_list outputs);
+
+    /**
+     * Called before a call to `entry`. Returns true if the result of an
+     * identical call was applied and the call can be skipped. Otherwise the
+     * next enter() starts recording the call.
+     */
+    bool lookup(int entry, const display &frames);
+
+    // the callee of the last missed lookup now runs in `frame`
+    void enter(stack_frame *frame);
+
+    // `frame` is about to return, record the results of calls that missed in it
+    void leave(stack_frame *frame);
+
+    void report(std::ostream &out) const;
+};
+
+}
+
+#endif //PL0_MEMO_CACHE_H
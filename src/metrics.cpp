@@ -0,0 +1,114 @@
+#include <string>
+
+#include "metrics.h"
+#include "util.h"
+
+namespace pl0 {
+
+run_metrics::run_metrics(const procedure_table &procedures, bool per_procedure)
+        : procedures_(procedures), per_procedure_(per_procedure) {
+    if (!per_procedure_)
+        return;
+    for (size_t i = 0; i < procedures.size(); i++)
+        entry_to_index_[procedures[i].entry] = static_cast<int>(i);
+    records_.resize(procedures.size());
+}
+
+void run_metrics::start(uint64_t frame_bytes) {
+    if (max_depth_ < 1)
+        max_depth_ = 1;
+    allocate(frame_bytes);
+    if (per_procedure_)
+        enter_procedure(0);
+}
+
+void run_metrics::enter_procedure(int entry) {
+    if (!call_stack_.empty())
+        records_[call_stack_.back()].instructions += instructions_ - attributed_;
+    attributed_ = instructions_;
+    auto iter = entry_to_index_.find(entry);
+    if (iter == entry_to_index_.end()) {
+        iter = entry_to_index_.emplace(entry, static_cast<int>(records_.size())).first;
+        records_.emplace_back();
+    }
+    call_stack_.push_back(iter->second);
+    records_[iter->second].calls++;
+}
+
+void run_metrics::leave_procedure() {
+    if (call_stack_.empty())
+        return;
+    records_[call_stack_.back()].instructions += instructions_ - attributed_;
+    attributed_ = instructions_;
+    call_stack_.pop_back();
+}
+
+uint64_t run_metrics::self_instructions(size_t index) const {
+    auto count = records_[index].instructions;
+    // the running procedure has not been charged since its last call or return
+    if (!call_stack_.empty() && call_stack_.back() == static_cast<int>(index))
+        count += instructions_ - attributed_;
+    return count;
+}
+
+void run_metrics::write_prometheus(std::ostream &out) const {
+    auto metric = [&out](const char *name, const char *type, const char *help, auto value) {
+        out << "# HELP " << name << ' ' << help << '\n'
+            << "# TYPE " << name << ' ' << type << '\n'
+            << name << ' ' << value << '\n';
+    };
+    metric("pl0_instructions_total", "counter", "Instructions executed.", instructions_);
+    metric("pl0_calls_total", "counter", "Procedure calls, including tail calls.", calls_);
+    metric("pl0_max_call_depth", "gauge", "Most frames on the call stack at once.", max_depth_);
+    metric("pl0_peak_frame_bytes", "gauge", "Most memory held by the frames on the call stack at once.",
+           peak_frame_bytes_);
+    metric("pl0_reads_total", "counter", "Values read.", reads_);
+    metric("pl0_writes_total", "counter", "Values written.", writes_);
+    metric("pl0_run_seconds", "gauge", "Wall time spent in the interpreter.", seconds_);
+    if (!per_procedure_)
+        return;
+
+    auto label = [this](size_t index) {
+        auto name = index < procedures_.size() ? procedures_[index].name : std::string{ "<unknown>" };
+        return "{procedure=" + quoted(name) + '}';
+    };
+    out << "# HELP pl0_procedure_calls_total Calls per procedure.\n"
+        << "# TYPE pl0_procedure_calls_total counter\n";
+    for (size_t i = 0; i < records_.size(); i++) {
+        if (records_[i].calls > 0)
+            out << "pl0_procedure_calls_total" << label(i) << ' ' << records_[i].calls << '\n';
+    }
+    out << "# HELP pl0_procedure_instructions_total Instructions executed in the procedure itself.\n"
+        << "# TYPE pl0_procedure_instructions_total counter\n";
+    for (size_t i = 0; i < records_.size(); i++) {
+        if (records_[i].calls > 0)
+            out << "pl0_procedure_instructions_total" << label(i) << ' ' << self_instructions(i) << '\n';
+    }
+}
+
+void run_metrics::write_json(std::ostream &out) const {
+    out << "{\n";
+    out << "  \"instructions\": " << instructions_ << ",\n";
+    out << "  \"calls\": " << calls_ << ",\n";
+    out << "  \"max_call_depth\": " << max_depth_ << ",\n";
+    out << "  \"peak_frame_bytes\": " << peak_frame_bytes_ << ",\n";
+    out << "  \"reads\": " << reads_ << ",\n";
+    out << "  \"writes\": " << writes_ << ",\n";
+    out << "  \"wall_ns\": " << static_cast<long long>(seconds_ * 1e9);
+    if (per_procedure_) {
+        out << ",\n  \"procedures\": [";
+        bool first = true;
+        for (size_t i = 0; i < records_.size(); i++) {
+            if (records_[i].calls == 0)
+                continue;
+            auto name = i < procedures_.size() ? procedures_[i].name : std::string{ "<unknown>" };
+            out << (first ? "\n" : ",\n") << "    { \"name\": " << quoted(name)
+                << ", \"calls\": " << records_[i].calls << ", \"instructions\": " << self_instructions(i) << " }";
+            first = false;
+        }
+        out << "\n  ]";
+    }
+    out << "\n}\n";
+}
+
+}
@@ -0,0 +1,111 @@
+#ifndef PL0_METRICS_H
+#define PL0_METRICS_H
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "bytecode/bytecode.h"
+
+namespace pl0 {
+
+/**
+ * Counters of one program run for capacity planning: instructions, calls,
+ * the deepest call chain, the most memory its frames held at once, reads,
+ * writes and the wall time spent in the interpreter. A machine only updates
+ * them on the loop compiled with the metrics feature, so a run without
+ * metrics pays nothing.
+ *
+ * With the per-procedure breakdown, calls and the instructions executed in
+ * a procedure itself (not in its callees) are counted per procedure as well.
+ */
+class run_metrics {
+    struct procedure_record {
+        uint64_t calls = 0;
+        uint64_t instructions = 0;
+    };
+
+    const procedure_table &procedures_;
+    bool per_procedure_;
+
+    uint64_t instructions_ = 0;
+    uint64_t calls_ = 0;
+    uint64_t reads_ = 0;
+    uint64_t writes_ = 0;
+    int max_depth_ = 0;
+    uint64_t frame_bytes_ = 0;
+    uint64_t peak_frame_bytes_ = 0;
+    double seconds_ = 0;
+
+    std::unordered_map<int, int> entry_to_index_;
+    std::vector<procedure_record> records_;
+    std::vector<int> call_stack_;
+    // instructions already charged to a procedure
+    uint64_t attributed_ = 0;
+
+    void enter_procedure(int entry);
+    void leave_procedure();
+    uint64_t self_instructions(size_t index) const;
+public:
+    run_metrics(const procedure_table &procedures, bool per_procedure);
+
+    // the main program starts with a frame of the given size at depth 1
+    void start(uint64_t frame_bytes);
+
+    void step() {
+        instructions_++;
+    }
+
+    void call(int entry, int depth, uint64_t frame_bytes) {
+        calls_++;
+        if (depth > max_depth_)
+            max_depth_ = depth;
+        allocate(frame_bytes);
+        if (per_procedure_)
+            enter_procedure(entry);
+    }
+
+    // a tail call frees the locals of the caller and keeps its frame
+    void tail_call(int entry, uint64_t released_bytes) {
+        calls_++;
+        frame_bytes_ -= released_bytes;
+        if (per_procedure_) {
+            leave_procedure();
+            enter_procedure(entry);
+        }
+    }
+
+    void leave(uint64_t frame_bytes) {
+        frame_bytes_ -= frame_bytes;
+        if (per_procedure_)
+            leave_procedure();
+    }
+
+    void allocate(uint64_t bytes) {
+        frame_bytes_ += bytes;
+        if (frame_bytes_ > peak_frame_bytes_)
+            peak_frame_bytes_ = frame_bytes_;
+    }
+
+    void read() {
+        reads_++;
+    }
+
+    void write() {
+        writes_++;
+    }
+
+    void add_time(double seconds) {
+        seconds_ += seconds;
+    }
+
+    // the Prometheus text exposition format
+    void write_prometheus(std::ostream &out) const;
+
+    void write_json(std::ostream &out) const;
+};
+
+}
+
+#endif //PL0_METRICS_H
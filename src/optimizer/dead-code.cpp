@@ -0,0 +1,360 @@
+#include "dead-code.h"
+#include "../analysis/call-graph.h"
+#include "../analysis/constant-folding.h"
+
+namespace pl0::optimizer {
+
+namespace {
+
+// evaluates an expression made of literals and constants only
+bool constant_value(ast::expression *expr, int &value) {
+    switch (expr->get_type()) {
+    case ast::ast_node_type::literal:
+        value = static_cast<ast::literal *>(expr)->value();
+        return true;
+    case ast::ast_node_type::variable_proxy: {
+        auto target = static_cast<ast::variable_proxy *>(expr)->target();
+        if (!target->is_constant())
+            return false;
+        value = static_cast<constant *>(target)->get_value();
+        return true;
+    }
+    case ast::ast_node_type::unary_operation: {
+        auto node = static_cast<ast::unary_operation *>(expr);
+        if (node->op() != token::ODD || !constant_value(node->expr(), value))
+            return false;
+        value %= 2;
+        return true;
+    }
+    case ast::ast_node_type::binary_operation: {
+        auto node = static_cast<ast::binary_operation *>(expr);
+        int lhs, rhs;
+        if (!constant_value(node->left(), lhs) || !constant_value(node->right(), rhs))
+            return false;
+        return analysis::fold(node->op(), lhs, rhs, value);
+    }
+    default:
+        return false;
+    }
+}
+
+// true if evaluating the expression may stop the program with a division error
+bool may_trap(ast::expression *expr) {
+    switch (expr->get_type()) {
+    case ast::ast_node_type::unary_operation:
+        return may_trap(static_cast<ast::unary_operation *>(expr)->expr());
+    case ast::ast_node_type::binary_operation: {
+        auto node = static_cast<ast::binary_operation *>(expr);
+        int divisor;
+        if (node->op() == token::DIV &&
+            (!constant_value(node->right(), divisor) || divisor == 0 || divisor == -1))
+            return true;
+        return may_trap(node->left()) || may_trap(node->right());
+    }
+    default:
+        return false;
+    }
+}
+
+// true if control never continues after the statement
+bool terminates(ast::statement *stmt) {
+    switch (stmt->get_type()) {
+    case ast::ast_node_type::return_statement:
+        return true;
+    case ast::ast_node_type::statement_list: {
+        auto &statements = static_cast<ast::statement_list *>(stmt)->statements();
+        return !statements.empty() && terminates(statements.back());
+    }
+    case ast::ast_node_type::if_statement: {
+        auto node = static_cast<ast::if_statement *>(stmt);
+        return node->has_else_statement() && terminates(node->then_statement()) &&
+               terminates(node->else_statement());
+    }
+    default:
+        return false;
+    }
+}
+
+/**
+ * Collects every symbol read by an expression anywhere in the program,
+ * including the bodies of nested procedures.
+ */
+class read_scanner : public ast::ast_visitor<read_scanner> {
+    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+
+    std::unordered_set<symbol *> &reads_;
+
+    DECLARE_VISIT_METHODS
+public:
+    explicit read_scanner(std::unordered_set<symbol *> &reads) : reads_(reads) { }
+
+    void scan(ast::block *program) { visit_block(program); }
+
+    void scan(ast::expression *expr) { visit(expr); }
+};
+
+void read_scanner::visit_variable_declaration(ast::variable_declaration *node) { }
+
+void read_scanner::visit_constant_declaration(ast::constant_declaration *node) { }
+
+void read_scanner::visit_procedure_declaration(ast::procedure_declaration *node) {
+    visit_block(node->main_block());
+}
+
+void read_scanner::visit_block(ast::block *node) {
+    for (auto method : node->sub_procedures())
+        visit_procedure_declaration(method);
+    visit(node->body());
+}
+
+void read_scanner::visit_unary_operation(ast::unary_operation *node) {
+    visit(node->expr());
+}
+
+void read_scanner::visit_binary_operation(ast::binary_operation *node) {
+    visit(node->left());
+    visit(node->right());
+}
+
+void read_scanner::visit_literal(ast::literal *node) { }
+
+void read_scanner::visit_variable_proxy(ast::variable_proxy *node) {
+    reads_.insert(node->target());
+}
+
+void read_scanner::visit_statement_list(ast::statement_list *node) {
+    for (auto stmt : node->statements())
+        visit(stmt);
+}
+
+void read_scanner::visit_if_statement(ast::if_statement *node) {
+    visit(node->condition());
+    visit(node->then_statement());
+    if (node->has_else_statement())
+        visit(node->else_statement());
+}
+
+void read_scanner::visit_while_statement(ast::while_statement *node) {
+    visit(node->cond());
+    visit(node->body());
+}
+
+void read_scanner::visit_call_statement(ast::call_statement *node) { }
+
+void read_scanner::visit_read_statement(ast::read_statement *node) { }
+
+void read_scanner::visit_write_statement(ast::write_statement *node) {
+    for (auto expr : node->expressions())
+        visit(expr);
+}
+
+void read_scanner::visit_assign_statement(ast::assign_statement *node) {
+    visit(node->expr());
+}
+
+void read_scanner::visit_return_statement(ast::return_statement *node) { }
+
+bool reads(ast::expression *expr, symbol *target) {
+    std::unordered_set<symbol *> symbols;
+    read_scanner{symbols}.scan(expr);
+    return symbols.count(target) > 0;
+}
+
+ast::statement *empty_statement() {
+    return new ast::statement_list({ });
+}
+
+}
+
+/**
+ * Rewrites a statement tree in place. A null result means the statement
+ * was removed altogether.
+ */
+class dead_code_eliminator::rewriter : public ast::ast_visitor<rewriter> {
+    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+
+    dead_code_eliminator &eliminator_;
+    ast::statement *result_;
+
+    DECLARE_VISIT_METHODS
+
+    ast::statement *rewrite(ast::statement *node) {
+        result_ = node;
+        visit(node);
+        return result_;
+    }
+
+    void remove(ast::statement *node, int &counter) {
+        counter++;
+        delete node;
+        result_ = nullptr;
+    }
+public:
+    bool changed = false;
+
+    explicit rewriter(dead_code_eliminator &eliminator) : eliminator_(eliminator), result_(nullptr) { }
+
+    void run(ast::block *block) {
+        auto body = rewrite(block->body());
+        block->set_body(body ? body : empty_statement());
+    }
+};
+
+void dead_code_eliminator::rewriter::visit_variable_declaration(ast::variable_declaration *node) { }
+
+void dead_code_eliminator::rewriter::visit_constant_declaration(ast::constant_declaration *node) { }
+
+void dead_code_eliminator::rewriter::visit_procedure_declaration(ast::procedure_declaration *node) { }
+
+void dead_code_eliminator::rewriter::visit_block(ast::block *node) { }
+
+void dead_code_eliminator::rewriter::visit_unary_operation(ast::unary_operation *node) { }
+
+void dead_code_eliminator::rewriter::visit_binary_operation(ast::binary_operation *node) { }
+
+void dead_code_eliminator::rewriter::visit_literal(ast::literal *node) { }
+
+void dead_code_eliminator::rewriter::visit_variable_proxy(ast::variable_proxy *node) { }
+
+void dead_code_eliminator::rewriter::visit_statement_list(ast::statement_list *node) {
+    ast::statement_list::list_type statements;
+    auto &original = node->statements();
+    for (size_t i = 0; i < original.size(); i++) {
+        auto stmt = rewrite(original[i]);
+        if (stmt == nullptr)
+            continue;
+        statements.push_back(stmt);
+        if (terminates(stmt)) {
+            for (size_t j = i + 1; j < original.size(); j++)
+                remove(original[j], eliminator_.unreachable_statements_);
+            break;
+        }
+    }
+
+    // x := a; x := b, where b does not read x
+    ast::statement_list::list_type kept;
+    for (size_t i = 0; i < statements.size(); i++) {
+        if (i + 1 < statements.size() && statements[i]->get_type() == ast::ast_node_type::assign_statement &&
+            statements[i + 1]->get_type() == ast::ast_node_type::assign_statement) {
+            auto first = static_cast<ast::assign_statement *>(statements[i]);
+            auto second = static_cast<ast::assign_statement *>(statements[i + 1]);
+            auto target = first->target()->target();
+            if (target->is_variable() && second->target()->target() == target && !reads(second->expr(), target) &&
+                !may_trap(first->expr())) {
+                remove(first, eliminator_.dead_stores_);
+                continue;
+            }
+        }
+        kept.push_back(statements[i]);
+    }
+
+    changed |= kept.size() != original.size();
+    node->set_statements(std::move(kept));
+    result_ = node;
+}
+
+void dead_code_eliminator::rewriter::visit_if_statement(ast::if_statement *node) {
+    int condition;
+    if (constant_value(node->condition(), condition)) {
+        // keep the branch that is taken and drop the rest
+        auto taken = condition ? node->then_statement() : node->else_statement();
+        if (condition)
+            node->set_then_statement(nullptr);
+        else
+            node->set_else_statement(nullptr);
+        remove(node, eliminator_.unreachable_statements_);
+        changed = true;
+        result_ = taken ? rewrite(taken) : nullptr;
+        return;
+    }
+
+    auto then_statement = rewrite(node->then_statement());
+    node->set_then_statement(then_statement ? then_statement : empty_statement());
+    if (node->has_else_statement())
+        node->set_else_statement(rewrite(node->else_statement()));
+    result_ = node;
+}
+
+void dead_code_eliminator::rewriter::visit_while_statement(ast::while_statement *node) {
+    int condition;
+    if (constant_value(node->cond(), condition) && !condition) {
+        remove(node, eliminator_.unreachable_statements_);
+        changed = true;
+        return;
+    }
+    auto body = rewrite(node->body());
+    node->set_body(body ? body : empty_statement());
+    result_ = node;
+}
+
+void dead_code_eliminator::rewriter::visit_call_statement(ast::call_statement *node) { }
+
+void dead_code_eliminator::rewriter::visit_read_statement(ast::read_statement *node) { }
+
+void dead_code_eliminator::rewriter::visit_write_statement(ast::write_statement *node) { }
+
+void dead_code_eliminator::rewriter::visit_assign_statement(ast::assign_statement *node) {
+    auto target = node->target()->target();
+    // assigning a constant or a procedure is an error the compiler reports
+    if (target->is_variable() && !eliminator_.read_.count(target) && !may_trap(node->expr())) {
+        remove(node, eliminator_.dead_stores_);
+        changed = true;
+    }
+}
+
+void dead_code_eliminator::rewriter::visit_return_statement(ast::return_statement *node) { }
+
+void dead_code_eliminator::remove_unreachable_procedures(ast::block *block,
+                                                         const std::unordered_set<procedure *> &reachable) {
+    std::vector<ast::procedure_declaration *> kept;
+    for (auto method : block->sub_procedures()) {
+        if (reachable.count(method->symbol())) {
+            remove_unreachable_procedures(method->main_block(), reachable);
+            kept.push_back(method);
+        } else {
+            removed_procedures_.push_back(method->symbol()->get_name());
+            delete method->main_block();
+            delete method;
+        }
+    }
+    block->set_sub_procedures(std::move(kept));
+}
+
+void dead_code_eliminator::collect_reads(ast::block *program) {
+    read_.clear();
+    read_scanner{read_}.scan(program);
+}
+
+bool dead_code_eliminator::rewrite_blocks(ast::block *block) {
+    rewriter rw{*this};
+    rw.run(block);
+    bool changed = rw.changed;
+    for (auto method : block->sub_procedures())
+        changed |= rewrite_blocks(method->main_block());
+    return changed;
+}
+
+void dead_code_eliminator::run(ast::block *program) {
+    size_t removed;
+    do {
+        // removing a store can leave the variables it read unread in turn
+        do {
+            collect_reads(program);
+        } while (rewrite_blocks(program));
+
+        // and removing a statement can leave procedures uncalled
+        removed = removed_procedures_.size();
+        analysis::call_graph graph{program};
+        auto procedures = graph.reachable();
+        remove_unreachable_procedures(program, { procedures.begin(), procedures.end() });
+    } while (removed != removed_procedures_.size());
+}
+
+void dead_code_eliminator::report(std::ostream &out) const {
+    for (auto &name : removed_procedures_)
+        out << "removed procedure " << name << ": never called\n";
+    out << "removed " << unreachable_statements_ << " unreachable statements and "
+        << dead_stores_ << " dead stores\n";
+}
+
+}
@@ -0,0 +1,40 @@
+#ifndef PL0_DEAD_CODE_H
+#define PL0_DEAD_CODE_H
+
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "../ast/ast.h"
+
+namespace pl0::optimizer {
+
+/**
+ * Removes code that cannot affect the output before it is compiled:
+ * procedures the main program never reaches through the call graph,
+ * statements following a return or guarded by a constant condition, and
+ * assignments to variables that nothing reads or that are overwritten by
+ * the very next statement. Assignments whose expression may divide by zero
+ * are kept so that a failing program still fails.
+ */
+class dead_code_eliminator {
+    class rewriter;
+
+    std::unordered_set<symbol *> read_;
+    std::vector<std::string> removed_procedures_;
+    int unreachable_statements_ = 0;
+    int dead_stores_ = 0;
+
+    void remove_unreachable_procedures(ast::block *block, const std::unordered_set<procedure *> &reachable);
+    void collect_reads(ast::block *program);
+    bool rewrite_blocks(ast::block *block);
+public:
+    void run(ast::block *program);
+
+    void report(std::ostream &out) const;
+};
+
+}
+
+#endif //PL0_DEAD_CODE_H
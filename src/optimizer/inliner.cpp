@@ -0,0 +1,297 @@
+#include <unordered_set>
+
+#include "inliner.h"
+#include "../ast/cloner.h"
+#include "../ast/node-counter.h"
+
+namespace pl0::optimizer {
+
+namespace {
+
+std::string procedure_name(procedure *proc) {
+    return proc ? proc->get_name() : "<program>";
+}
+
+/**
+ * Collects call statements, return statements and the variables read by the
+ * visited statement or expression.
+ */
+class body_scanner : public ast::ast_visitor<body_scanner> {
+    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+    DECLARE_VISIT_METHODS
+public:
+    std::vector<ast::call_statement *> calls;
+    std::unordered_set<symbol *> reads;
+    bool has_return = false;
+
+    void scan(ast::ast_node *node) { visit(node); }
+};
+
+void body_scanner::visit_variable_declaration(ast::variable_declaration *node) { }
+
+void body_scanner::visit_constant_declaration(ast::constant_declaration *node) { }
+
+void body_scanner::visit_procedure_declaration(ast::procedure_declaration *node) { }
+
+void body_scanner::visit_block(ast::block *node) {
+    visit(node->body());
+}
+
+void body_scanner::visit_unary_operation(ast::unary_operation *node) {
+    visit(node->expr());
+}
+
+void body_scanner::visit_binary_operation(ast::binary_operation *node) {
+    visit(node->left());
+    visit(node->right());
+}
+
+void body_scanner::visit_literal(ast::literal *node) { }
+
+void body_scanner::visit_variable_proxy(ast::variable_proxy *node) {
+    reads.insert(node->target());
+}
+
+void body_scanner::visit_statement_list(ast::statement_list *node) {
+    for (auto stmt : node->statements())
+        visit(stmt);
+}
+
+void body_scanner::visit_if_statement(ast::if_statement *node) {
+    visit(node->condition());
+    visit(node->then_statement());
+    if (node->has_else_statement())
+        visit(node->else_statement());
+}
+
+void body_scanner::visit_while_statement(ast::while_statement *node) {
+    visit(node->cond());
+    visit(node->body());
+}
+
+void body_scanner::visit_call_statement(ast::call_statement *node) {
+    calls.push_back(node);
+}
+
+void body_scanner::visit_read_statement(ast::read_statement *node) { }
+
+void body_scanner::visit_write_statement(ast::write_statement *node) {
+    for (auto expr : node->expressions())
+        visit(expr);
+}
+
+void body_scanner::visit_assign_statement(ast::assign_statement *node) {
+    visit(node->expr());
+}
+
+void body_scanner::visit_return_statement(ast::return_statement *node) {
+    has_return = true;
+}
+
+/**
+ * Locals that the leading assignments of `body` write before anything reads
+ * them. Only these can skip the zero-initialization a fresh frame would give.
+ */
+std::unordered_set<symbol *> assigned_before_read(ast::statement *body) {
+    std::vector<ast::statement *> leading{ body };
+    if (body->get_type() == ast::ast_node_type::statement_list)
+        leading = static_cast<ast::statement_list *>(body)->statements();
+
+    std::unordered_set<symbol *> assigned, read;
+    for (auto stmt : leading) {
+        if (stmt->get_type() != ast::ast_node_type::assign_statement)
+            break;
+        auto assign = static_cast<ast::assign_statement *>(stmt);
+        body_scanner scanner;
+        scanner.scan(assign->expr());
+        read.insert(scanner.reads.begin(), scanner.reads.end());
+        if (!read.count(assign->target()->target()))
+            assigned.insert(assign->target()->target());
+    }
+    return assigned;
+}
+
+}
+
+class inliner::rewriter : public ast::ast_visitor<rewriter> {
+    DEFINE_AST_VISITOR_SUBCLASS_MEMBERS()
+
+    inliner &inliner_;
+    const analysis::call_graph &graph_;
+    scope *scope_;
+    ast::statement *result_;
+
+    DECLARE_VISIT_METHODS
+
+    ast::statement *rewrite(ast::statement *node) {
+        result_ = node;
+        visit(node);
+        return result_;
+    }
+public:
+    std::vector<std::pair<procedure *, int>> counts;
+
+    rewriter(inliner &inl, const analysis::call_graph &graph, scope *site_scope)
+            : inliner_(inl), graph_(graph), scope_(site_scope), result_(nullptr) { }
+
+    void run(ast::block *block) {
+        block->set_body(rewrite(block->body()));
+    }
+};
+
+void inliner::rewriter::visit_variable_declaration(ast::variable_declaration *node) { }
+
+void inliner::rewriter::visit_constant_declaration(ast::constant_declaration *node) { }
+
+void inliner::rewriter::visit_procedure_declaration(ast::procedure_declaration *node) { }
+
+void inliner::rewriter::visit_block(ast::block *node) { }
+
+void inliner::rewriter::visit_unary_operation(ast::unary_operation *node) { }
+
+void inliner::rewriter::visit_binary_operation(ast::binary_operation *node) { }
+
+void inliner::rewriter::visit_literal(ast::literal *node) { }
+
+void inliner::rewriter::visit_variable_proxy(ast::variable_proxy *node) { }
+
+void inliner::rewriter::visit_statement_list(ast::statement_list *node) {
+    ast::statement_list::list_type statements;
+    for (auto stmt : node->statements())
+        statements.push_back(rewrite(stmt));
+    node->set_statements(std::move(statements));
+    result_ = node;
+}
+
+void inliner::rewriter::visit_if_statement(ast::if_statement *node) {
+    node->set_then_statement(rewrite(node->then_statement()));
+    if (node->has_else_statement())
+        node->set_else_statement(rewrite(node->else_statement()));
+    result_ = node;
+}
+
+void inliner::rewriter::visit_while_statement(ast::while_statement *node) {
+    node->set_body(rewrite(node->body()));
+    result_ = node;
+}
+
+void inliner::rewriter::visit_call_statement(ast::call_statement *node) {
+    auto sym = scope_->resolve(node->callee());
+    auto callee = sym && sym->is_procedure() ? dynamic_cast<procedure *>(sym) : nullptr;
+    if (callee == nullptr || !inliner_.can_inline_at(graph_, callee, scope_))
+        return;
+    result_ = inliner_.expand(graph_, callee, scope_);
+    delete node;
+
+    for (auto &count : counts) {
+        if (count.first == callee) {
+            count.second++;
+            return;
+        }
+    }
+    counts.emplace_back(callee, 1);
+}
+
+void inliner::rewriter::visit_read_statement(ast::read_statement *node) { }
+
+void inliner::rewriter::visit_write_statement(ast::write_statement *node) { }
+
+void inliner::rewriter::visit_assign_statement(ast::assign_statement *node) { }
+
+void inliner::rewriter::visit_return_statement(ast::return_statement *node) { }
+
+void inliner::evaluate(const analysis::call_graph &graph, procedure *proc) {
+    auto &info = candidates_[proc];
+    auto block = graph.main_block(proc);
+    info.size = ast::node_counter{}.count(block->body());
+
+    body_scanner scanner;
+    scanner.scan(block->body());
+    info.calls = scanner.calls;
+
+    if (graph.is_recursive(proc))
+        info.reason = "recursive";
+    else if (!block->sub_procedures().empty())
+        info.reason = "declares nested procedures";
+    else if (scanner.has_return)
+        info.reason = "contains return";
+    else if (info.size > size_limit_ && graph.calls_to(proc).size() > 1)
+        info.reason = concat("body size ", info.size, " exceeds limit ", size_limit_,
+                             " and it has ", graph.calls_to(proc).size(), " call sites");
+    else
+        info.inlinable = true;
+}
+
+bool inliner::can_inline_at(const analysis::call_graph &graph, procedure *callee, scope *site_scope) {
+    auto iter = candidates_.find(callee);
+    if (iter == candidates_.end() || !iter->second.inlinable)
+        return false;
+    // calls left in the callee's body are resolved by name at the call site
+    auto callee_scope = graph.main_block(callee)->belonging_scope();
+    for (auto call : iter->second.calls) {
+        if (site_scope->resolve(call->callee()) != callee_scope->resolve(call->callee())) {
+            kept_.push_back(concat("kept a call to ", callee->get_name(), ": \"", call->callee(),
+                                   "\" means something else at the call site"));
+            return false;
+        }
+    }
+    return true;
+}
+
+ast::statement *inliner::expand(const analysis::call_graph &graph, procedure *callee, scope *site_scope) {
+    auto block = graph.main_block(callee);
+    auto callee_scope = block->belonging_scope();
+
+    auto &substitutions = slots_[site_scope][callee];
+    for (auto var : callee_scope->get_variables()) {
+        if (substitutions.find(var) != substitutions.end())
+            continue;
+        auto slot = new variable(callee->get_name() + '.' + var->get_name(),
+                                 site_scope->get_level(), site_scope->get_variable_count());
+        site_scope->define(slot);
+        substitutions[var] = slot;
+    }
+
+    ast::statement_list::list_type statements;
+    auto assigned = assigned_before_read(block->body());
+    for (auto var : callee_scope->get_variables()) {
+        if (!assigned.count(var))
+            statements.push_back(new ast::assign_statement(new ast::variable_proxy(substitutions[var]),
+                                                           new ast::literal(0)));
+    }
+    auto body = ast::ast_cloner{substitutions}.clone(block->body());
+    if (statements.empty())
+        return body;
+    statements.push_back(body);
+    return new ast::statement_list(std::move(statements));
+}
+
+void inliner::run(ast::block *program) {
+    analysis::call_graph graph{program};
+    for (auto proc : graph.post_order()) {
+        rewriter rw{*this, graph, graph.main_block(proc)->belonging_scope()};
+        rw.run(graph.main_block(proc));
+        for (auto &count : rw.counts) {
+            inlined_.push_back(concat("inlined ", procedure_name(count.first), " into ", procedure_name(proc),
+                                      " at ", count.second, count.second == 1 ? " site" : " sites",
+                                      " (body size ", candidates_[count.first].size, ")"));
+        }
+        if (proc) {
+            evaluate(graph, proc);
+            auto &info = candidates_[proc];
+            if (!info.inlinable && !graph.calls_to(proc).empty())
+                kept_.push_back(concat("kept ", procedure_name(proc), ": ", info.reason));
+        }
+    }
+}
+
+void inliner::report(std::ostream &out) const {
+    for (auto &line : inlined_)
+        out << line << '\n';
+    for (auto &line : kept_)
+        out << line << '\n';
+    if (inlined_.empty() && kept_.empty())
+        out << "no call sites\n";
+}
+
+}
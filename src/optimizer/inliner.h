@@ -0,0 +1,55 @@
+#ifndef PL0_INLINER_H
+#define PL0_INLINER_H
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../ast/ast.h"
+#include "../analysis/call-graph.h"
+
+namespace pl0::optimizer {
+
+/**
+ * Replaces calls to small non-recursive procedures with a copy of the
+ * callee's body. The callee's locals become extra locals of the caller's
+ * frame, so LOD/STO levels and indexes are recomputed by the compiler from
+ * the new symbols. Procedures are processed callees first, so a caller's
+ * size already includes whatever was inlined into it.
+ */
+class inliner {
+public:
+    static constexpr size_t default_size_limit = 32;
+
+private:
+    struct candidate {
+        bool inlinable = false;
+        std::string reason;
+        size_t size = 0;
+        std::vector<ast::call_statement *> calls;
+    };
+
+    class rewriter;
+
+    size_t size_limit_;
+    std::unordered_map<procedure *, candidate> candidates_;
+    // callee locals already materialized in a caller scope, reused across sites
+    std::unordered_map<scope *, std::unordered_map<procedure *, std::unordered_map<symbol *, symbol *>>> slots_;
+    std::vector<std::string> inlined_;
+    std::vector<std::string> kept_;
+
+    void evaluate(const analysis::call_graph &graph, procedure *proc);
+    bool can_inline_at(const analysis::call_graph &graph, procedure *callee, scope *site_scope);
+    ast::statement *expand(const analysis::call_graph &graph, procedure *callee, scope *site_scope);
+public:
+    explicit inliner(size_t size_limit = default_size_limit) : size_limit_(size_limit) { }
+
+    void run(ast::block *program);
+
+    void report(std::ostream &out) const;
+};
+
+}
+
+#endif //PL0_INLINER_H
@@ -38,6 +38,7 @@ void lexer::advance() {
             loc_.column = 1;
         }
     }
+    token_loc_ = loc_;
     // check if input stream has ended
     if (input_stream_.peek() == std::char_traits<char>::eof()) {
         peek_ = token::EOS;
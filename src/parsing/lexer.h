@@ -13,6 +13,8 @@ class lexer {
     std::string literal_buffer_;
     token peek_;
     location loc_;
+    // where the peeked token starts
+    location token_loc_;
 
     inline int get();
     inline token select(char cond, token conseq, token altern);
@@ -51,6 +53,10 @@ public:
     inline location loc() {
         return loc_;
     }
+
+    inline location token_loc() {
+        return token_loc_;
+    }
 };
 
 }
@@ -4,13 +4,16 @@
 namespace pl0 {
 
 ast::block * parser::subprogram() {
+    auto loc = lexer_.token_loc();
     auto constants = lexer_.peek(token::CONST) ? constant_decl() : nullptr;
     auto variables = lexer_.peek(token::VAR) ? variable_decl() : nullptr;
     std::vector<ast::procedure_declaration*> sub_methods;
     while (lexer_.peek(token::PROCEDURE))
         sub_methods.push_back(procedure_decl());
     auto body = statement();
-    return new ast::block{top_, variables, constants, std::move(sub_methods), body};
+    auto block = new ast::block{top_, variables, constants, std::move(sub_methods), body};
+    block->set_loc(loc);
+    return block;
 }
 
 // declarations
@@ -92,16 +95,20 @@ ast::call_statement * parser::call_statement() {
 }
 
 ast::statement * parser::statement() {
+    auto loc = lexer_.token_loc();
+    ast::statement *node;
     switch (lexer_.peek()) {
-    case token::READ: return read_statement();
-    case token::WRITE: return write_statement();
-    case token::IF: return if_statement();
-    case token::BEGIN: return statement_list();
-    case token::WHILE: return while_statement();
-    case token::CALL: return call_statement();
-    case token::RETURN: return return_statement();
-    default: return assign_statement();
+    case token::READ: node = read_statement(); break;
+    case token::WRITE: node = write_statement(); break;
+    case token::IF: node = if_statement(); break;
+    case token::BEGIN: node = statement_list(); break;
+    case token::WHILE: node = while_statement(); break;
+    case token::CALL: node = call_statement(); break;
+    case token::RETURN: node = return_statement(); break;
+    default: node = assign_statement(); break;
     }
+    node->set_loc(loc);
+    return node;
 }
 
 ast::read_statement * parser::read_statement() {
@@ -135,35 +142,44 @@ ast::return_statement * parser::return_statement() {
 
 // expressions
 ast::variable_proxy * parser::local_variable() {
+    auto loc = lexer_.token_loc();
     std::string id = identifier();
     symbol *sym = top_->resolve(id);
     if (sym == nullptr) {
         throw general_error("undeclared identifier \"", id, '"');
     } else if (sym->is_variable()) {
-        return new ast::variable_proxy(dynamic_cast<variable*>(sym));
+        auto proxy = new ast::variable_proxy(dynamic_cast<variable*>(sym));
+        proxy->set_loc(loc);
+        return proxy;
     } else {
         throw general_error("cannot assign value to a non-variable \"", id, '"');
     }
 }
 
 ast::expression * parser::condition() {
+    auto loc = lexer_.token_loc();
+    ast::expression *cond;
     if (lexer_.match(token::ODD)) {
-        return new ast::unary_operation(token::ODD, expression());
+        cond = new ast::unary_operation(token::ODD, expression());
     } else {
         auto left = expression();
         token cmp_op = lexer_.next();
         if (!is_compare_operator(cmp_op)) {
             throw general_error("expect a compare operator instead of ", *cmp_op);
         }
-        return new ast::binary_operation(cmp_op, left, expression());
+        cond = new ast::binary_operation(cmp_op, left, expression());
     }
+    cond->set_loc(loc);
+    return cond;
 }
 
 ast::expression * parser::expression() {
     auto lhs = term();
     while (lexer_.peek(token::MUL) || lexer_.peek(token::DIV)) {
         token op = lexer_.next();
+        auto loc = lhs->loc();
         lhs = new ast::binary_operation(op, lhs, term());
+        lhs->set_loc(loc);
     }
     return lhs;
 }
@@ -172,21 +188,28 @@ ast::expression * parser::term() {
     auto lhs = factor();
     while (lexer_.peek(token::ADD) || lexer_.peek(token::SUB)) {
         token op = lexer_.next();
+        auto loc = lhs->loc();
         lhs = new ast::binary_operation(op, lhs, factor());
+        lhs->set_loc(loc);
     }
     return lhs;
 }
 
 ast::expression * parser::factor() {
+    auto loc = lexer_.token_loc();
     if (lexer_.peek(token::IDENTIFIER)) {
         std::string id = lexer_.get_literal();
         lexer_.advance();
         symbol *sym = top_->resolve(id);
         if (sym == nullptr)
             throw general_error("undeclared identifier \"", id, '"');
-        return new ast::variable_proxy{sym};
+        auto proxy = new ast::variable_proxy{sym};
+        proxy->set_loc(loc);
+        return proxy;
     } else if (lexer_.peek(token::NUMBER)) {
-        return new ast::literal(number());
+        auto value = new ast::literal(number());
+        value->set_loc(loc);
+        return value;
     } else if (lexer_.match(token::LPAREN)) {
         auto expr = expression();
         expect(token::RPAREN);
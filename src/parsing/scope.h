@@ -1,8 +1,10 @@
 #ifndef PL_ZERO_SCOPE_H
 #define PL_ZERO_SCOPE_H
 
+#include <algorithm>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "symbol.h"
 #include "../util.h"
@@ -43,6 +45,18 @@ public:
         return iter->second;
     }
 
+    std::vector<variable *> get_variables() const {
+        std::vector<variable *> result;
+        for (auto &pair : members_) {
+            if (pair.second->is_variable())
+                result.push_back(static_cast<variable *>(pair.second));
+        }
+        std::sort(result.begin(), result.end(), [](variable *a, variable *b) {
+            return a->get_index() < b->get_index();
+        });
+        return result;
+    }
+
     inline scope *get_enclosing_scope() {
         return enclosing_scope_;
     }
@@ -54,6 +68,10 @@ public:
     inline int get_variable_count() const {
         return variable_count_;
     }
+
+    inline size_t size() const {
+        return members_.size();
+    }
 };
 
 }
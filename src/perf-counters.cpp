@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+
+#include "perf-counters.h"
+#include "util.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace pl0 {
+
+#define T(x, config) #x,
+static const char *const hardware_event_name[] = {
+    HARDWARE_EVENT_LIST(T)
+};
+#undef T
+
+#ifdef __linux__
+
+static int open_counter(uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+perf_counters::perf_counters() {
+#define T(x, config) config,
+    const uint64_t configs[hardware_event_count] = {
+        HARDWARE_EVENT_LIST(T)
+    };
+#undef T
+    for (int i = 0; i < hardware_event_count; i++) {
+        fds_[i] = open_counter(configs[i]);
+        if (fds_[i] < 0 && error_.empty())
+            error_ = concat("perf_event_open(", hardware_event_name[i], ") failed: ", std::strerror(errno));
+    }
+    for (int fd : fds_) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+perf_counters::~perf_counters() {
+    for (int fd : fds_) {
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+void perf_counters::read(counter_values &values) const {
+    for (int i = 0; i < hardware_event_count; i++) {
+        uint64_t value = 0;
+        if (fds_[i] < 0 || ::read(fds_[i], &value, sizeof(value)) != sizeof(value))
+            value = 0;
+        values[i] = value;
+    }
+}
+
+#else
+
+perf_counters::perf_counters() : error_("hardware counters are only supported on Linux") {
+    fds_.fill(-1);
+}
+
+perf_counters::~perf_counters() = default;
+
+void perf_counters::read(counter_values &values) const {
+    values.fill(0);
+}
+
+#endif
+
+bool perf_counters::available() const {
+    return std::any_of(fds_.begin(), fds_.end(), [](int fd) { return fd >= 0; });
+}
+
+procedure_profiler::procedure_profiler(const procedure_table &procedures, bool per_opcode)
+        : procedures_(procedures), records_(procedures.size()),
+          per_opcode_(per_opcode && counters_.available()), pending_opcode_(-1),
+          pending_line_(-1) {
+    for (size_t i = 0; i < procedures.size(); i++)
+        entry_to_index_[procedures[i].entry] = static_cast<int>(i);
+    if (per_opcode_) {
+        opcode_totals_.resize(std::size(opcode_name));
+        opcode_counts_.resize(std::size(opcode_name));
+        calibrate();
+    }
+    counters_.read(last_);
+}
+
+void procedure_profiler::calibrate() {
+    counter_values before{}, after{};
+    sample_overhead_.fill(UINT64_MAX);
+    for (int round = 0; round < 64; round++) {
+        counters_.read(before);
+        counters_.read(after);
+        for (int i = 0; i < hardware_event_count; i++)
+            sample_overhead_[i] = std::min(sample_overhead_[i], after[i] - before[i]);
+    }
+}
+
+void procedure_profiler::sample(counter_values &delta) {
+    counter_values now{};
+    counters_.read(now);
+    for (int i = 0; i < hardware_event_count; i++)
+        delta[i] = now[i] - last_[i];
+    last_ = now;
+    if (!call_stack_.empty()) {
+        auto &self = records_[call_stack_.back()].self;
+        for (int i = 0; i < hardware_event_count; i++)
+            self[i] += delta[i];
+    }
+}
+
+void procedure_profiler::enter(int entry) {
+    if (!enabled())
+        return;
+    counter_values delta{};
+    sample(delta);
+    auto iter = entry_to_index_.find(entry);
+    if (iter == entry_to_index_.end()) {
+        entry_to_index_[entry] = static_cast<int>(records_.size());
+        records_.emplace_back();
+        iter = entry_to_index_.find(entry);
+    }
+    call_stack_.push_back(iter->second);
+    records_[iter->second].calls++;
+}
+
+void procedure_profiler::leave() {
+    if (!enabled() || call_stack_.empty())
+        return;
+    counter_values delta{};
+    sample(delta);
+    call_stack_.pop_back();
+}
+
+void procedure_profiler::step_slow(int program_counter, opcode op) {
+    counter_values delta{};
+    sample(delta);
+    for (int i = 0; i < hardware_event_count; i++)
+        delta[i] = delta[i] > sample_overhead_[i] ? delta[i] - sample_overhead_[i] : 0;
+    if (pending_opcode_ >= 0) {
+        auto &total = opcode_totals_[pending_opcode_];
+        for (int i = 0; i < hardware_event_count; i++)
+            total[i] += delta[i];
+        opcode_counts_[pending_opcode_]++;
+    }
+    if (pending_line_ >= 0) {
+        auto &[count, total] = line_totals_[pending_line_];
+        for (int i = 0; i < hardware_event_count; i++)
+            total[i] += delta[i];
+        count++;
+    }
+    pending_opcode_ = static_cast<int>(op);
+    pending_line_ = lines_ ? lines_->line(program_counter) : -1;
+}
+
+static void print_row(std::ostream &out, const std::string &name, uint64_t count, const counter_values &values,
+                      const perf_counters &counters) {
+    out << std::left << std::setw(24) << name << std::right << std::setw(12) << count;
+    for (int i = 0; i < hardware_event_count; i++) {
+        out << std::setw(16);
+        if (counters.available(hardware_event(i)))
+            out << values[i];
+        else
+            out << "n/a";
+    }
+    out << '\n';
+}
+
+void procedure_profiler::report(std::ostream &out) const {
+    if (!enabled()) {
+        out << "hardware counters unavailable: " << error() << '\n';
+        return;
+    }
+
+    std::vector<int> order(records_.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = static_cast<int>(i);
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return records_[a].self[0] > records_[b].self[0];
+    });
+
+    out << std::left << std::setw(24) << "procedure" << std::right << std::setw(12) << "calls";
+    for (auto name : hardware_event_name)
+        out << std::setw(16) << name;
+    out << '\n';
+    for (int index : order) {
+        auto &record = records_[index];
+        if (record.calls == 0)
+            continue;
+        auto name = index < static_cast<int>(procedures_.size())
+                    ? procedures_[index].name
+                    : std::string{ "<unknown>" };
+        print_row(out, name, record.calls, record.self, counters_);
+    }
+
+    if (per_opcode_) {
+        out << '\n' << std::left << std::setw(24) << "opcode" << std::right << std::setw(12) << "executed";
+        for (auto name : hardware_event_name)
+            out << std::setw(16) << name;
+        out << '\n';
+        for (size_t op = 0; op < opcode_totals_.size(); op++) {
+            if (opcode_counts_[op] > 0)
+                print_row(out, opcode_name[op], opcode_counts_[op], opcode_totals_[op], counters_);
+        }
+    }
+
+    if (!line_totals_.empty()) {
+        out << '\n' << std::left << std::setw(24) << "line" << std::right << std::setw(12) << "executed";
+        for (auto name : hardware_event_name)
+            out << std::setw(16) << name;
+        out << '\n';
+        for (auto &[line, totals] : line_totals_)
+            print_row(out, line == 0 ? std::string{ "<unknown>" } : std::to_string(line), totals.first,
+                      totals.second, counters_);
+    }
+}
+
+}
@@ -0,0 +1,120 @@
+#ifndef PL0_PERF_COUNTERS_H
+#define PL0_PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bytecode/bytecode.h"
+
+namespace pl0 {
+
+// each event with its perf_event_open config, which only Linux builds expand
+#define HARDWARE_EVENT_LIST(T) \
+    T(cycles, PERF_COUNT_HW_CPU_CYCLES) \
+    T(instructions, PERF_COUNT_HW_INSTRUCTIONS) \
+    T(branch_misses, PERF_COUNT_HW_BRANCH_MISSES) \
+    T(cache_misses, PERF_COUNT_HW_CACHE_MISSES)
+
+#define T(x, config) x,
+enum class hardware_event : int {
+    HARDWARE_EVENT_LIST(T)
+};
+#undef T
+
+#define T(x, config) + 1
+constexpr int hardware_event_count = 0 HARDWARE_EVENT_LIST(T);
+#undef T
+
+typedef std::array<uint64_t, hardware_event_count> counter_values;
+
+/**
+ * A set of hardware counters measuring the calling thread in user space.
+ * Counters that cannot be opened (no kernel support, restrictive
+ * perf_event_paranoid, virtualized PMU...) are reported as unavailable.
+ */
+class perf_counters {
+    std::array<int, hardware_event_count> fds_;
+    std::string error_;
+public:
+    perf_counters();
+    ~perf_counters();
+
+    perf_counters(const perf_counters &) = delete;
+    perf_counters &operator=(const perf_counters &) = delete;
+
+    bool available() const;
+
+    bool available(hardware_event event) const {
+        return fds_[static_cast<int>(event)] >= 0;
+    }
+
+    const std::string &error() const { return error_; }
+
+    void read(counter_values &values) const;
+};
+
+/**
+ * Attributes counter deltas to the PL/0 procedure on top of the call stack,
+ * sampling only at CAL/RET boundaries. With per-opcode attribution enabled
+ * the counters are also sampled around every instruction, which is far more
+ * expensive; the cost of a sample itself is calibrated and subtracted.
+ * Given the line table of the code, those samples are also summed up per
+ * source line.
+ */
+class procedure_profiler {
+    struct procedure_record {
+        counter_values self{};
+        uint64_t calls = 0;
+    };
+
+    perf_counters counters_;
+    const procedure_table &procedures_;
+    std::unordered_map<int, int> entry_to_index_;
+    std::vector<procedure_record> records_;
+    std::vector<int> call_stack_;
+    counter_values last_{};
+
+    bool per_opcode_;
+    int pending_opcode_;
+    int pending_line_;
+    counter_values sample_overhead_{};
+    std::vector<counter_values> opcode_totals_;
+    std::vector<uint64_t> opcode_counts_;
+    const line_table *lines_ = nullptr;
+    std::map<int, std::pair<uint64_t, counter_values>> line_totals_;
+
+    void sample(counter_values &delta);
+    void calibrate();
+public:
+    procedure_profiler(const procedure_table &procedures, bool per_opcode);
+
+    bool enabled() const { return counters_.available(); }
+
+    const std::string &error() const { return counters_.error(); }
+
+    void enter(int entry);
+    void leave();
+
+    // attribute instructions to source lines too, or stop if nullptr
+    void set_lines(const line_table *lines) {
+        lines_ = lines;
+    }
+
+    void step(int program_counter, opcode op) {
+        if (per_opcode_)
+            step_slow(program_counter, op);
+    }
+
+    void step_slow(int program_counter, opcode op);
+
+    void report(std::ostream &out) const;
+};
+
+}
+
+#endif //PL0_PERF_COUNTERS_H
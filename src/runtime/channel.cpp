@@ -0,0 +1,53 @@
+#include "channel.h"
+
+namespace pl0::runtime {
+
+void channel::send(int value) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        input_.push_back(value);
+        wake = parked_;
+        parked_ = false;
+    }
+    if (wake)
+        wake_();
+}
+
+void channel::close() {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        wake = parked_;
+        parked_ = false;
+    }
+    if (wake)
+        wake_();
+}
+
+bool channel::read(int &value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!input_.empty()) {
+        value = input_.front();
+        input_.pop_front();
+        return true;
+    }
+    value = 0;
+    return closed_;
+}
+
+bool channel::write(int value) {
+    on_output_(value);
+    return true;
+}
+
+bool channel::park() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!input_.empty() || closed_)
+        return false;
+    parked_ = true;
+    return true;
+}
+
+}
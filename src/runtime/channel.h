@@ -0,0 +1,52 @@
+#ifndef PL0_RUNTIME_CHANNEL_H
+#define PL0_RUNTIME_CHANNEL_H
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "../vm.h"
+
+namespace pl0::runtime {
+
+/**
+ * In-memory input and output of a program on the event loop. Input can be
+ * sent from any thread and wakes the program if it waits for it. Output is
+ * handed to a callback on the thread running the program, so writing never
+ * blocks; the callback may send more input.
+ */
+class channel : public program_io {
+public:
+    typedef std::function<void (int value)> output_handler;
+
+    explicit channel(output_handler on_output) : on_output_(std::move(on_output)) { }
+
+    void send(int value);
+
+    // the input ends, reads yield 0 from now on
+    void close();
+
+    bool read(int &value) override;
+
+    bool write(int value) override;
+private:
+    std::mutex mutex_;
+    std::deque<int> input_;
+    bool closed_ = false;
+    bool parked_ = false;
+    output_handler on_output_;
+    // makes the program ready again, set by the event loop
+    std::function<void ()> wake_;
+
+    friend class event_loop;
+
+    /**
+     * Called once the program stopped for input.
+     * @return false if input arrived in the meantime
+     */
+    bool park();
+};
+
+}
+
+#endif //PL0_RUNTIME_CHANNEL_H
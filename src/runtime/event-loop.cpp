@@ -0,0 +1,222 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+
+#include "event-loop.h"
+#include "../bytecode/verifier.h"
+#include "../util.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+namespace pl0::runtime {
+
+#ifdef __linux__
+
+event_loop::event_loop(int threads, long time_slice)
+        : time_slice_(time_slice), scheduler_(threads) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wakeup_fd_ < 0)
+        throw general_error("cannot create the event loop: ", std::strerror(errno));
+    epoll_event event{ };
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event);
+    // a reader that went away shows up as EPIPE from write()
+    std::signal(SIGPIPE, SIG_IGN);
+}
+
+event_loop::~event_loop() {
+    for (auto t : tasks_)
+        delete t;
+    close(epoll_fd_);
+    close(wakeup_fd_);
+}
+
+void event_loop::spawn(const bytecode &code, int input, int output, exit_handler on_exit) {
+    set_nonblocking(input);
+    if (output != input)
+        set_nonblocking(output);
+    auto t = new task{ this, code, verify(code), std::make_unique<fd_io>(input, output), nullptr };
+    t->on_fds_exit = std::move(on_exit);
+    add(t);
+}
+
+std::shared_ptr<channel> event_loop::spawn(const bytecode &code, channel::output_handler on_output,
+                                           channel_exit_handler on_exit) {
+    auto messages = std::make_shared<channel>(std::move(on_output));
+    auto t = new task{ this, code, verify(code), nullptr, messages };
+    t->on_exit = std::move(on_exit);
+    messages->wake_ = [this, t] { scheduler_.submit(t); };
+    add(t);
+    return messages;
+}
+
+bool event_loop::verify(const bytecode &code) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = verified_.find(&code);
+        if (iter != verified_.end()) {
+            iter->second.programs++;
+            return iter->second.verified;
+        }
+    }
+    bool verified = code::verifier{ }.verify(code);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &entry = verified_.emplace(&code, verified_code{ verified, 0 }).first->second;
+    entry.programs++;
+    return entry.verified;
+}
+
+void event_loop::add(task *t) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.insert(t);
+    }
+    scheduler_.submit(t);
+}
+
+void event_loop::run() {
+    scheduler_.start();
+    poll();
+    scheduler_.stop();
+}
+
+void event_loop::step(task *t) {
+    if (!t->exiting) {
+        machine::status status;
+        try {
+            status = t->vm.run(time_slice_);
+        } catch (general_error &error) {
+            // ends this program only, after writing what it wrote so far
+            t->error = error.what();
+            t->error_address = t->vm.program_counter() - 1;
+            status = machine::status::finished;
+        }
+        switch (status) {
+        case machine::status::finished:
+            t->exiting = true;
+            break;
+        case machine::status::suspended:
+            if (t->fds)
+                t->fds->flush();
+            scheduler_.submit(t);
+            return;
+        case machine::status::waiting_for_input:
+            if (t->messages) {
+                // the task must not be touched once parked, a sender may wake it
+                if (!t->messages->park())
+                    scheduler_.submit(t);
+            } else if (t->fds->flush()) {
+                // a prompt has to reach the other side before an answer can come
+                wait_for(t, t->fds->input_fd(), EPOLLIN);
+            } else {
+                wait_for(t, t->fds->output_fd(), EPOLLOUT);
+            }
+            return;
+        case machine::status::waiting_for_output:
+            wait_for(t, t->fds->output_fd(), EPOLLOUT);
+            return;
+        }
+    }
+    if (!t->fds || t->fds->flush())
+        finish(t);
+    else
+        wait_for(t, t->fds->output_fd(), EPOLLOUT);
+}
+
+void event_loop::wait_for(task *t, int fd, uint32_t events) {
+    // the task must not be touched after this, the poller may hand it on
+    epoll_event event{ };
+    event.events = events | EPOLLONESHOT;
+    event.data.ptr = t;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) == 0)
+        return;
+    if (errno == ENOENT && epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == 0)
+        return;
+    // regular files cannot be polled, but never make us wait either
+    scheduler_.submit(t);
+}
+
+void event_loop::finish(task *t) {
+    if (t->fds) {
+        int input = t->fds->input_fd(), output = t->fds->output_fd();
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, input, nullptr);
+        if (output != input)
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, output, nullptr);
+        if (t->on_fds_exit) {
+            t->on_fds_exit(input, output, t->error, t->error_address);
+        } else {
+            close(input);
+            if (output != input)
+                close(output);
+        }
+    } else if (t->on_exit) {
+        t->on_exit(t->error, t->error_address);
+    }
+
+    bool last;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.erase(t);
+        last = tasks_.empty();
+        auto iter = verified_.find(t->code);
+        if (--iter->second.programs == 0)
+            verified_.erase(iter);
+    }
+    delete t;
+    if (last) {
+        uint64_t one = 1;
+        if (write(wakeup_fd_, &one, sizeof one) < 0) { }
+    }
+}
+
+void event_loop::poll() {
+    epoll_event events[64];
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (tasks_.empty())
+                return;
+        }
+        int count = epoll_wait(epoll_fd_, events, 64, -1);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            throw general_error("epoll_wait failed: ", std::strerror(errno));
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == nullptr) {
+                uint64_t value;
+                if (read(wakeup_fd_, &value, sizeof value) < 0) { }
+            } else {
+                scheduler_.submit(static_cast<task *>(events[i].data.ptr));
+            }
+        }
+    }
+}
+
+#else
+
+event_loop::event_loop(int threads, long time_slice)
+        : time_slice_(time_slice), epoll_fd_(-1), wakeup_fd_(-1), scheduler_(threads) {
+    throw general_error("the event loop needs epoll, which this system does not have");
+}
+
+event_loop::~event_loop() = default;
+
+void event_loop::spawn(const bytecode &, int, int, exit_handler) { }
+
+std::shared_ptr<channel> event_loop::spawn(const bytecode &, channel::output_handler,
+                                           channel_exit_handler) {
+    return nullptr;
+}
+
+void event_loop::run() { }
+
+#endif
+
+}
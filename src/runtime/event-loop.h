@@ -0,0 +1,121 @@
+#ifndef PL0_RUNTIME_EVENT_LOOP_H
+#define PL0_RUNTIME_EVENT_LOOP_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "channel.h"
+#include "fd-io.h"
+#include "scheduler.h"
+
+namespace pl0::runtime {
+
+/**
+ * Runs many programs on a few threads. Each program is a machine with its
+ * own frames, program counter and I/O, reading and writing either
+ * non-blocking descriptors or an in-memory channel. A program waiting for
+ * input or for its output to drain is parked (descriptors in an epoll set)
+ * instead of holding a thread, and a program that used up its time slice
+ * is queued again behind the others on the scheduler.
+ *
+ * A program that fails, e.g. by dividing by zero, ends on its own: its
+ * output is still written and its exit handler gets the error and the
+ * instruction that failed, while the other programs keep running.
+ */
+class event_loop {
+public:
+    /**
+     * Called from a worker thread once a program ended and its output is
+     * written, with the error it failed with and the address of the
+     * instruction that failed, or an empty error and -1.
+     */
+    typedef std::function<void (int input, int output, const std::string &error, int program_counter)> exit_handler;
+    // the same for a program whose I/O goes through a channel
+    typedef std::function<void (const std::string &error, int program_counter)> channel_exit_handler;
+
+    explicit event_loop(int threads = 1, long time_slice = 10000);
+    ~event_loop();
+
+    event_loop(const event_loop &) = delete;
+    event_loop &operator=(const event_loop &) = delete;
+
+    /**
+     * Start a program. The descriptors are made non-blocking; unless a
+     * handler is given, they are closed when the program ends. The code has
+     * to outlive the program. May be called from any thread, also while
+     * run() is running.
+     */
+    void spawn(const bytecode &code, int input, int output, exit_handler on_exit = nullptr);
+
+    /**
+     * Start a program whose I/O goes through a channel.
+     * @return the channel to send the program's input to
+     */
+    std::shared_ptr<channel> spawn(const bytecode &code, channel::output_handler on_output,
+                                   channel_exit_handler on_exit = nullptr);
+
+    // returns once all programs have ended
+    void run();
+
+    long steals() const {
+        return scheduler_.steals();
+    }
+
+private:
+    struct task : job {
+        event_loop *loop;
+        const bytecode *code;
+        std::unique_ptr<fd_io> fds;
+        std::shared_ptr<channel> messages;
+        machine vm;
+        exit_handler on_fds_exit;
+        channel_exit_handler on_exit;
+        // output is being drained after the program ended
+        bool exiting = false;
+        // what the program failed with and where, empty and -1 if it finished
+        std::string error;
+        int error_address = -1;
+
+        task(event_loop *owner, const bytecode &code, bool verified, std::unique_ptr<fd_io> io,
+             std::shared_ptr<channel> chan)
+                : loop(owner), code(&code), fds(std::move(io)), messages(std::move(chan)),
+                  vm(code, verified, nullptr, nullptr, fds ? static_cast<program_io *>(fds.get()) : messages.get()) { }
+
+        void step() override {
+            loop->step(this);
+        }
+    };
+
+    long time_slice_;
+    int epoll_fd_;
+    // wakes the poller when the last program ended
+    int wakeup_fd_;
+    scheduler scheduler_;
+
+    std::mutex mutex_;
+    std::unordered_set<task *> tasks_;
+    struct verified_code {
+        bool verified;
+        // programs running it; the entry goes with the last, as other code may reuse its address
+        int programs;
+    };
+    // whether the code of the running programs passed the verifier, so it
+    // runs once per code and not once per program
+    std::unordered_map<const bytecode *, verified_code> verified_;
+
+    bool verify(const bytecode &code);
+    void add(task *t);
+    void step(task *t);
+    void wait_for(task *t, int fd, uint32_t events);
+    void finish(task *t);
+    void poll();
+};
+
+}
+
+#endif //PL0_RUNTIME_EVENT_LOOP_H
@@ -0,0 +1,112 @@
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fd-io.h"
+#include "../util.h"
+
+namespace pl0::runtime {
+
+fd_io::fd_io(int input, int output, size_t capacity)
+        : input_(input), output_(output), capacity_(capacity) { }
+
+bool fd_io::fill() {
+    // drop what has been parsed before the buffer grows
+    if (input_pos_ > 0) {
+        input_buffer_.erase(0, input_pos_);
+        input_pos_ = 0;
+    }
+    char chunk[4096];
+    while (true) {
+        auto count = ::read(input_, chunk, sizeof chunk);
+        if (count > 0) {
+            input_buffer_.append(chunk, static_cast<size_t>(count));
+            return true;
+        }
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return false;
+        end_of_input_ = true;
+        return true;
+    }
+}
+
+bool fd_io::read(int &value) {
+    while (!failed_) {
+        auto &buffer = input_buffer_;
+        size_t pos = input_pos_;
+        while (pos < buffer.size() && std::isspace(static_cast<unsigned char>(buffer[pos])))
+            pos++;
+        size_t end = pos;
+        if (end < buffer.size() && (buffer[end] == '+' || buffer[end] == '-'))
+            end++;
+        size_t digits = end;
+        while (end < buffer.size() && std::isdigit(static_cast<unsigned char>(buffer[end])))
+            end++;
+        // the number may go on in input that has not arrived yet
+        if (end == buffer.size() && !end_of_input_) {
+            if (!fill())
+                return false;
+            continue;
+        }
+        if (end == digits) {
+            failed_ = true;
+            break;
+        }
+
+        long long number = 0;
+        for (size_t i = digits; i < end && number <= INT_MAX + 1LL; i++)
+            number = number * 10 + (buffer[i] - '0');
+        if (buffer[pos] == '-')
+            number = -number;
+        input_pos_ = end;
+        // like `cin >>`, an out of range number saturates and fails the stream
+        if (number > INT_MAX || number < INT_MIN) {
+            failed_ = true;
+            value = number > 0 ? INT_MAX : INT_MIN;
+            return true;
+        }
+        value = static_cast<int>(number);
+        return true;
+    }
+    value = 0;
+    return true;
+}
+
+bool fd_io::write(int value) {
+    if (output_buffer_.size() >= capacity_ && !flush())
+        return false;
+    output_buffer_ += std::to_string(value);
+    output_buffer_ += '\n';
+    return true;
+}
+
+bool fd_io::flush() {
+    size_t written = 0;
+    while (written < output_buffer_.size()) {
+        auto count = ::write(output_, output_buffer_.data() + written, output_buffer_.size() - written);
+        if (count >= 0) {
+            written += static_cast<size_t>(count);
+            continue;
+        }
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+        written = output_buffer_.size();
+    }
+    output_buffer_.erase(0, written);
+    return output_buffer_.empty();
+}
+
+void set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        throw general_error("cannot make descriptor ", fd, " non-blocking: ", std::strerror(errno));
+}
+
+}
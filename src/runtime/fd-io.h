@@ -0,0 +1,57 @@
+#ifndef PL0_RUNTIME_FD_IO_H
+#define PL0_RUNTIME_FD_IO_H
+
+#include <string>
+
+#include "../vm.h"
+
+namespace pl0::runtime {
+
+/**
+ * Program input and output over non-blocking file descriptors, e.g. the two
+ * ends of a pipe or a socket used for both. Input is parsed like `cin >>`
+ * parses an int: once a token is not a number or the input has ended, every
+ * read yields 0. Output is buffered and write() only blocks once the buffer
+ * holds `capacity` bytes that the descriptor does not take.
+ */
+class fd_io : public program_io {
+    int input_;
+    int output_;
+    std::string input_buffer_;
+    size_t input_pos_ = 0;
+    bool end_of_input_ = false;
+    bool failed_ = false;
+    std::string output_buffer_;
+    size_t capacity_;
+
+    // false if no input is available yet
+    bool fill();
+public:
+    fd_io(int input, int output, size_t capacity = 4096);
+
+    bool read(int &value) override;
+
+    bool write(int value) override;
+
+    /**
+     * Write as much buffered output as the descriptor takes. Output to a
+     * reader that went away is dropped.
+     * @return false if output is left in the buffer
+     */
+    bool flush();
+
+    int input_fd() const {
+        return input_;
+    }
+
+    int output_fd() const {
+        return output_;
+    }
+};
+
+// throws general_error if the flags cannot be changed
+void set_nonblocking(int fd);
+
+}
+
+#endif //PL0_RUNTIME_FD_IO_H
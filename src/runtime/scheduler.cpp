@@ -0,0 +1,100 @@
+#include "scheduler.h"
+
+namespace pl0::runtime {
+
+namespace {
+
+// the scheduler and queue the calling thread works for, if any
+thread_local const scheduler *current_scheduler = nullptr;
+thread_local size_t current_queue = 0;
+
+}
+
+scheduler::scheduler(int threads) {
+    for (int i = 0; i < (threads < 1 ? 1 : threads); i++)
+        queues_.push_back(std::make_unique<run_queue>());
+}
+
+scheduler::~scheduler() {
+    stop();
+}
+
+void scheduler::start() {
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        stopping_ = false;
+    }
+    for (size_t i = 0; i < queues_.size(); i++)
+        workers_.emplace_back([this, i] { work(i); });
+}
+
+void scheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        stopping_ = true;
+    }
+    idle_.notify_all();
+    for (auto &worker : workers_)
+        worker.join();
+    workers_.clear();
+}
+
+void scheduler::submit(job *j) {
+    size_t index = current_scheduler == this ? current_queue : next_queue_++ % queues_.size();
+    {
+        auto &queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(j);
+    }
+    queued_++;
+    // a worker going to sleep checks queued_ after announcing itself
+    if (sleeping_ > 0) {
+        { std::lock_guard<std::mutex> lock(idle_mutex_); }
+        idle_.notify_one();
+    }
+}
+
+job *scheduler::take(size_t self) {
+    {
+        auto &queue = *queues_[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            auto j = queue.jobs.front();
+            queue.jobs.pop_front();
+            queued_--;
+            return j;
+        }
+    }
+    for (size_t i = 1; i < queues_.size(); i++) {
+        auto &victim = *queues_[(self + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            auto j = victim.jobs.back();
+            victim.jobs.pop_back();
+            queued_--;
+            steals_++;
+            return j;
+        }
+    }
+    return nullptr;
+}
+
+void scheduler::work(size_t self) {
+    current_scheduler = this;
+    current_queue = self;
+    while (true) {
+        if (auto j = take(self)) {
+            j->step();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        sleeping_++;
+        idle_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+        sleeping_--;
+        if (stopping_ && queued_ == 0)
+            break;
+    }
+    current_scheduler = nullptr;
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef PL0_RUNTIME_SCHEDULER_H
+#define PL0_RUNTIME_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pl0::runtime {
+
+/**
+ * Something the scheduler runs for a while, e.g. a program for one time
+ * slice. A job that wants to run again submits itself.
+ */
+class job {
+public:
+    virtual ~job() = default;
+
+    virtual void step() = 0;
+};
+
+/**
+ * Worker threads with a run queue each. A worker takes jobs from the front
+ * of its own queue and, once that is empty, steals from the back of the
+ * others', so a burst of wake-ups handled by one thread spreads out. Jobs a
+ * worker submits go to its own queue, jobs from other threads are dealt out
+ * round-robin.
+ */
+class scheduler {
+    struct run_queue {
+        std::mutex mutex;
+        std::deque<job *> jobs;
+    };
+
+    std::vector<std::unique_ptr<run_queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<long> queued_{0};
+    std::atomic<int> sleeping_{0};
+    std::atomic<unsigned> next_queue_{0};
+    std::atomic<long> steals_{0};
+    std::mutex idle_mutex_;
+    std::condition_variable idle_;
+    bool stopping_ = false;
+
+    job *take(size_t self);
+    void work(size_t self);
+public:
+    explicit scheduler(int threads);
+    ~scheduler();
+
+    scheduler(const scheduler &) = delete;
+    scheduler &operator=(const scheduler &) = delete;
+
+    void start();
+
+    // waits for the run queues to run empty and joins the workers
+    void stop();
+
+    // may be called from any thread
+    void submit(job *j);
+
+    int threads() const {
+        return static_cast<int>(queues_.size());
+    }
+
+    long steals() const {
+        return steals_;
+    }
+};
+
+}
+
+#endif //PL0_RUNTIME_SCHEDULER_H
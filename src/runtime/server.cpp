@@ -0,0 +1,282 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "../bytecode/compiler.h"
+#include "../parsing/parser.h"
+
+namespace pl0::runtime {
+
+namespace {
+
+// blocking, buffered reads and writes on a client socket
+class connection {
+    int fd_;
+    std::string input_;
+    std::string output_;
+    bool closed_ = false;
+
+    bool fill() {
+        char chunk[4096];
+        while (true) {
+            auto count = ::read(fd_, chunk, sizeof chunk);
+            if (count > 0) {
+                input_.append(chunk, static_cast<size_t>(count));
+                return true;
+            }
+            if (count < 0 && errno == EINTR)
+                continue;
+            return false;
+        }
+    }
+public:
+    explicit connection(int fd) : fd_(fd) { }
+
+    ~connection() {
+        flush();
+        close(fd_);
+    }
+
+    bool read_line(std::string &line) {
+        size_t end;
+        while ((end = input_.find('\n')) == std::string::npos) {
+            if (!fill())
+                return false;
+        }
+        line = input_.substr(0, end);
+        input_.erase(0, end + 1);
+        return true;
+    }
+
+    bool read_bytes(size_t count, std::string &bytes) {
+        while (input_.size() < count) {
+            if (!fill())
+                return false;
+        }
+        bytes = input_.substr(0, count);
+        input_.erase(0, count);
+        return true;
+    }
+
+    void write(const std::string &text) {
+        output_ += text;
+        if (output_.size() >= 4096)
+            flush();
+    }
+
+    void flush() {
+        size_t written = 0;
+        while (!closed_ && written < output_.size()) {
+            auto count = ::write(fd_, output_.data() + written, output_.size() - written);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                closed_ = true;
+            else
+                written += static_cast<size_t>(count);
+        }
+        output_.clear();
+    }
+};
+
+// the inputs of a request, then zeros; output streams to the client
+class request_io : public program_io {
+    const std::vector<int> &input_;
+    size_t next_ = 0;
+    connection &client_;
+public:
+    request_io(const std::vector<int> &input, connection &client) : input_(input), client_(client) { }
+
+    bool read(int &value) override {
+        value = next_ < input_.size() ? input_[next_++] : 0;
+        return true;
+    }
+
+    bool write(int value) override {
+        client_.write(std::to_string(value) + '\n');
+        return true;
+    }
+};
+
+std::string single_line(std::string message) {
+    for (auto &ch : message) {
+        if (ch == '\n')
+            ch = ' ';
+    }
+    return message;
+}
+
+}
+
+void server::serve(const std::string &socket_path) {
+    sockaddr_un address{ };
+    if (socket_path.size() >= sizeof address.sun_path)
+        throw general_error("socket path too long: ", socket_path);
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+        throw general_error("cannot create socket: ", std::strerror(errno));
+    // a socket file left over by an earlier daemon
+    unlink(socket_path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof address) < 0 || listen(listener, 128) < 0) {
+        int error = errno;
+        close(listener);
+        throw general_error("cannot listen on ", socket_path, ": ", std::strerror(error));
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    while (true) {
+        int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0 && (errno == EINTR || errno == ECONNABORTED))
+            continue;
+        if (client < 0) {
+            int error = errno;
+            close(listener);
+            throw general_error("accept failed: ", std::strerror(error));
+        }
+        if (connections_.fetch_add(1) >= max_connections) {
+            connections_--;
+            connection{ client }.write("error too many connections\n");
+            continue;
+        }
+        std::thread(&server::serve_connection, this, client).detach();
+    }
+}
+
+std::shared_ptr<server::resident_program> server::compile(const std::string &source) {
+    std::istringstream in(source);
+    lexer lex(in);
+    parser parser(lex);
+    std::unique_ptr<ast::block> program;
+    try {
+        program.reset(parser.program());
+    } catch (general_error &error) {
+        throw general_error(lex.loc().to_string(), ": ", error.what());
+    }
+    code::compiler compiler;
+    compiler.generate(program.get());
+    program.reset();
+    auto result = std::make_shared<resident_program>();
+    result->code = compiler.code();
+    return result;
+}
+
+std::shared_ptr<server::resident_program> server::compile_once(const std::string &source) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = sources_.find(source);
+        if (iter != sources_.end()) {
+            recent_sources_.splice(recent_sources_.begin(), recent_sources_, iter->second.recent);
+            return iter->second.program;
+        }
+    }
+    auto program = compile(source);
+    std::lock_guard<std::mutex> lock(mutex_);
+    // another connection may have compiled it meanwhile
+    auto iter = sources_.find(source);
+    if (iter != sources_.end())
+        return iter->second.program;
+    if (sources_.size() >= max_cached_sources) {
+        sources_.erase(recent_sources_.back());
+        recent_sources_.pop_back();
+    }
+    recent_sources_.push_front(source);
+    sources_.emplace(source, cached_program{ program, recent_sources_.begin() });
+    return program;
+}
+
+std::shared_ptr<server::resident_program> server::find(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = programs_.find(name);
+    if (iter == programs_.end())
+        throw general_error("no program named ", name);
+    return iter->second;
+}
+
+void server::serve_connection(int fd) {
+    struct connection_count {
+        std::atomic<int> &count;
+        ~connection_count() { count--; }
+    } counted{ connections_ };
+    connection client{ fd };
+    std::string line;
+    while (client.read_line(line)) {
+        std::istringstream request(line);
+        std::string command;
+        request >> command;
+        try {
+            std::shared_ptr<resident_program> program;
+            if (command == "compile") {
+                std::string name, source;
+                size_t length;
+                if (!(request >> name >> length))
+                    throw general_error("usage: compile <name> <length>");
+                if (!client.read_bytes(length, source))
+                    return;
+                auto compiled = compile(source);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (programs_.size() >= max_programs && programs_.count(name) == 0)
+                        throw general_error("too many programs, at most ", max_programs);
+                    programs_[name] = compiled;
+                }
+                client.write("ok\n");
+                client.flush();
+                continue;
+            } else if (command == "run") {
+                std::string name;
+                if (!(request >> name))
+                    throw general_error("usage: run <name> <input>...");
+                program = find(name);
+            } else if (command == "exec") {
+                std::string source;
+                size_t length;
+                if (!(request >> length))
+                    throw general_error("usage: exec <length> <input>...");
+                if (!client.read_bytes(length, source))
+                    return;
+                program = compile_once(source);
+            } else {
+                throw general_error("unknown request: ", command);
+            }
+
+            std::vector<int> input;
+            int value;
+            while (request >> value)
+                input.push_back(value);
+            if (!request.eof())
+                throw general_error("inputs must be integers");
+
+            std::unique_ptr<machine> vm;
+            {
+                std::lock_guard<std::mutex> lock(program->mutex);
+                if (!program->idle.empty()) {
+                    vm = std::move(program->idle.back());
+                    program->idle.pop_back();
+                }
+            }
+            request_io io{ input, client };
+            if (vm)
+                vm->restart(&io);
+            else
+                vm = std::make_unique<machine>(program->code, nullptr, nullptr, &io);
+            auto status = vm->run(fuel_);
+            client.write(status == machine::status::finished ? "done\n" : "error the program ran out of fuel\n");
+            std::lock_guard<std::mutex> lock(program->mutex);
+            program->idle.push_back(std::move(vm));
+        } catch (basic_error &error) {
+            client.write("error " + single_line(error.what()) + '\n');
+        }
+        client.flush();
+    }
+}
+
+}
@@ -0,0 +1,73 @@
+#ifndef PL0_RUNTIME_SERVER_H
+#define PL0_RUNTIME_SERVER_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../vm.h"
+
+namespace pl0::runtime {
+
+/**
+ * Keeps compiled programs resident and runs them for clients of a Unix
+ * domain socket, so a short script costs neither process startup nor
+ * compilation. A connection sends any number of requests, one at a time:
+ *
+ *     compile <name> <length>\n<source>   ok | error <message>
+ *     run <name> <input>...\n             the written values, one per line,
+ *                                         then done | error <message>
+ *     exec <length> <input>...\n<source>  compile (once per source) and run
+ *
+ * A program reads its inputs in order and 0 once they are used up. Each
+ * resident program keeps the machines of finished runs for the next ones.
+ *
+ * Memory stays bounded however long the daemon runs: at most
+ * max_programs names can be compiled, exec keeps the programs of the
+ * max_cached_sources sources used last, and a client that connects while
+ * max_connections others are served is answered with an error.
+ */
+class server {
+    struct resident_program {
+        bytecode code;
+        std::mutex mutex;
+        std::vector<std::unique_ptr<machine>> idle;
+    };
+
+    struct cached_program {
+        std::shared_ptr<resident_program> program;
+        // position in recent_sources_
+        std::list<std::string>::iterator recent;
+    };
+
+    long fuel_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<resident_program>> programs_;
+    std::unordered_map<std::string, cached_program> sources_;
+    // the sources of sources_, the one used last first
+    std::list<std::string> recent_sources_;
+    std::atomic<int> connections_{ 0 };
+
+    void serve_connection(int fd);
+    // throws basic_error if the source does not compile
+    static std::shared_ptr<resident_program> compile(const std::string &source);
+    std::shared_ptr<resident_program> compile_once(const std::string &source);
+    std::shared_ptr<resident_program> find(const std::string &name);
+public:
+    static constexpr size_t max_programs = 1024;
+    static constexpr size_t max_cached_sources = 256;
+    static constexpr int max_connections = 64;
+
+    explicit server(long fuel = machine::unlimited) : fuel_(fuel) { }
+
+    // accepts clients until the socket fails; throws general_error then
+    void serve(const std::string &socket_path);
+};
+
+}
+
+#endif //PL0_RUNTIME_SERVER_H
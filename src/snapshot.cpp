@@ -0,0 +1,154 @@
+#include <cstdint>
+#include <cstring>
+
+#include "snapshot.h"
+#include "util.h"
+
+namespace pl0 {
+
+namespace {
+
+const char magic[8] = { 'P', 'L', '0', 'S', 'N', 'A', 'P', 1 };
+
+// FNV-1a over the instructions
+uint64_t fingerprint(const bytecode &code) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](int value) {
+        auto bits = static_cast<uint32_t>(value);
+        for (int i = 0; i < 4; i++) {
+            hash ^= (bits >> (8 * i)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    };
+    for (auto &ins : code) {
+        mix(static_cast<int>(ins.op));
+        mix(ins.level);
+        mix(ins.address);
+    }
+    return hash;
+}
+
+// unsigned LEB128; signed values are zigzag encoded first
+class writer {
+    std::ostream &out_;
+public:
+    explicit writer(std::ostream &out) : out_(out) { }
+
+    void put(uint64_t value) {
+        do {
+            auto byte = static_cast<uint8_t>(value & 0x7f);
+            value >>= 7;
+            out_.put(static_cast<char>(value ? byte | 0x80 : byte));
+        } while (value);
+    }
+
+    void put_signed(int value) {
+        auto bits = static_cast<uint32_t>(value);
+        put((bits << 1) ^ (value < 0 ? 0xffffffffu : 0u));
+    }
+
+    void put_list(const std::vector<int> &values) {
+        put(values.size());
+        for (int value : values)
+            put_signed(value);
+    }
+};
+
+class reader {
+    std::istream &in_;
+public:
+    explicit reader(std::istream &in) : in_(in) { }
+
+    uint64_t get() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int byte = in_.get();
+            if (byte == EOF)
+                throw general_error("snapshot file is truncated");
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw general_error("malformed snapshot file");
+    }
+
+    int get_int() {
+        auto value = get();
+        if (value > INT32_MAX)
+            throw general_error("malformed snapshot file");
+        return static_cast<int>(value);
+    }
+
+    // for positions stored plus one, so that -1 fits
+    int get_position() {
+        return get_int() - 1;
+    }
+
+    int get_signed() {
+        auto value = get();
+        if (value > UINT32_MAX)
+            throw general_error("malformed snapshot file");
+        auto bits = static_cast<uint32_t>(value);
+        return static_cast<int>((bits >> 1) ^ (bits & 1 ? 0xffffffffu : 0u));
+    }
+
+    std::vector<int> get_list() {
+        auto count = get();
+        std::vector<int> values;
+        for (uint64_t i = 0; i < count; i++)
+            values.push_back(get_signed());
+        return values;
+    }
+};
+
+}
+
+void save_snapshot(std::ostream &out, const bytecode &code, const snapshot &image) {
+    out.write(magic, sizeof magic);
+    writer w{ out };
+    w.put(fingerprint(code));
+    w.put(image.state.program_counter);
+    w.put(image.state.frames.size());
+    for (auto &frame : image.state.frames) {
+        w.put(frame.return_address);
+        w.put(frame.level);
+        w.put(frame.saved_display + 1);
+        w.put(frame.static_entry + 1);
+        w.put_list(frame.locals);
+        w.put_list(frame.intermediates);
+    }
+    w.put(image.state.display.size());
+    for (int position : image.state.display)
+        w.put(position + 1);
+    w.put_list(image.output);
+}
+
+snapshot load_snapshot(std::istream &in, const bytecode &code) {
+    char header[sizeof magic];
+    if (!in.read(header, sizeof header) || std::memcmp(header, magic, sizeof magic) != 0)
+        throw general_error("not a snapshot file");
+    reader r{ in };
+    if (r.get() != fingerprint(code))
+        throw general_error("the snapshot was taken from a different program");
+
+    snapshot image;
+    image.state.program_counter = r.get_int();
+    auto frame_count = r.get();
+    for (uint64_t i = 0; i < frame_count; i++) {
+        frame_state frame;
+        frame.return_address = r.get_int();
+        frame.level = r.get_int();
+        frame.saved_display = r.get_position();
+        frame.static_entry = r.get_position();
+        frame.locals = r.get_list();
+        frame.intermediates = r.get_list();
+        image.state.frames.push_back(std::move(frame));
+    }
+    auto display_size = r.get();
+    for (uint64_t i = 0; i < display_size; i++)
+        image.state.display.push_back(r.get_position());
+    image.output = r.get_list();
+    return image;
+}
+
+}
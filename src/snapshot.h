@@ -0,0 +1,52 @@
+#ifndef PL0_SNAPSHOT_H
+#define PL0_SNAPSHOT_H
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "vm.h"
+
+namespace pl0 {
+
+/**
+ * A machine state together with the output the program produced before
+ * it, so that a restored program writes exactly what the original would
+ * have. Snapshots are stored in a compact binary format tied to the code
+ * they were taken from: restoring one for other code is an error.
+ */
+struct snapshot {
+    machine_state state;
+    std::vector<int> output;
+};
+
+void save_snapshot(std::ostream &out, const bytecode &code, const snapshot &image);
+
+// throws general_error if the file is malformed or was taken from other code
+snapshot load_snapshot(std::istream &in, const bytecode &code);
+
+/**
+ * Collects a program's output and never has input for it, so a machine
+ * using it stops at its first read: the point to snapshot a program that
+ * initializes itself before reading input.
+ */
+class output_recorder : public program_io {
+    std::vector<int> output_;
+public:
+    bool read(int &) override {
+        return false;
+    }
+
+    bool write(int value) override {
+        output_.push_back(value);
+        return true;
+    }
+
+    const std::vector<int> &output() const {
+        return output_;
+    }
+};
+
+}
+
+#endif //PL0_SNAPSHOT_H
@@ -0,0 +1,90 @@
+#include <iomanip>
+
+#include "statistics.h"
+#include "util.h"
+
+namespace pl0 {
+
+namespace allocation_counter {
+
+std::atomic<bool> counting{ false };
+thread_local allocation_counts counts{ 0, 0 };
+
+}
+
+allocation_counts allocated() {
+    return allocation_counter::counts;
+}
+
+void compile_statistics::add_phase(std::string name, double seconds, allocation_counts allocated,
+                                   const char *part_of) {
+    phases_.push_back({ std::move(name), seconds, allocated, part_of });
+}
+
+void compile_statistics::count(std::string name, uint64_t value) {
+    counts_.emplace_back(std::move(name), value);
+}
+
+void compile_statistics::report(std::ostream &out) const {
+    double total_seconds = 0;
+    allocation_counts total{ 0, 0 };
+    out << std::left << std::setw(16) << "phase" << std::right << std::setw(12) << "wall ms"
+        << std::setw(14) << "allocations" << std::setw(14) << "bytes" << '\n';
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    for (auto &p : phases_) {
+        out << std::left << std::setw(16) << (p.part_of ? p.name + " (" + p.part_of + ')' : p.name) << std::right
+            << std::setw(12) << p.seconds * 1e3 << std::setw(14) << p.allocated.allocations << std::setw(14)
+            << p.allocated.bytes << '\n';
+        if (p.part_of)
+            continue;
+        total_seconds += p.seconds;
+        total.allocations += p.allocated.allocations;
+        total.bytes += p.allocated.bytes;
+    }
+    out << std::left << std::setw(16) << "total" << std::right << std::setw(12) << total_seconds * 1e3
+        << std::setw(14) << total.allocations << std::setw(14) << total.bytes << '\n';
+    out.flags(flags);
+    out.precision(precision);
+    for (auto &[name, value] : counts_)
+        out << std::left << std::setw(16) << name << std::right << std::setw(12) << value << '\n';
+}
+
+void compile_statistics::report_json(std::ostream &out) const {
+    out << "{\n  \"phases\": [";
+    for (size_t i = 0; i < phases_.size(); i++) {
+        auto &p = phases_[i];
+        out << (i ? ",\n" : "\n") << "    { \"name\": " << quoted(p.name)
+            << ", \"wall_ns\": " << static_cast<long long>(p.seconds * 1e9)
+            << ", \"allocations\": " << p.allocated.allocations << ", \"bytes\": " << p.allocated.bytes;
+        if (p.part_of)
+            out << ", \"part_of\": " << quoted(p.part_of);
+        out << " }";
+    }
+    out << "\n  ],\n  \"counts\": {";
+    for (size_t i = 0; i < counts_.size(); i++)
+        out << (i ? ",\n" : "\n") << "    " << quoted(counts_[i].first) << ": " << counts_[i].second;
+    out << "\n  }\n}\n";
+}
+
+phase_timer::phase_timer(compile_statistics &statistics, const char *name, const char *part_of)
+        : statistics_(statistics), name_(name), part_of_(part_of), allocated_{ 0, 0 }, counting_(false) {
+    if (!statistics_.enabled())
+        return;
+    counting_ = allocation_counter::counting.exchange(true, std::memory_order_relaxed);
+    allocated_ = allocated();
+    start_ = std::chrono::steady_clock::now();
+}
+
+phase_timer::~phase_timer() {
+    if (!statistics_.enabled())
+        return;
+    auto stop = std::chrono::steady_clock::now();
+    auto now = allocated();
+    allocation_counter::counting.store(counting_, std::memory_order_relaxed);
+    statistics_.add_phase(name_, std::chrono::duration<double>(stop - start_).count(),
+                          { now.allocations - allocated_.allocations, now.bytes - allocated_.bytes }, part_of_);
+}
+
+}
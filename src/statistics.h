@@ -0,0 +1,87 @@
+#ifndef PL0_STATISTICS_H
+#define PL0_STATISTICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pl0 {
+
+struct allocation_counts {
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+/**
+ * Where an executable's own operator new counts what each thread allocates
+ * while a phase_timer measures. The library replaces no allocation
+ * functions, so the counts stay zero in executables that do not count, see
+ * allocation-counter.cpp of PL0.
+ */
+namespace allocation_counter {
+
+extern std::atomic<bool> counting;
+extern thread_local allocation_counts counts;
+
+}
+
+// what the calling thread has allocated while a phase_timer was measuring
+allocation_counts allocated();
+
+/**
+ * Wall time and allocations of each phase of the compiler, and the sizes of
+ * what the phases produced, for --time-passes and --stats. A disabled
+ * instance measures nothing.
+ */
+class compile_statistics {
+    struct phase {
+        std::string name;
+        double seconds;
+        allocation_counts allocated;
+        // the phase this one was measured again as part of, if any
+        const char *part_of;
+    };
+
+    bool enabled_;
+    std::vector<phase> phases_;
+    std::vector<std::pair<std::string, uint64_t>> counts_;
+public:
+    explicit compile_statistics(bool enabled) : enabled_(enabled) { }
+
+    bool enabled() const { return enabled_; }
+
+    void add_phase(std::string name, double seconds, allocation_counts allocated, const char *part_of = nullptr);
+
+    void count(std::string name, uint64_t value);
+
+    void report(std::ostream &out) const;
+
+    void report_json(std::ostream &out) const;
+};
+
+/**
+ * Measures the phase from its construction to its destruction. A phase
+ * that is also part of another one, e.g. lexing of parsing, names that
+ * phase and is left out of the total.
+ */
+class phase_timer {
+    compile_statistics &statistics_;
+    const char *name_;
+    const char *part_of_;
+    std::chrono::steady_clock::time_point start_;
+    allocation_counts allocated_;
+    bool counting_;
+public:
+    phase_timer(compile_statistics &statistics, const char *name, const char *part_of = nullptr);
+    ~phase_timer();
+
+    phase_timer(const phase_timer &) = delete;
+    phase_timer &operator=(const phase_timer &) = delete;
+};
+
+}
+
+#endif //PL0_STATISTICS_H
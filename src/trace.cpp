@@ -0,0 +1,156 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <unistd.h>
+
+#include "trace.h"
+#include "util.h"
+
+namespace pl0 {
+
+namespace {
+
+const char magic[8] = { 'P', 'L', '0', 'T', 'R', 'A', 'C', 'E' };
+const uint32_t version = 2;
+
+struct trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reason;
+    uint32_t signal;
+    uint32_t capacity;
+    uint64_t recorded;
+};
+
+bool write_all(int fd, const void *data, size_t size) {
+    auto bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        auto count = ::write(fd, bytes, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        bytes += count;
+        size -= static_cast<size_t>(count);
+    }
+    return true;
+}
+
+// set up by dump_trace_on_signals(), read by the handler
+const trace_buffer *signal_trace = nullptr;
+int signal_fd = -1;
+std::atomic<bool> dumped{ false };
+
+extern "C" void dump_and_die(int signal) {
+    if (!dumped.exchange(true))
+        signal_trace->dump(signal_fd, trace_buffer::dump_reason::signal, signal);
+    // the handler was reset, so this kills us once the handler returns
+    raise(signal);
+}
+
+}
+
+trace_buffer::trace_buffer(uint32_t capacity) {
+    uint64_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+    entries_.resize(size);
+    mask_ = size - 1;
+}
+
+bool trace_buffer::dump(int fd, dump_reason reason, int signal) const {
+    auto recorded = this->recorded();
+    uint64_t capacity = entries_.size();
+    trace_header header{ };
+    std::memcpy(header.magic, magic, sizeof magic);
+    header.version = version;
+    header.reason = static_cast<uint32_t>(reason);
+    header.signal = static_cast<uint32_t>(signal);
+    header.capacity = static_cast<uint32_t>(capacity);
+    header.recorded = recorded;
+    if (!write_all(fd, &header, sizeof header))
+        return false;
+    // oldest first: the ring may have wrapped around
+    auto count = recorded < capacity ? recorded : capacity;
+    auto first = (recorded - count) & mask_;
+    auto tail = capacity - first < count ? capacity - first : count;
+    return write_all(fd, entries_.data() + first, tail * sizeof(trace_entry)) &&
+           write_all(fd, entries_.data(), (count - tail) * sizeof(trace_entry));
+}
+
+void dump_trace_on_signals(const trace_buffer &trace, int fd) {
+    signal_trace = &trace;
+    signal_fd = fd;
+    struct sigaction action{ };
+    action.sa_handler = dump_and_die;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    for (int signal : { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, SIGINT, SIGTERM })
+        sigaction(signal, &action, nullptr);
+}
+
+void dump_trace_once(const trace_buffer &trace, int fd, trace_buffer::dump_reason reason) {
+    if (!dumped.exchange(true))
+        trace.dump(fd, reason);
+}
+
+void decode_trace(std::istream &in, std::ostream &out, const line_table *lines) {
+    trace_header header{ };
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof header) ||
+        std::memcmp(header.magic, magic, sizeof magic) != 0)
+        throw general_error("not a trace file");
+    if (header.version != version)
+        throw general_error("unsupported trace file version");
+    if (header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0)
+        throw general_error("malformed trace file");
+
+    uint64_t count = header.recorded < header.capacity ? header.recorded : header.capacity;
+    out << "last " << count << " of " << header.recorded << " control transfers, written ";
+    switch (static_cast<trace_buffer::dump_reason>(header.reason)) {
+    case trace_buffer::dump_reason::exit:
+        out << "on exit\n";
+        break;
+    case trace_buffer::dump_reason::error:
+        out << "on error\n";
+        break;
+    case trace_buffer::dump_reason::signal:
+        out << "on signal " << header.signal << " (" << strsignal(static_cast<int>(header.signal)) << ")\n";
+        break;
+    default:
+        throw general_error("malformed trace file");
+    }
+
+    // the instructions from the previous target up to an entry ran in order
+    out << std::setw(12) << "#" << std::setw(8) << "from" << std::setw(8) << "pc" << "  " << std::left
+        << std::setw(4) << "op" << std::right << std::setw(7) << "depth" << std::setw(8) << "to";
+    if (lines)
+        out << std::setw(7) << "line";
+    out << '\n';
+    auto opcode_count = sizeof opcode_name / sizeof opcode_name[0];
+    // unknown for the oldest entry once the ring has wrapped around
+    int64_t from = header.recorded > count ? -1 : 0;
+    for (uint64_t i = 0; i < count; i++) {
+        trace_entry entry{ };
+        if (!in.read(reinterpret_cast<char *>(&entry), sizeof entry))
+            throw general_error("trace file is truncated");
+        auto op = entry.op_depth >> 28;
+        if (op >= opcode_count)
+            throw general_error("malformed trace file");
+        // a return is the only operation that transfers control
+        auto name = static_cast<opcode>(op) == opcode::OPR ? "RET" : opcode_name[op];
+        out << std::setw(12) << header.recorded - count + i << std::setw(8);
+        if (from >= 0)
+            out << from;
+        else
+            out << "";
+        out << std::setw(8) << entry.program_counter << "  " << std::left << std::setw(4) << name << std::right
+            << std::setw(7) << (entry.op_depth & trace_buffer::max_depth) << std::setw(8) << entry.target;
+        if (lines)
+            out << std::setw(7) << lines->line(entry.program_counter);
+        out << '\n';
+        from = entry.target;
+    }
+}
+
+}
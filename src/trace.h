@@ -0,0 +1,95 @@
+#ifndef PL0_TRACE_H
+#define PL0_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "bytecode/bytecode.h"
+
+namespace pl0 {
+
+struct trace_entry {
+    int32_t program_counter;
+    // where control went: the callee, the jump target, the next instruction
+    // of a conditional jump that fell through, or the return address
+    int32_t target;
+    // opcode in the top 4 bits, frame depth below
+    uint32_t op_depth;
+};
+
+/**
+ * The last control transfers a machine made, kept in a fixed-size ring so
+ * that memory stays bounded however long the program runs. Only calls,
+ * jumps, conditional jumps and returns are recorded: the instructions in
+ * between run in order, from the target of one entry to the next entry, so
+ * the entries still give the whole path at a fraction of the cost of
+ * recording every instruction. A single machine writes at a time and
+ * publishes each entry with one atomic store; dump() reads without locks
+ * and is async-signal-safe, so a crash handler can save the trace of the
+ * path that led to the crash.
+ *
+ * A dump is a header (magic "PL0TRACE", version, why it was written, the
+ * signal if any, capacity and the number of transfers ever recorded)
+ * followed by the entries still in the ring, oldest first, in the byte
+ * order of the host.
+ */
+class trace_buffer {
+    std::vector<trace_entry> entries_;
+    uint64_t mask_;
+    std::atomic<uint64_t> recorded_{ 0 };
+public:
+    enum class dump_reason : uint32_t { exit, error, signal };
+
+    static constexpr uint32_t max_depth = (1u << 28) - 1;
+
+    // the capacity is rounded up to a power of two
+    explicit trace_buffer(uint32_t capacity);
+
+    /**
+     * The machine's end of the buffer while it runs. It keeps its own copy
+     * of the position, so recording a transfer is two stores.
+     */
+    class writer {
+        trace_entry *entries_;
+        uint64_t mask_;
+        uint64_t recorded_;
+        std::atomic<uint64_t> *published_;
+    public:
+        explicit writer(trace_buffer *buffer)
+                : entries_(buffer ? buffer->entries_.data() : nullptr), mask_(buffer ? buffer->mask_ : 0),
+                  recorded_(buffer ? buffer->recorded() : 0), published_(buffer ? &buffer->recorded_ : nullptr) { }
+
+        void record(int program_counter, opcode op, int depth, int target) {
+            auto clamped = depth < static_cast<int>(max_depth) ? static_cast<uint32_t>(depth) : max_depth;
+            entries_[recorded_ & mask_] = { program_counter, target, static_cast<uint32_t>(op) << 28 | clamped };
+            published_->store(++recorded_, std::memory_order_release);
+        }
+    };
+
+    uint64_t recorded() const {
+        return recorded_.load(std::memory_order_acquire);
+    }
+
+    // returns false if writing failed
+    bool dump(int fd, dump_reason reason, int signal = 0) const;
+};
+
+/**
+ * Dump the trace to the file descriptor if a fatal signal (or SIGINT or
+ * SIGTERM) arrives, then die of the signal as before. Only the first of
+ * these dumps and dump_trace_once() writes the file.
+ */
+void dump_trace_on_signals(const trace_buffer &trace, int fd);
+
+void dump_trace_once(const trace_buffer &trace, int fd, trace_buffer::dump_reason reason);
+
+// prints a dump as text, with the source line of each transfer if the line
+// table of the traced code is given; throws general_error if it is malformed
+void decode_trace(std::istream &in, std::ostream &out, const line_table *lines = nullptr);
+
+}
+
+#endif //PL0_TRACE_H
@@ -2,6 +2,7 @@
 #define PL_ZERO_UTIL_H
 
 #include <sstream>
+#include <string>
 
 namespace pl0 {
 
@@ -58,6 +59,21 @@ inline std::string concat(Args ... args) {
 
 #endif
 
+// a double-quoted string that is valid both in JSON and as a Prometheus label value
+inline std::string quoted(const std::string &str) {
+    std::string result = "\"";
+    for (char ch : str) {
+        if (ch == '\n') {
+            result += "\\n";
+            continue;
+        }
+        if (ch == '"' || ch == '\\')
+            result.push_back('\\');
+        result.push_back(ch);
+    }
+    return result + '"';
+}
+
 struct location {
     int line = 1;
     int column = 1;
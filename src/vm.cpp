@@ -1,61 +1,460 @@
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "vm.h"
+#include "bytecode/verifier.h"
+#include "memo-cache.h"
+#include "util.h"
 
-void pl0::execute(const bytecode & code) {
-    int program_counter = 0;
+pl0::machine::machine(const bytecode &code, procedure_profiler *profiler, memo_cache *memo, program_io *io)
+        : machine(code, code::verifier{ }.verify(code), profiler, memo, io) { }
+
+pl0::machine::machine(const bytecode &code, bool verified, procedure_profiler *profiler, memo_cache *memo,
+                      program_io *io)
+        : code_(code), profiler_(profiler), memo_(memo), io_(io), static_frames_(code.size(), nullptr),
+          verified_(verified), checked_(!verified_) {
+    enter_main();
+}
+
+pl0::machine::~machine() {
+    release_frames();
+    for (auto frame : static_frames_)
+        delete frame;
+}
+
+void pl0::machine::enter_main() {
+    program_counter_ = 0;
+    top_frame_ = new stack_frame{ static_cast<int>(code_.size()), nullptr, 0 };
+    frames_ = display{ };
+    frames_.enter(top_frame_);
+    if (profiler_)
+        profiler_->enter(program_counter_);
+}
+
+void pl0::machine::release_frames() {
+    // a suspended program still has its dynamic chain
+    for (auto frame = top_frame_; frame != nullptr; ) {
+        auto caller = frame->caller();
+        if (!frame->is_static())
+            delete frame;
+        frame = caller;
+    }
+    top_frame_ = nullptr;
+}
+
+void pl0::machine::restart(program_io *io) {
+    release_frames();
+    io_ = io;
+    checked_ = !verified_;
+    enter_main();
+}
+
+uint64_t pl0::machine::frame_bytes(const stack_frame *frame) {
+    return sizeof(stack_frame) + frame->locals_.size() * sizeof(frame->locals_[0]);
+}
+
+void pl0::machine::set_metrics(run_metrics *metrics) {
+    metrics_ = metrics;
+    if (metrics_ && top_frame_ != nullptr && top_frame_->caller() == nullptr && program_counter_ == 0)
+        metrics_->start(frame_bytes(top_frame_));
+}
+
+pl0::machine_state pl0::machine::capture() const {
+    std::vector<stack_frame *> chain;
+    for (auto frame = top_frame_; frame != nullptr; frame = frame->dynamic_link_)
+        chain.push_back(frame);
+    std::reverse(chain.begin(), chain.end());
+    std::unordered_map<const stack_frame *, int> positions;
+    for (size_t i = 0; i < chain.size(); i++)
+        positions[chain[i]] = static_cast<int>(i);
+    auto position = [&positions](const stack_frame *frame) {
+        if (frame == nullptr)
+            return -1;
+        // the display only ever refers to active frames
+        auto iter = positions.find(frame);
+        if (iter == positions.end())
+            throw general_error("frame outside of the dynamic chain");
+        return iter->second;
+    };
+    std::unordered_map<const stack_frame *, int> static_entries;
+    for (size_t entry = 0; entry < static_frames_.size(); entry++) {
+        if (static_frames_[entry] != nullptr)
+            static_entries[static_frames_[entry]] = static_cast<int>(entry);
+    }
+
+    machine_state state;
+    state.program_counter = program_counter_;
+    for (auto frame : chain) {
+        frame_state saved;
+        saved.return_address = frame->return_address_;
+        saved.level = frame->level_;
+        saved.saved_display = position(frame->saved_display_);
+        saved.static_entry = frame->static_ ? static_entries.at(frame) : -1;
+        for (auto &local : frame->locals_)
+            saved.locals.push_back(local.second);
+        saved.intermediates = frame->intermediates_;
+        state.frames.push_back(std::move(saved));
+    }
+    for (auto frame : frames_.frames_)
+        state.display.push_back(position(frame));
+    return state;
+}
+
+void pl0::machine::resume(const machine_state &state) {
+    auto code_length = static_cast<int>(code_.size());
+    auto frame_count = static_cast<int>(state.frames.size());
+    auto check = [](bool valid) {
+        if (!valid)
+            throw general_error("the machine state does not fit the program");
+    };
+    check(state.program_counter >= 0 && state.program_counter <= code_length);
+    check(frame_count > 0 || state.program_counter == code_length);
+    // returning from main has to end the program, as no frame is left to run in
+    check(frame_count == 0 || (state.frames[0].return_address == code_length && state.frames[0].level == 0 &&
+                               state.frames[0].static_entry < 0));
+    std::unordered_set<int> static_entries;
+    for (int i = 0; i < frame_count; i++) {
+        auto &saved = state.frames[i];
+        check(saved.return_address >= 0 && saved.return_address <= code_length);
+        check(saved.level >= 0 && saved.level < static_cast<int>(state.display.size()));
+        check(saved.saved_display >= -1 && saved.saved_display < i);
+        check(saved.static_entry >= -1 && saved.static_entry < code_length);
+        if (saved.static_entry >= 0)
+            check(static_entries.insert(saved.static_entry).second);
+    }
+    for (int position : state.display)
+        check(position >= -1 && position < frame_count);
+
+    release_frames();
+    std::vector<stack_frame *> chain;
+    for (auto &saved : state.frames) {
+        auto caller = chain.empty() ? nullptr : chain.back();
+        stack_frame *frame;
+        if (saved.static_entry >= 0) {
+            auto &slot = static_frames_[saved.static_entry];
+            if (slot == nullptr)
+                slot = new stack_frame{ saved.return_address, caller, saved.level, true };
+            else
+                slot->restart(saved.return_address, caller, saved.level);
+            frame = slot;
+        } else {
+            frame = new stack_frame{ saved.return_address, caller, saved.level };
+        }
+        frame->saved_display_ = saved.saved_display < 0 ? nullptr : chain[saved.saved_display];
+        frame->locals_.clear();
+        for (int value : saved.locals)
+            frame->locals_.emplace_back(std::string{ }, value);
+        frame->intermediates_ = saved.intermediates;
+        chain.push_back(frame);
+    }
+    frames_ = display{ };
+    for (int position : state.display)
+        frames_.frames_.push_back(position < 0 ? nullptr : chain[position]);
+    top_frame_ = chain.empty() ? nullptr : chain.back();
+    program_counter_ = state.program_counter;
+    // nothing proves the frames have what the code expects
+    checked_ = true;
+}
+
+namespace {
+
+template <size_t features>
+using policy_for = pl0::interpreter_policy<(features & 1) != 0, (features & 2) != 0, (features & 4) != 0,
+                                           (features & 8) != 0, (features & 16) != 0>;
+
+}
+
+template <size_t... features>
+std::array<pl0::machine::loop, 32> pl0::machine::loops(std::index_sequence<features...>) {
+    std::array<loop, 32> table{ };
+    // every other combination runs on a loop with checks, hooks, fuel and
+    // metrics compiled in, which is right whether or not they are in use; the
+    // trace is written without a test, so traced runs also get it compiled in
+    for (size_t i = 0; i < table.size(); i++) {
+        table[i] = (i & 8) != 0 ? &machine::interpret<policy_for<31>>
+                                : &machine::interpret<policy_for<31 & ~8>>;
+    }
+    ((table[features] = &machine::interpret<policy_for<features>>), ...);
+    return table;
+}
+
+pl0::machine::status pl0::machine::run(long fuel) {
+    // plain, unverified, profiled or memoized, fueled as on the daemon and the
+    // event loop, restored with fuel, traced and measured runs
+    static const auto table = loops(std::index_sequence<0, 1, 2, 4, 5, 8, 16>{ });
+    size_t features = (checked_ ? 1 : 0) | (profiler_ != nullptr || memo_ != nullptr ? 2 : 0) |
+                      (fuel != unlimited ? 4 : 0) | (trace_ != nullptr ? 8 : 0) | (metrics_ != nullptr ? 16 : 0);
+    if (metrics_ == nullptr)
+        return (this->*table[features])(fuel);
+    auto start = std::chrono::steady_clock::now();
+    try {
+        auto result = (this->*table[features])(fuel);
+        metrics_->add_time(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        return result;
+    } catch (...) {
+        metrics_->add_time(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        throw;
+    }
+}
+
+template <typename policy>
+pl0::machine::status pl0::machine::run_with(long fuel) {
+    if (checked_ && !policy::checks)
+        throw general_error("unverified code needs a policy with checks");
+    return interpret<policy>(fuel);
+}
+
+template <typename policy>
+pl0::machine::status pl0::machine::interpret(long fuel) {
+    auto &code = code_;
+    auto profiler = profiler_;
+    auto memo = memo_;
+    auto io = io_;
+    auto &frames = frames_;
+    auto &static_frames = static_frames_;
+    int program_counter = program_counter_;
+    auto *top_frame = top_frame_;
     auto code_length = static_cast<int>(code.size());
-    auto *top_frame = new stack_frame{ code_length, nullptr, nullptr };
+    trace_buffer::writer trace{ policy::trace ? trace_ : nullptr };
+    auto metrics = metrics_;
+    // length of the dynamic chain, only kept for the trace and the metrics
+    int depth = 0;
+    if (policy::trace || policy::metrics) {
+        for (auto frame = top_frame; frame != nullptr; frame = frame->caller())
+            depth++;
+    }
+    auto leave = [&]() {
+        if (policy::hooks && memo)
+            memo->leave(top_frame);
+        if (policy::metrics && metrics)
+            metrics->leave(frame_bytes(top_frame));
+        frames.leave(top_frame);
+        top_frame->leave(program_counter, top_frame);
+        if (policy::hooks && profiler)
+            profiler->leave();
+        if (policy::trace || policy::metrics)
+            depth--;
+    };
+    // only called between instructions, so run() simply continues from here
+    auto suspend = [&](status reason = status::suspended) {
+        program_counter_ = program_counter;
+        top_frame_ = top_frame;
+        return reason;
+    };
+    // without checks the loop never fails, so the compiler drops the tests
+    auto check = [&](bool valid, const char *what) {
+        if (policy::checks && !valid) {
+            suspend();
+            throw general_error("invalid bytecode at ", program_counter - 1, ": ", what);
+        }
+    };
+    auto pop = [&]() {
+        check(!top_frame->intermediates_.empty(), "the stack underflows");
+        return top_frame->pop();
+    };
+    auto local = [&](const instruction &ins) -> int & {
+        int level = top_frame->level() - ins.level;
+        check(ins.level >= 0 && level >= 0 && frames[level] != nullptr, "level out of range");
+        auto frame = frames[level];
+        check(ins.address >= 0 && ins.address < static_cast<int>(frame->locals_.size()), "local index out of range");
+        return frame->local(ins.address);
+    };
+    auto callee_level = [&](const instruction &ins) {
+        check(ins.address >= 0 && ins.address < code_length, "call target out of range");
+        check(ins.level >= 0 && ins.level <= top_frame->level(), "call level out of range");
+        return top_frame->level() - ins.level + 1;
+    };
+    auto jump_target = [&](const instruction &ins) {
+        check(ins.address >= 0 && ins.address <= code_length, "jump target out of range");
+        return ins.address;
+    };
 
     while (program_counter < code_length) {
         auto ins = code[program_counter++];
+        if (policy::hooks && profiler)
+            profiler->step(program_counter - 1, ins.op);
+        if (policy::metrics && metrics)
+            metrics->step();
 
         switch (ins.op) {
         case opcode::LIT:
             top_frame->push(ins.address);
             break;
         case opcode::LOD:
-            top_frame->push(top_frame->local(ins.level, ins.address));
+            top_frame->push(local(ins));
             break;
-        case opcode::STO:
-            top_frame->local(ins.level, ins.address) = top_frame->pop();
+        case opcode::STO: {
+            int value = pop();
+            local(ins) = value;
             break;
-        case opcode::CAL:
-            top_frame = new stack_frame{ program_counter, top_frame, top_frame->resolve(ins.level) };
+        }
+        case opcode::CAL: {
+            int level = callee_level(ins);
+            if (policy::hooks && memo && memo->lookup(ins.address, frames))
+                break;
+            if (policy::trace)
+                trace.record(program_counter - 1, ins.op, depth, ins.address);
+            top_frame = new stack_frame{ program_counter, top_frame, level };
+            frames.enter(top_frame);
+            if (policy::trace || policy::metrics)
+                depth++;
+            if (policy::metrics && metrics)
+                metrics->call(ins.address, depth, frame_bytes(top_frame));
+            if (policy::hooks && memo)
+                memo->enter(top_frame);
             program_counter = ins.address;
+            if (policy::hooks && profiler)
+                profiler->enter(program_counter);
+            if (policy::fuel && --fuel <= 0)
+                return suspend();
             break;
+        }
+        case opcode::SCL: {
+            int level = callee_level(ins);
+            if (policy::hooks && memo && memo->lookup(ins.address, frames))
+                break;
+            if (policy::trace)
+                trace.record(program_counter - 1, ins.op, depth, ins.address);
+            auto &frame = static_frames[ins.address];
+            if (frame == nullptr)
+                frame = new stack_frame{ program_counter, top_frame, level, true };
+            else
+                frame->restart(program_counter, top_frame, level);
+            top_frame = frame;
+            frames.enter(top_frame);
+            if (policy::trace || policy::metrics)
+                depth++;
+            if (policy::metrics && metrics)
+                metrics->call(ins.address, depth, frame_bytes(top_frame));
+            if (policy::hooks && memo)
+                memo->enter(top_frame);
+            program_counter = ins.address;
+            if (policy::hooks && profiler)
+                profiler->enter(program_counter);
+            if (policy::fuel && --fuel <= 0)
+                return suspend();
+            break;
+        }
+        case opcode::TCL: {
+            int level = callee_level(ins);
+            if (policy::hooks && memo && memo->lookup(ins.address, frames)) {
+                // the skipped callee would have returned straight to our caller
+                int at = program_counter - 1;
+                leave();
+                if (policy::trace)
+                    trace.record(at, ins.op, depth + 1, program_counter);
+                break;
+            }
+            if (policy::trace)
+                trace.record(program_counter - 1, ins.op, depth, ins.address);
+            if (policy::metrics && metrics)
+                metrics->tail_call(ins.address, frame_bytes(top_frame) - sizeof(stack_frame));
+            frames.leave(top_frame);
+            top_frame->reuse(level);
+            frames.enter(top_frame);
+            if (policy::hooks && memo)
+                memo->enter(top_frame);
+            program_counter = ins.address;
+            if (policy::hooks && profiler) {
+                profiler->leave();
+                profiler->enter(program_counter);
+            }
+            if (policy::fuel && --fuel <= 0)
+                return suspend();
+            break;
+        }
         case opcode::INT:
             top_frame->allocate(ins.address - 3);
+            if (policy::metrics && metrics)
+                metrics->allocate(static_cast<uint64_t>(ins.address - 3) * sizeof(top_frame->locals_[0]));
             break;
-        case opcode::JMP:
-            program_counter = ins.address;
+        case opcode::JMP: {
+            int target = jump_target(ins);
+            if (policy::trace)
+                trace.record(program_counter - 1, ins.op, depth, target);
+            if (policy::fuel && target < program_counter && --fuel <= 0) {
+                program_counter = target;
+                return suspend();
+            }
+            program_counter = target;
             break;
-        case opcode::JPC:
-            if (!top_frame->pop()) {
-                program_counter = ins.address;
+        }
+        case opcode::JPC: {
+            int target = jump_target(ins);
+            int condition = pop();
+            if (policy::trace)
+                trace.record(program_counter - 1, ins.op, depth, condition ? program_counter : target);
+            if (!condition) {
+                if (policy::fuel && target < program_counter && --fuel <= 0) {
+                    program_counter = target;
+                    return suspend();
+                }
+                program_counter = target;
             }
             break;
+        }
         case opcode::OPR:
             if (ins.address == *opt::ODD) {
-                int result = top_frame->pop() % 2;
-                top_frame->push(result);
+                int value = pop();
+                top_frame->push(value % 2);
             } else if (ins.address == *opt::READ) {
                 int tmp;
-                std::cin >> tmp;
+                if (io == nullptr) {
+                    std::cin >> tmp;
+                } else if (!io->read(tmp)) {
+                    program_counter--;
+                    return suspend(status::waiting_for_input);
+                }
                 top_frame->push(tmp);
+                if (policy::metrics && metrics)
+                    metrics->read();
             } else if (ins.address == *opt::WRITE) {
-                std::cout << top_frame->pop() << '\n';
+                int value = pop();
+                if (io == nullptr) {
+                    std::cout << value << '\n';
+                } else if (!io->write(value)) {
+                    top_frame->push(value);
+                    program_counter--;
+                    return suspend(status::waiting_for_output);
+                }
+                if (policy::metrics && metrics)
+                    metrics->write();
             } else if (ins.address == *opt::RET) {
-                top_frame->leave(program_counter, top_frame);
+                int at = program_counter - 1;
+                leave();
+                if (policy::trace)
+                    trace.record(at, ins.op, depth + 1, program_counter);
+            } else if (ins.address == *opt::DIV) {
+                // the one operation that traps on the host, in every loop
+                int rhs = pop(), lhs = pop();
+                if (rhs == 0 || (lhs == std::numeric_limits<int>::min() && rhs == -1)) {
+                    suspend();
+                    throw general_error(rhs == 0 ? "division by zero" : "the division overflows");
+                }
+                top_frame->push(lhs / rhs);
             } else {
-                int rhs = top_frame->pop(), lhs = top_frame->pop();
-                auto f = opt2functor.find(opt(ins.address))->second;
-                top_frame->push(f(lhs, rhs));
+                auto functor = opt2functor.find(opt(ins.address));
+                check(functor != opt2functor.end(), "unknown operation");
+                int rhs = pop(), lhs = pop();
+                top_frame->push(functor->second(lhs, rhs));
             }
             break;
         }
     }
+    program_counter_ = program_counter;
+    top_frame_ = top_frame;
+    return status::finished;
 }
+
+void pl0::execute(const bytecode &code, procedure_profiler *profiler, memo_cache *memo) {
+    machine{ code, profiler, memo }.run();
+}
+
+template pl0::machine::status pl0::machine::run_with<pl0::plain_policy>(long fuel);
+template pl0::machine::status pl0::machine::run_with<pl0::general_policy>(long fuel);
@@ -1,38 +1,79 @@
 #ifndef PL_ZERO_VM_H
 #define PL_ZERO_VM_H
 
+#include <array>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
 #include "bytecode/bytecode.h"
+#include "metrics.h"
+#include "perf-counters.h"
+#include "trace.h"
 
 namespace pl0 {
 
 class stack_frame {
     int return_address_;
     stack_frame *dynamic_link_;
-    stack_frame *static_link_;
+    int level_;
+    stack_frame *saved_display_;
     std::vector<std::pair<std::string, int>> locals_;
     std::vector<int> intermediates_;
+    // owned by the VM and entered again on every call of its procedure
+    bool static_;
+
+    friend class display;
+    friend class machine;
 public:
-    stack_frame(int ret_address, stack_frame *dyn_link, stack_frame *static_link)
-            : return_address_(ret_address), dynamic_link_(dyn_link), static_link_(static_link) { }
+    stack_frame(int ret_address, stack_frame *dyn_link, int level, bool is_static = false)
+            : return_address_(ret_address), dynamic_link_(dyn_link), level_(level), saved_display_(nullptr),
+              static_(is_static) { }
 
     /**
-     * Destroy and immediately return to enclosing stack frame
+     * Destroy and immediately return to enclosing stack frame. Static frames
+     * are kept for the next call.
      * @param return_address
      * @param frame_pointer
      */
     void leave(int &return_address, stack_frame *&frame_pointer) {
         return_address = return_address_;
         frame_pointer = dynamic_link_;
-        delete this;
+        if (!static_)
+            delete this;
     }
 
-    stack_frame *resolve(int level_dist) {
-        stack_frame *target_frame = this;
-        while (level_dist > 0) {
-            target_frame = target_frame->static_link_;
-            level_dist--;
-        }
-        return target_frame;
+    /**
+     * Start a new activation in a static frame. The storage of the previous
+     * activation is kept, so entering it again allocates nothing.
+     */
+    void restart(int ret_address, stack_frame *dyn_link, int level) {
+        return_address_ = ret_address;
+        dynamic_link_ = dyn_link;
+        reuse(level);
+    }
+
+    /**
+     * Turn this frame into a fresh activation of a tail-called procedure,
+     * keeping the return address and dynamic link of the original call.
+     */
+    void reuse(int level) {
+        level_ = level;
+        locals_.clear();
+        intermediates_.clear();
+    }
+
+    int level() const {
+        return level_;
+    }
+
+    stack_frame *caller() const {
+        return dynamic_link_;
+    }
+
+    bool is_static() const {
+        return static_;
     }
 
     void allocate(int count) {
@@ -40,8 +81,8 @@ public:
             locals_.emplace_back(std::pair{ std::string{ }, 0 });
     }
 
-    int &local(int level_dist, int index) {
-        return resolve(level_dist)->locals_[index].second;
+    int &local(int index) {
+        return locals_[index].second;
     }
 
     void push(int value) {
@@ -55,10 +96,35 @@ public:
     }
 };
 
+/**
+ * Frame pointers indexed by static nesting level. Entries 0 to level() of
+ * the running frame always form its static chain, so reaching a variable
+ * of an enclosing procedure is a single indexed load.
+ */
+class display {
+    std::vector<stack_frame *> frames_;
+
+    friend class machine;
+public:
+    stack_frame *operator[](int level) const {
+        return frames_[level];
+    }
+
+    void enter(stack_frame *frame) {
+        if (frame->level_ >= static_cast<int>(frames_.size()))
+            frames_.resize(frame->level_ + 1, nullptr);
+        frame->saved_display_ = frames_[frame->level_];
+        frames_[frame->level_] = frame;
+    }
+
+    void leave(stack_frame *frame) {
+        frames_[frame->level_] = frame->saved_display_;
+    }
+};
+
 const std::unordered_map<opt, std::function<int (int, int)>> opt2functor = {
     { opt::ADD, std::plus<>() },
     { opt::SUB, std::minus<>() },
-    { opt::DIV, std::divides<>() },
     { opt::MUL, std::multiplies<>() },
     { opt::LE, std::less<>() },
     { opt::LEQ, std::less_equal<>() },
@@ -68,7 +134,185 @@ const std::unordered_map<opt, std::function<int (int, int)>> opt2functor = {
     { opt::NEQ, std::not_equal_to<>() }
 };
 
-void execute(const bytecode &code);
+class memo_cache;
+
+/**
+ * The state of a suspended machine without pointers: frames refer to each
+ * other by their position in the dynamic chain, main program first.
+ */
+struct frame_state {
+    int return_address;
+    int level;
+    // frame the display held for this level before, -1 if none
+    int saved_display;
+    // entry address of the procedure if the frame is static, -1 otherwise
+    int static_entry;
+    std::vector<int> locals;
+    std::vector<int> intermediates;
+};
+
+struct machine_state {
+    int program_counter = 0;
+    std::vector<frame_state> frames;
+    // frame per static nesting level, -1 if none
+    std::vector<int> display;
+};
+
+/**
+ * The features of the interpreter loop, fixed at compile time so that a
+ * loop without a feature does not even test whether it is on. The machine
+ * instantiates its loop for the combinations runs commonly need and picks
+ * one per call to run(); rarer combinations share a loop with every feature
+ * compiled in.
+ */
+template <bool checking, bool instrumented, bool fueled, bool tracing, bool measuring = false>
+struct interpreter_policy {
+    // test every stack access, local, level and jump target
+    static constexpr bool checks = checking;
+    // call the profiler and the memo cache, if the machine has them
+    static constexpr bool hooks = instrumented;
+    // charge calls and backward jumps to the fuel
+    static constexpr bool fuel = fueled;
+    // record control transfers in the trace buffer
+    static constexpr bool trace = tracing;
+    // count what the program does for the run metrics, if the machine has them
+    static constexpr bool metrics = measuring;
+};
+
+// verified code, nothing attached and no fuel: what most runs use
+typedef interpreter_policy<false, false, false, false> plain_policy;
+// hooks and fuel compiled in and switched on at run time, as the loop was before policies
+typedef interpreter_policy<false, true, true, false> general_policy;
+
+/**
+ * Input and output of a machine. read() and write() return false if the
+ * operation would block; the machine then stops before the instruction and
+ * tries it again when run() is called next.
+ */
+class program_io {
+public:
+    virtual ~program_io() = default;
+
+    virtual bool read(int &value) = 0;
+
+    virtual bool write(int value) = 0;
+};
+
+/**
+ * A program in execution. run() executes it until it ends or until its fuel
+ * runs out; a suspended machine continues where it stopped on the next call
+ * to run(), so a scheduler can time-slice many programs.
+ *
+ * Fuel is only charged for taken backward jumps and for calls, the only
+ * ways to execute an instruction twice, so straight-line code runs without
+ * checks and one unit of fuel covers at most one pass over the code.
+ *
+ * Without a program_io the machine reads std::cin and writes std::cout,
+ * which block instead.
+ *
+ * Dividing by zero, or the smallest int by -1, throws general_error on
+ * every loop instead of raising a signal, which would end the process.
+ *
+ * Code that passes the verifier runs on an interpreter loop without any
+ * checks. Other code, and any state given to resume(), which the verifier
+ * knows nothing about, runs on a loop that checks every stack access,
+ * local, nesting level and jump target and throws general_error instead of
+ * corrupting memory.
+ */
+class machine {
+    const bytecode &code_;
+    procedure_profiler *profiler_;
+    memo_cache *memo_;
+    program_io *io_;
+    trace_buffer *trace_ = nullptr;
+    run_metrics *metrics_ = nullptr;
+    int program_counter_;
+    stack_frame *top_frame_;
+    display frames_;
+    // frames of procedures called with SCL, indexed by entry address
+    std::vector<stack_frame *> static_frames_;
+    // set if the verifier proved the code safe to run without checks
+    bool verified_;
+    bool checked_;
+
+    void enter_main();
+    void release_frames();
+    static uint64_t frame_bytes(const stack_frame *frame);
+public:
+    enum class status { finished, suspended, waiting_for_input, waiting_for_output };
+
+    static constexpr long unlimited = std::numeric_limits<long>::max();
+
+    explicit machine(const bytecode &code, procedure_profiler *profiler = nullptr, memo_cache *memo = nullptr,
+                     program_io *io = nullptr);
+
+    // for code the caller already ran through the verifier, with its result
+    machine(const bytecode &code, bool verified, procedure_profiler *profiler = nullptr, memo_cache *memo = nullptr,
+            program_io *io = nullptr);
+    ~machine();
+
+    machine(const machine &) = delete;
+    machine &operator=(const machine &) = delete;
+
+    status run(long fuel = unlimited);
+
+    /**
+     * Run with the loop of a given policy, e.g. to measure what a feature
+     * costs. A policy without fuel or hooks ignores the fuel or the attached
+     * profiler and memo cache; one without checks for code that needs them
+     * throws general_error.
+     */
+    template <typename policy>
+    status run_with(long fuel = unlimited);
+
+    /**
+     * Start the program over with other I/O, e.g. for the next request to a
+     * resident program. The frames of procedures called with SCL are kept,
+     * so a restarted machine allocates less.
+     */
+    void restart(program_io *io);
+
+    machine_state capture() const;
+
+    // throws general_error if the state does not fit the code
+    void resume(const machine_state &state);
+
+    bool finished() const {
+        return top_frame_ == nullptr;
+    }
+
+    bool verified() const {
+        return verified_;
+    }
+
+    // the next instruction to execute; after an error, the one that failed is before it
+    int program_counter() const {
+        return program_counter_;
+    }
+
+    // record the control transfers made from now on, or stop if nullptr
+    void set_trace(trace_buffer *trace) {
+        trace_ = trace;
+    }
+
+    /**
+     * Count what the program does from now on, or stop if nullptr. Metrics
+     * attached before the first run also count the main program's frame.
+     */
+    void set_metrics(run_metrics *metrics);
+private:
+    typedef status (machine::*loop)(long fuel);
+
+    // the loop of each of the 32 combinations of features, a loop of its own
+    // for those listed and one with every feature for the others
+    template <size_t... features>
+    static std::array<loop, 32> loops(std::index_sequence<features...>);
+
+    template <typename policy>
+    status interpret(long fuel);
+};
+
+void execute(const bytecode &code, procedure_profiler *profiler = nullptr, memo_cache *memo = nullptr);
 
 }
 